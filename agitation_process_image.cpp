@@ -0,0 +1,498 @@
+#include "agitation_sequence.hpp"
+#include <string.h>
+
+// Compiled process images, see agitation_image_check(). The compiler writes
+// the tables in order, so it walks the processes once per table and lays
+// out strings and loop bodies in the order it meets them; the checker walks
+// every sequence once to make sure the image holds nothing else.
+
+namespace {
+
+static_assert(
+    sizeof(AgitationImageHeader) == 44 && sizeof(AgitationImageProcess) == 28 &&
+        sizeof(AgitationImageStep) == 20 && sizeof(AgitationCompiledMovement) == 16,
+    "Image tables must keep their size so every table stays 4-byte aligned");
+
+const char EMPTY_STRING[] = "";
+
+//------------------------------------------------------------------------------
+// Checking
+//------------------------------------------------------------------------------
+
+struct ImageChecker {
+    const uint8_t* image;
+    const AgitationImageHeader* header;
+    // Movements that belong to a sequence; each may only belong to one
+    uint32_t visited;
+    const char* error;
+};
+
+bool fail(ImageChecker& checker, const char* error) {
+    if(!checker.error) {
+        checker.error = error;
+    }
+    return false;
+}
+
+// A table of `length` entries of `size` bytes at `offset` lies in the image
+bool table_fits(const ImageChecker& checker, uint32_t offset, uint32_t length, size_t size) {
+    return offset % 4 == 0 && offset >= checker.header->header_size &&
+           offset <= checker.header->size &&
+           (uint64_t)length * size <= checker.header->size - offset;
+}
+
+bool string_fits(const ImageChecker& checker, uint32_t offset) {
+    return offset < checker.header->strings_size;
+}
+
+bool check_sequence(ImageChecker& checker, uint32_t first, uint32_t length, size_t depth) {
+    const AgitationImageHeader& header = *checker.header;
+    if(length == 0 || length > AGITATION_YAML_MAX_SEQUENCE_LENGTH) {
+        return fail(checker, "sequence length out of range");
+    }
+    if(first > header.movements_length || length > header.movements_length - first) {
+        return fail(checker, "sequence outside the movement table");
+    }
+    checker.visited += length;
+    if(checker.visited > header.movements_length) {
+        return fail(checker, "movements shared between sequences");
+    }
+
+    const AgitationCompiledMovement* movements =
+        (const AgitationCompiledMovement*)(checker.image + header.movements_offset);
+    for(uint32_t i = first; i < first + length; i++) {
+        const AgitationCompiledMovement& movement = movements[i];
+        switch(movement.type) {
+        case AgitationMovementTypeCW:
+        case AgitationMovementTypeCCW:
+        case AgitationMovementTypePause:
+            break;
+
+        case AgitationMovementTypeWaitUser: {
+            if(movement.value == 0) {
+                break;
+            }
+            // Offset from the movement to somewhere in the string table
+            uint64_t at = header.movements_offset + (uint64_t)i * sizeof(movement) +
+                          movement.value;
+            if(at < header.strings_offset || at - header.strings_offset >= header.strings_size) {
+                return fail(checker, "message outside the string table");
+            }
+            break;
+        }
+
+        case AgitationMovementTypeLoop:
+            // Bodies come after their loop, so no loop can contain itself
+            if(depth == AGITATION_YAML_MAX_LOOP_DEPTH) {
+                return fail(checker, "loops nested too deep");
+            }
+            if(movement.sequence == 0 || movement.sequence > header.movements_length - i) {
+                return fail(checker, "loop body outside the movement table");
+            }
+            if(!check_sequence(
+                   checker, i + movement.sequence, movement.sequence_length, depth + 1)) {
+                return false;
+            }
+            break;
+
+        default:
+            return fail(checker, "unknown movement type");
+        }
+    }
+    return true;
+}
+
+bool check_tables(ImageChecker& checker, size_t size) {
+    const AgitationImageHeader& header = *checker.header;
+    if(header.magic != AGITATION_IMAGE_MAGIC) {
+        return fail(checker, "not a process image");
+    }
+    if(header.version != AGITATION_IMAGE_VERSION) {
+        return fail(checker, "unsupported image version");
+    }
+    if(header.header_size < sizeof(AgitationImageHeader) || header.size != size ||
+       header.header_size > header.size) {
+        return fail(checker, "image size does not match");
+    }
+    if(!table_fits(
+           checker,
+           header.processes_offset,
+           header.processes_length,
+           sizeof(AgitationImageProcess)) ||
+       !table_fits(
+           checker, header.steps_offset, header.steps_length, sizeof(AgitationImageStep)) ||
+       !table_fits(
+           checker,
+           header.movements_offset,
+           header.movements_length,
+           sizeof(AgitationCompiledMovement)) ||
+       header.strings_offset < header.header_size || header.strings_offset > header.size ||
+       header.strings_size > header.size - header.strings_offset) {
+        return fail(checker, "table outside the image");
+    }
+    // Every string ends at the latest with the table
+    if(header.strings_size == 0 ||
+       checker.image[header.strings_offset + header.strings_size - 1] != '\0') {
+        return fail(checker, "string table not terminated");
+    }
+    if(header.processes_length == 0) {
+        return fail(checker, "no processes");
+    }
+    return true;
+}
+
+bool check_processes(ImageChecker& checker) {
+    const AgitationImageHeader& header = *checker.header;
+    const AgitationImageProcess* processes =
+        (const AgitationImageProcess*)(checker.image + header.processes_offset);
+    const AgitationImageStep* steps =
+        (const AgitationImageStep*)(checker.image + header.steps_offset);
+
+    // Steps belong to one process each, like movements to one sequence
+    uint64_t steps_used = 0;
+    for(uint32_t p = 0; p < header.processes_length; p++) {
+        const AgitationImageProcess& process = processes[p];
+        if(!string_fits(checker, process.process_name) ||
+           !string_fits(checker, process.film_type) ||
+           !string_fits(checker, process.tank_type) ||
+           !string_fits(checker, process.chemistry)) {
+            return fail(checker, "string outside the string table");
+        }
+        if(process.steps_length == 0 || process.steps_length > AGITATION_IMAGE_MAX_STEPS ||
+           process.steps > header.steps_length ||
+           process.steps_length > header.steps_length - process.steps) {
+            return fail(checker, "steps out of range");
+        }
+        steps_used += process.steps_length;
+
+        for(uint32_t s = process.steps; s < process.steps + process.steps_length; s++) {
+            const AgitationImageStep& step = steps[s];
+            if(!string_fits(checker, step.name) || !string_fits(checker, step.description)) {
+                return fail(checker, "string outside the string table");
+            }
+            if(!check_sequence(checker, step.sequence, step.sequence_length, 0)) {
+                return false;
+            }
+        }
+    }
+
+    if(steps_used != header.steps_length || checker.visited != header.movements_length) {
+        return fail(checker, "steps or movements that belong nowhere");
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Compiling
+//------------------------------------------------------------------------------
+
+struct ImageWriter {
+    AgitationYamlWrite write;
+    void* context;
+    bool failed;
+};
+
+void put(ImageWriter& writer, const void* data, size_t size) {
+    if(!writer.failed && !writer.write(data, size, writer.context)) {
+        writer.failed = true;
+    }
+}
+
+// Bytes a string takes in the string table
+uint32_t string_size(const char* text) {
+    return (uint32_t)strlen(text ? text : EMPTY_STRING) + 1;
+}
+
+void put_string(ImageWriter& writer, const char* text) {
+    text = text ? text : EMPTY_STRING;
+    put(writer, text, strlen(text) + 1);
+}
+
+// Movements in a sequence, its loop bodies included, and the bytes its
+// messages take; false if the sequence breaks a limit
+bool measure_sequence(
+    const AgitationSequenceView& sequence,
+    size_t depth,
+    uint32_t& movements,
+    uint32_t& strings) {
+    size_t length = sequence.getLength();
+    if(sequence.isNull() || length == 0 || length > AGITATION_YAML_MAX_SEQUENCE_LENGTH ||
+       depth > AGITATION_YAML_MAX_LOOP_DEPTH) {
+        return false;
+    }
+    movements += length;
+    for(size_t i = 0; i < length; i++) {
+        switch(sequence.getType(i)) {
+        case AgitationMovementTypeCW:
+        case AgitationMovementTypeCCW:
+        case AgitationMovementTypePause:
+            break;
+        case AgitationMovementTypeWaitUser:
+            if(sequence.getMessage(i)) {
+                strings += string_size(sequence.getMessage(i));
+            }
+            break;
+        case AgitationMovementTypeLoop:
+            if(!measure_sequence(sequence.getLoopBody(i), depth + 1, movements, strings)) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t movements_in(const AgitationSequenceView& sequence) {
+    uint32_t movements = 0;
+    uint32_t strings = 0;
+    measure_sequence(sequence, 0, movements, strings);
+    return movements;
+}
+
+/**
+ * @brief Writes a sequence as movement `first` onwards: its own movements,
+ * then the body of each of its loops in turn. `message_at` is where the
+ * next message goes, counted from the start of the image.
+ */
+void put_sequence(
+    ImageWriter& writer,
+    const AgitationSequenceView& sequence,
+    uint32_t first,
+    uint32_t movements_offset,
+    uint32_t& message_at) {
+    uint32_t body = first + (uint32_t)sequence.getLength();
+    for(size_t i = 0; i < sequence.getLength(); i++) {
+        uint32_t index = first + (uint32_t)i;
+        AgitationCompiledMovement movement = {};
+        movement.type = (uint8_t)sequence.getType(i);
+        switch(sequence.getType(i)) {
+        case AgitationMovementTypeLoop:
+            movement.sequence_length = (uint16_t)sequence.getLoopBody(i).getLength();
+            movement.sequence = body - index;
+            movement.value = sequence.getLoopCount(i);
+            movement.max_duration = sequence.getLoopMaxDuration(i);
+            body += movements_in(sequence.getLoopBody(i));
+            break;
+        case AgitationMovementTypeWaitUser:
+            if(sequence.getMessage(i)) {
+                movement.value =
+                    message_at - (movements_offset + index * sizeof(AgitationCompiledMovement));
+                message_at += string_size(sequence.getMessage(i));
+            }
+            break;
+        default:
+            movement.value = sequence.getDuration(i);
+            break;
+        }
+        put(writer, &movement, sizeof(movement));
+    }
+
+    body = first + (uint32_t)sequence.getLength();
+    for(size_t i = 0; i < sequence.getLength(); i++) {
+        if(sequence.getType(i) == AgitationMovementTypeLoop) {
+            put_sequence(writer, sequence.getLoopBody(i), body, movements_offset, message_at);
+            body += movements_in(sequence.getLoopBody(i));
+        }
+    }
+}
+
+// The messages of a sequence, in the order put_sequence() placed them
+void put_messages(ImageWriter& writer, const AgitationSequenceView& sequence) {
+    for(size_t i = 0; i < sequence.getLength(); i++) {
+        if(sequence.getType(i) == AgitationMovementTypeWaitUser && sequence.getMessage(i)) {
+            put_string(writer, sequence.getMessage(i));
+        }
+    }
+    for(size_t i = 0; i < sequence.getLength(); i++) {
+        if(sequence.getType(i) == AgitationMovementTypeLoop) {
+            put_messages(writer, sequence.getLoopBody(i));
+        }
+    }
+}
+
+} // namespace
+
+bool agitation_image_check(const void* image, size_t size, const char** error) {
+    ImageChecker checker = {(const uint8_t*)image, (const AgitationImageHeader*)image, 0, nullptr};
+    if(size < sizeof(AgitationImageHeader) || (uintptr_t)image % 4 != 0) {
+        fail(checker, "too short or misaligned for a process image");
+    } else {
+        check_tables(checker, size) && check_processes(checker);
+    }
+    if(error) {
+        *error = checker.error;
+    }
+    return checker.error == nullptr;
+}
+
+size_t agitation_image_processes_length(const void* image) {
+    return ((const AgitationImageHeader*)image)->processes_length;
+}
+
+bool agitation_image_get_process(
+    const void* image,
+    size_t index,
+    AgitationImageProcessView* view) {
+    const uint8_t* base = (const uint8_t*)image;
+    const AgitationImageHeader& header = *(const AgitationImageHeader*)image;
+    if(index >= header.processes_length) {
+        return false;
+    }
+
+    const char* strings = (const char*)(base + header.strings_offset);
+    const AgitationImageStep* steps = (const AgitationImageStep*)(base + header.steps_offset);
+    const AgitationCompiledMovement* movements =
+        (const AgitationCompiledMovement*)(base + header.movements_offset);
+    const AgitationImageProcess& process =
+        ((const AgitationImageProcess*)(base + header.processes_offset))[index];
+
+    for(uint32_t i = 0; i < process.steps_length; i++) {
+        const AgitationImageStep& step = steps[process.steps + i];
+        view->steps[i] = AgitationStepStatic{
+            strings + step.name,
+            strings + step.description,
+            step.temperature,
+            nullptr,
+            step.sequence_length,
+            movements + step.sequence};
+    }
+    view->process = AgitationProcessStatic{
+        strings + process.process_name,
+        strings + process.film_type,
+        strings + process.tank_type,
+        strings + process.chemistry,
+        process.temperature,
+        view->steps,
+        process.steps_length};
+    return true;
+}
+
+bool agitation_image_compile(
+    const AgitationProcessStatic* const* processes,
+    size_t processes_length,
+    AgitationYamlWrite write,
+    void* context) {
+    AgitationImageHeader header = {};
+    header.magic = AGITATION_IMAGE_MAGIC;
+    header.version = AGITATION_IMAGE_VERSION;
+    header.header_size = sizeof(AgitationImageHeader);
+    header.processes_length = (uint32_t)processes_length;
+
+    if(processes_length == 0) {
+        return false;
+    }
+
+    // Sizes of all tables first, so every offset is known before writing
+    uint32_t messages_size = 0;
+    for(size_t p = 0; p < processes_length; p++) {
+        const AgitationProcessStatic& process = *processes[p];
+        if(!process.process_name || process.steps_length == 0 ||
+           process.steps_length > AGITATION_IMAGE_MAX_STEPS) {
+            return false;
+        }
+        header.steps_length += (uint32_t)process.steps_length;
+        header.strings_size += string_size(process.process_name) +
+                               string_size(process.film_type) +
+                               string_size(process.tank_type) + string_size(process.chemistry);
+        for(size_t s = 0; s < process.steps_length; s++) {
+            const AgitationStepStatic& step = process.steps[s];
+            if(!step.name || !measure_sequence(
+                                 AgitationSequenceView::of(step),
+                                 0,
+                                 header.movements_length,
+                                 messages_size)) {
+                return false;
+            }
+            header.strings_size += string_size(step.name) + string_size(step.description);
+        }
+    }
+    header.strings_size += messages_size;
+
+    header.processes_offset = header.header_size;
+    header.steps_offset =
+        header.processes_offset + header.processes_length * sizeof(AgitationImageProcess);
+    header.movements_offset =
+        header.steps_offset + header.steps_length * sizeof(AgitationImageStep);
+    header.strings_offset =
+        header.movements_offset + header.movements_length * sizeof(AgitationCompiledMovement);
+    header.size = header.strings_offset + header.strings_size;
+
+    ImageWriter writer = {write, context, false};
+    put(writer, &header, sizeof(header));
+
+    // Strings go in the order the tables refer to them
+    uint32_t string_at = 0;
+    uint32_t step_index = 0;
+    for(size_t p = 0; p < processes_length; p++) {
+        const AgitationProcessStatic& process = *processes[p];
+        AgitationImageProcess record = {};
+        record.process_name = string_at;
+        string_at += string_size(process.process_name);
+        record.film_type = string_at;
+        string_at += string_size(process.film_type);
+        record.tank_type = string_at;
+        string_at += string_size(process.tank_type);
+        record.chemistry = string_at;
+        string_at += string_size(process.chemistry);
+        record.temperature = process.temperature;
+        record.steps = step_index;
+        record.steps_length = (uint32_t)process.steps_length;
+        step_index += record.steps_length;
+        put(writer, &record, sizeof(record));
+    }
+
+    uint32_t movement_index = 0;
+    for(size_t p = 0; p < processes_length; p++) {
+        const AgitationProcessStatic& process = *processes[p];
+        for(size_t s = 0; s < process.steps_length; s++) {
+            const AgitationStepStatic& step = process.steps[s];
+            AgitationImageStep record = {};
+            record.name = string_at;
+            string_at += string_size(step.name);
+            record.description = string_at;
+            string_at += string_size(step.description);
+            record.temperature = step.temperature;
+            record.sequence = movement_index;
+            record.sequence_length = (uint32_t)step.sequence_length;
+            movement_index += movements_in(AgitationSequenceView::of(step));
+            put(writer, &record, sizeof(record));
+        }
+    }
+
+    // Messages follow the process and step strings
+    uint32_t message_at = header.strings_offset + string_at;
+    movement_index = 0;
+    for(size_t p = 0; p < processes_length; p++) {
+        const AgitationProcessStatic& process = *processes[p];
+        for(size_t s = 0; s < process.steps_length; s++) {
+            AgitationSequenceView sequence = AgitationSequenceView::of(process.steps[s]);
+            put_sequence(writer, sequence, movement_index, header.movements_offset, message_at);
+            movement_index += movements_in(sequence);
+        }
+    }
+
+    for(size_t p = 0; p < processes_length; p++) {
+        const AgitationProcessStatic& process = *processes[p];
+        put_string(writer, process.process_name);
+        put_string(writer, process.film_type);
+        put_string(writer, process.tank_type);
+        put_string(writer, process.chemistry);
+    }
+    for(size_t p = 0; p < processes_length; p++) {
+        const AgitationProcessStatic& process = *processes[p];
+        for(size_t s = 0; s < process.steps_length; s++) {
+            put_string(writer, process.steps[s].name);
+            put_string(writer, process.steps[s].description);
+        }
+    }
+    for(size_t p = 0; p < processes_length; p++) {
+        const AgitationProcessStatic& process = *processes[p];
+        for(size_t s = 0; s < process.steps_length; s++) {
+            put_messages(writer, AgitationSequenceView::of(process.steps[s]));
+        }
+    }
+
+    return !writer.failed;
+}
@@ -1,17 +1,28 @@
 #include "agitation_process_interpreter.hpp"
 #include "debug.hpp"
 #include "motor_controller.hpp"
+#include "movement/sequence_analysis.hpp"
 #include <memory>
 #include <stdio.h>
 #include <string.h>
 
 AgitationProcessInterpreter::AgitationProcessInterpreter()
     : process(nullptr), current_step_index(0),
-      process_state(AgitationProcessState::Idle), current_temperature(20.0f),
+      process_state(AgitationProcessState::Idle),
+      process_error(AgitationProcessError::None), elapsed_ticks(0),
+      anchor_ms(0), anchor_ticks(0), generation(0),
+      step_elapsed(0), current_temperature(20.0f),
       target_temperature(20.0f), motor_controller(nullptr),
-      movement_loader(movement_factory), sequence_length(0),
+      active_buffer(&step_buffers[0]), pending_buffer(&step_buffers[1]),
+      loaded_sequence(step_buffers[0].sequence), sequence_length(0),
       current_movement_index(0), time_remaining(0), movement_completed(false) {
-  memset(loaded_sequence, 0, sizeof(loaded_sequence));
+  for (StepBuffer &buffer : step_buffers) {
+    memset(buffer.sequence, 0, sizeof(buffer.sequence));
+    buffer.length = 0;
+    buffer.step_index = NO_STEP;
+  }
+  memset(step_duration, 0, sizeof(step_duration));
+  memset(time_after_step, 0, sizeof(time_after_step));
 }
 
 void AgitationProcessInterpreter::init(const AgitationProcessStatic *process,
@@ -20,14 +31,41 @@ void AgitationProcessInterpreter::init(const AgitationProcessStatic *process,
   this->motor_controller = motor_controller;
   current_step_index = 0;
   process_state = AgitationProcessState::Idle;
+  process_error = AgitationProcessError::None;
+  generation++;
+  elapsed_ticks = 0;
+  anchor_ms = 0;
+  anchor_ticks = 0;
+  step_elapsed = 0;
+  memset(step_duration, 0, sizeof(step_duration));
+  memset(time_after_step, 0, sizeof(time_after_step));
+  if (process->steps_length > MAX_STEPS) {
+    // Not started at all rather than run without time estimates
+    process_state = AgitationProcessState::Error;
+    process_error = AgitationProcessError::TooManySteps;
+  } else {
+    computeStepDurations();
+  }
 
   current_temperature = 20.0f;
   target_temperature = process->temperature;
   movement_completed = false;
 
+  // Everything loaded by a previous run is dropped, so a restart starts from
+  // the same empty pools
+  for (StepBuffer &buffer : step_buffers) {
+    buffer.factory.reset();
+    buffer.length = 0;
+    buffer.step_index = NO_STEP;
+  }
   sequence_length = 0;
   current_movement_index = 0;
 
+  TRACE_EVENT(ProcessStart, process->steps_length);
+  if (process_state == AgitationProcessState::Error) {
+    TRACE_EVENT(ProcessEnd, static_cast<uint32_t>(process_state),
+                elapsed_ticks);
+  }
   DEBUG_PRINT("Process Interpreter Initialized:\n");
   DEBUG_PRINT("  Process Name: %s\n", process->process_name);
   DEBUG_PRINT("  Film Type: %s\n", process->film_type);
@@ -36,64 +74,138 @@ void AgitationProcessInterpreter::init(const AgitationProcessStatic *process,
               static_cast<double>(target_temperature));
 }
 
-void AgitationProcessInterpreter::initializeMovementSequence(
-    const AgitationStepStatic *step) {
-  memset(loaded_sequence, 0, sizeof(loaded_sequence));
+void AgitationProcessInterpreter::computeStepDurations() {
+  uint32_t after = 0;
+  for (size_t i = process->steps_length; i-- > 0;) {
+    step_duration[i] = SequenceAnalysis::analyzeStep(process->steps[i]).duration;
+    time_after_step[i] = after;
+    after = SequenceAnalysis::saturatingAdd(after, step_duration[i]);
+  }
+}
 
-  sequence_length = movement_loader.loadSequence(
-      step->sequence, step->sequence_length, loaded_sequence);
+bool AgitationProcessInterpreter::loadStep(StepBuffer &buffer,
+                                           size_t step_index) {
+  const AgitationStepStatic *step = &process->steps[step_index];
+  memset(buffer.sequence, 0, sizeof(buffer.sequence));
+  buffer.step_index = NO_STEP;
 
-  current_movement_index = 0;
+  // Whatever the buffer held before is not referenced anymore
+  buffer.factory.reset();
 
-  if (sequence_length == 0) {
-    DEBUG_PRINT("Failed to load movement sequence");
-    process_state = AgitationProcessState::Error;
-    return;
+  buffer.length = buffer.loader.loadSequence(AgitationSequenceView::of(*step),
+                                             buffer.sequence);
+
+  if (buffer.factory.isExhausted() || buffer.length == 0) {
+    // A partially loaded step would run with movements silently missing
+    TRACE_EVENT(StepLoadFailed, step_index, buffer.factory.getUsed(),
+                buffer.factory.isExhausted());
+    buffer.length = 0;
+    return false;
   }
 
-  for (size_t i = 0; i < sequence_length; i++) {
-    if (loaded_sequence[i]) {
-      loaded_sequence[i]->reset();
+  for (size_t i = 0; i < buffer.length; i++) {
+    if (buffer.sequence[i]) {
+      buffer.sequence[i]->reset();
     }
   }
+  buffer.step_index = step_index;
+
+  DEBUG_PRINT("Loaded movement sequence with %zu movements\n", buffer.length);
+  buffer.factory.printPoolStats();
+  return true;
+}
+
+bool AgitationProcessInterpreter::activateStep(size_t step_index) {
+  if (pending_buffer->step_index != step_index &&
+      !loadStep(*pending_buffer, step_index)) {
+    process_state = AgitationProcessState::Error;
+    process_error = pending_buffer->factory.isExhausted()
+                        ? AgitationProcessError::StepTooLarge
+                        : AgitationProcessError::StepEmpty;
+    sequence_length = 0;
+    current_movement_index = 0;
+    generation++;
+    TRACE_EVENT(ProcessEnd, static_cast<uint32_t>(process_state),
+                elapsed_ticks);
+    return false;
+  }
 
-  DEBUG_PRINT("Loaded movement sequence with %zu movements\n", sequence_length);
+  StepBuffer *previous = active_buffer;
+  active_buffer = pending_buffer;
+  pending_buffer = previous;
+  // The old step's movements stay in place but are never run again
+  pending_buffer->step_index = NO_STEP;
+
+  loaded_sequence = active_buffer->sequence;
+  sequence_length = active_buffer->length;
+  current_movement_index = 0;
+  process_state = AgitationProcessState::Running;
+  generation++;
+  TRACE_EVENT(StepStart, step_index, sequence_length,
+              active_buffer->factory.getUsed());
+  traceMovementStart();
+  return true;
+}
+
+void AgitationProcessInterpreter::preloadNextStep() {
+  size_t next = current_step_index + 1;
+  if (next >= process->steps_length || pending_buffer->step_index == next) {
+    return;
+  }
+
+  // A failure is reported when the step is due; it is retried then
+  bool loaded = loadStep(*pending_buffer, next);
+  TRACE_EVENT(StepPreload, next, loaded);
+}
+
+bool AgitationProcessInterpreter::isNextStepPreloaded() const {
+  return process && pending_buffer->step_index == current_step_index + 1;
 }
 
 bool AgitationProcessInterpreter::tick() {
   if (current_step_index >= process->steps_length ||
+      process_state == AgitationProcessState::Complete ||
       process_state == AgitationProcessState::Error) {
-    DEBUG_PRINT("Process Completed or Error: %s",
-                process_state == AgitationProcessState::Error ? "Error"
-                                                              : "Completed");
-    process_state = process_state == AgitationProcessState::Error
-                        ? AgitationProcessState::Error
-                        : AgitationProcessState::Complete;
+    if (process_state != AgitationProcessState::Error &&
+        process_state != AgitationProcessState::Complete) {
+      process_state = AgitationProcessState::Complete;
+      generation++;
+    }
     return false;
   }
 
+  elapsed_ticks++;
+
   if (movement_completed) {
     advanceToNextMovement();
     movement_completed = false;
+  }
 
-    if (current_movement_index >= sequence_length) {
-      DEBUG_PRINT("Movement sequence completed, advancing to next step\n");
-      advanceToNextStep();
-      return true;
+  if (process_state == AgitationProcessState::Running &&
+      current_movement_index >= sequence_length) {
+    if (current_step_index + 1 >= process->steps_length) {
+      process_state = AgitationProcessState::Complete;
+      generation++;
+      TRACE_EVENT(ProcessEnd, static_cast<uint32_t>(process_state),
+                  elapsed_ticks);
+      motor_controller->stop();
+      return false;
+    }
+
+    // The next step starts on this very tick
+    advanceToNextStep();
+    if (process_state == AgitationProcessState::Error) {
+      return false;
     }
   }
 
   const AgitationStepStatic *current_step = &process->steps[current_step_index];
   target_temperature = current_step->temperature;
 
-  if (process_state == AgitationProcessState::Idle ||
-      process_state == AgitationProcessState::Complete) {
-    DEBUG_PRINT("Initializing Movement Sequence for Step %zu: %s\n",
-                current_step_index,
-                current_step->name ? current_step->name : "Unnamed Step");
-
-    initializeMovementSequence(current_step);
-    process_state = AgitationProcessState::Running;
+  if (process_state == AgitationProcessState::Idle) {
+    if (!activateStep(current_step_index)) {
+      return false;
+    }
   }
 
   bool movement_active = false;
@@ -104,9 +216,16 @@ bool AgitationProcessInterpreter::tick() {
     if (current_movement) {
       movement_active = current_movement->execute(*motor_controller);
 
+      // A pause, possibly nested in a loop, or a wait: nothing is timing
+      // critical, so get the next step ready
+      if (!motor_controller->isRunning()) {
+        preloadNextStep();
+      }
+
       if (current_movement->getType() == AgitationMovement::Type::WaitUser) {
         return true;
       }
+      step_elapsed++;
 
       if (!movement_active) {
         movement_completed = true;
@@ -117,10 +236,94 @@ bool AgitationProcessInterpreter::tick() {
   return movement_active || current_step_index < process->steps_length;
 }
 
+bool AgitationProcessInterpreter::advanceBy(uint32_t ticks) {
+  bool active = process_state != AgitationProcessState::Complete &&
+                process_state != AgitationProcessState::Error;
+
+  while (ticks > 0 && active) {
+    // Skip silently up to the last tick, which runs for real so the motor
+    // ends up exactly where tick() by tick() would have left it
+    ticks -= skipWithinMovement(ticks - 1);
+    active = tick();
+    ticks--;
+  }
+
+  return active;
+}
+
+void AgitationProcessInterpreter::anchor(uint32_t now_ms) {
+  anchor_ms = now_ms;
+  anchor_ticks = elapsed_ticks;
+}
+
+uint32_t AgitationProcessInterpreter::ticksDueAt(uint32_t now_ms) const {
+  int32_t since = static_cast<int32_t>(now_ms - anchor_ms);
+  if (since <= 0) {
+    return anchor_ticks;
+  }
+  return anchor_ticks + static_cast<uint32_t>(since) / AGITATION_TICK_MS;
+}
+
+uint32_t AgitationProcessInterpreter::tickTimeMs(uint32_t ticks) const {
+  return anchor_ms + agitation_ticks_to_ms(ticks - anchor_ticks);
+}
+
+bool AgitationProcessInterpreter::runUntil(uint32_t now_ms) {
+  uint32_t due = ticksDueAt(now_ms);
+  if (due <= elapsed_ticks) {
+    return process_state != AgitationProcessState::Complete &&
+           process_state != AgitationProcessState::Error;
+  }
+
+  // The ticks before the last one are in the past. Movements they finish
+  // would only twitch the motor now, so they run against a latch that starts
+  // out as the motor is.
+  MotorController *motor = motor_controller;
+  MotorCommandLatch latch(motor->getDirection());
+  motor_controller = &latch;
+  bool active = advanceTo(due);
+  motor_controller = motor;
+  latch.applyTo(*motor);
+  return active;
+}
+
+bool AgitationProcessInterpreter::advanceTo(uint32_t ticks) {
+  if (ticks <= elapsed_ticks) {
+    return process_state != AgitationProcessState::Complete &&
+           process_state != AgitationProcessState::Error;
+  }
+  return advanceBy(ticks - elapsed_ticks);
+}
+
+uint32_t AgitationProcessInterpreter::skipWithinMovement(uint32_t ticks) {
+  // Step loads and movement changes are left to tick()
+  if (ticks == 0 || process_state != AgitationProcessState::Running ||
+      movement_completed || current_movement_index >= sequence_length ||
+      !loaded_sequence[current_movement_index]) {
+    return 0;
+  }
+
+  // Only the last command of the skipped stretch reaches the motor
+  MotorCommandLatch latch;
+  AgitationMovement *current_movement = loaded_sequence[current_movement_index];
+  uint32_t skipped = current_movement->advance(ticks, latch);
+  latch.applyTo(*motor_controller);
+  if (current_movement->isComplete()) {
+    movement_completed = true;
+  }
+
+  elapsed_ticks += skipped;
+  if (current_movement->getType() != AgitationMovement::Type::WaitUser) {
+    step_elapsed += skipped;
+  }
+  return skipped;
+}
+
 void AgitationProcessInterpreter::reset() { init(process, motor_controller); }
 
 void AgitationProcessInterpreter::confirm() {
   if (isWaitingForUser()) {
+    TRACE_EVENT(UserConfirm, current_step_index);
     if (current_step_index + 1 >= process->steps_length) {
       // If this is the last step, just advance the movement
       advanceToNextMovement();
@@ -131,25 +334,109 @@ void AgitationProcessInterpreter::confirm() {
   }
 }
 
+bool AgitationProcessInterpreter::saveCursor(AgitationCursor &cursor) const {
+  if (process_state != AgitationProcessState::Running ||
+      current_movement_index >= sequence_length ||
+      current_step_index > UINT16_MAX) {
+    return false;
+  }
+
+  memset(&cursor, 0, sizeof(cursor));
+  cursor.elapsed_ticks = elapsed_ticks;
+  cursor.step_elapsed = step_elapsed;
+  cursor.step_index = static_cast<uint16_t>(current_step_index);
+  cursor.movement_completed = movement_completed;
+
+  // Down the running loops to the leaf movement that runs now
+  size_t index = current_movement_index;
+  const AgitationMovement *movement = loaded_sequence[index];
+  while (movement && cursor.levels_length < AgitationCursor::MAX_LEVELS) {
+    AgitationCursor::Level &level = cursor.levels[cursor.levels_length++];
+    level.index = static_cast<uint16_t>(index);
+    level.elapsed = movement->timeElapsed();
+    if (movement->getType() != AgitationMovement::Type::Loop) {
+      return true;
+    }
+    const LoopMovement *loop = static_cast<const LoopMovement *>(movement);
+    level.iteration = loop->getIteration();
+    index = loop->getCurrentIndex();
+    movement = loop->getCurrent();
+  }
+  return false;
+}
+
+bool AgitationProcessInterpreter::restoreCursor(
+    const AgitationCursor &cursor) {
+  if (!process || process_state != AgitationProcessState::Idle ||
+      cursor.step_index >= process->steps_length ||
+      cursor.levels_length == 0 ||
+      cursor.levels_length > AgitationCursor::MAX_LEVELS) {
+    return false;
+  }
+
+  current_step_index = cursor.step_index;
+  if (!activateStep(current_step_index)) {
+    init(process, motor_controller);
+    return false;
+  }
+
+  // Each level resets its movement, which resets everything nested in it,
+  // and then puts it back where it was
+  LoopMovement *loop = nullptr;
+  bool restored = true;
+  for (size_t i = 0; i < cursor.levels_length && restored; i++) {
+    const AgitationCursor::Level &level = cursor.levels[i];
+    AgitationMovement *movement = nullptr;
+    if (i == 0) {
+      current_movement_index = level.index;
+      movement = level.index < sequence_length ? loaded_sequence[level.index]
+                                               : nullptr;
+    } else if (loop &&
+               loop->restore(cursor.levels[i - 1].iteration, level.index)) {
+      movement = loop->getCurrent();
+    }
+
+    restored = movement != nullptr;
+    if (restored) {
+      movement->reset();
+      movement->restoreElapsed(level.elapsed);
+      loop = movement->getType() == AgitationMovement::Type::Loop
+                 ? static_cast<LoopMovement *>(movement)
+                 : nullptr;
+    }
+  }
+  // A cursor always ends at the leaf movement that runs
+  if (!restored || loop) {
+    init(process, motor_controller);
+    return false;
+  }
+
+  elapsed_ticks = cursor.elapsed_ticks;
+  anchor_ticks = elapsed_ticks;
+  step_elapsed = cursor.step_elapsed;
+  movement_completed = cursor.movement_completed != 0;
+  generation++;
+  TRACE_EVENT(CursorRestored, current_step_index, cursor.levels_length,
+              elapsed_ticks);
+  return true;
+}
+
 void AgitationProcessInterpreter::advanceToNextStep() {
   if (!(current_step_index + 1 < process->steps_length)) {
     DEBUG_PRINT("Cannot advance to next step, already at last step");
     return;
   }
-  DEBUG_PRINT("Advancing to next step: %s, current step index: %lu/%lu  ",
-              process->steps[current_step_index + 1].name,
-              current_step_index + 1, process->steps_length);
   current_step_index++;
-  process_state = AgitationProcessState::Idle;
-  sequence_length = 0;
-  current_movement_index = 0;
+  generation++;
+  step_elapsed = 0;
+  movement_completed = false;
 
-  // Reset all movements in current sequence
-  for (size_t i = 0; i < sequence_length; i++) {
-    if (loaded_sequence[i]) {
-      loaded_sequence[i]->reset();
-    }
+  // Before the first tick nothing is loaded yet, the first tick loads the
+  // step it lands on
+  if (process_state == AgitationProcessState::Idle) {
+    return;
   }
+  activateStep(current_step_index);
 }
 
 void AgitationProcessInterpreter::skipToNextStep() { advanceToNextStep(); }
@@ -178,6 +465,51 @@ uint32_t AgitationProcessInterpreter::getCurrentMovementDuration() const {
   return 0;
 }
 
+uint32_t AgitationProcessInterpreter::getStepDuration() const {
+  if (!process || current_step_index >= process->steps_length ||
+      current_step_index >= MAX_STEPS) {
+    return 0;
+  }
+  return step_duration[current_step_index];
+}
+
+uint32_t AgitationProcessInterpreter::getStepTimeRemaining() const {
+  if (process_state == AgitationProcessState::Complete) {
+    return 0;
+  }
+  uint32_t duration = getStepDuration();
+  if (duration == AgitationMovement::UNBOUNDED_DURATION) {
+    return duration;
+  }
+  return duration > step_elapsed ? duration - step_elapsed : 0;
+}
+
+uint32_t AgitationProcessInterpreter::getProcessTimeRemaining() const {
+  if (!process || process_state == AgitationProcessState::Complete ||
+      current_step_index >= process->steps_length ||
+      current_step_index >= MAX_STEPS) {
+    return 0;
+  }
+  return SequenceAnalysis::saturatingAdd(getStepTimeRemaining(),
+                                         time_after_step[current_step_index]);
+}
+
+uint32_t AgitationProcessInterpreter::nextEventIn() const {
+  if (!process || process_state == AgitationProcessState::Complete ||
+      process_state == AgitationProcessState::Error) {
+    return AgitationMovement::NO_PENDING_EVENT;
+  }
+
+  // Loading a step or moving on to the next movement happens on the next tick
+  if (process_state == AgitationProcessState::Idle || movement_completed ||
+      current_movement_index >= sequence_length ||
+      !loaded_sequence[current_movement_index]) {
+    return 1;
+  }
+
+  return loaded_sequence[current_movement_index]->nextEventIn();
+}
+
 bool AgitationProcessInterpreter::isWaitingForUser() const {
   if (current_movement_index < sequence_length &&
       loaded_sequence[current_movement_index]) {
@@ -201,17 +533,25 @@ const char *AgitationProcessInterpreter::getUserMessage() const {
 
 void AgitationProcessInterpreter::advanceToNextMovement() {
   if (current_movement_index < sequence_length) {
-    DEBUG_PRINT("Advancing to next movement: %lu/%lu",
-                current_movement_index + 1, sequence_length);
-
     current_movement_index++;
+    generation++;
     if (current_movement_index < sequence_length &&
         loaded_sequence[current_movement_index]) {
       loaded_sequence[current_movement_index]->reset();
+      traceMovementStart();
     }
   }
 }
 
+void AgitationProcessInterpreter::traceMovementStart() const {
+  if (current_movement_index < sequence_length &&
+      loaded_sequence[current_movement_index]) {
+    const AgitationMovement *movement = loaded_sequence[current_movement_index];
+    TRACE_EVENT(MovementStart, static_cast<uint32_t>(movement->getType()),
+                current_movement_index, movement->getTotalTicks());
+  }
+}
+
 const AgitationStepStatic *AgitationProcessInterpreter::getCurrentStep() const {
   if (!process || current_step_index >= process->steps_length) {
     return nullptr;
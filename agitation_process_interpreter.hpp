@@ -10,16 +10,107 @@
 
 enum class AgitationProcessState { Idle, Running, Complete, Error };
 
+// Why a process is in the Error state
+enum class AgitationProcessError {
+  None,
+  TooManySteps, // More than AgitationProcessInterpreter::MAX_STEPS
+  StepTooLarge, // A step did not fit its movement pool
+  StepEmpty,    // A step loaded no movements
+};
+
+/**
+ * @brief Where a run of a process is, enough to continue it exactly there
+ * Plain data, to be stored as is and handed back to restoreCursor() with the
+ * same process after a restart.
+ */
+struct AgitationCursor {
+  // The running movement and every loop it is nested in
+  static constexpr size_t MAX_LEVELS = MovementLoader::MAX_NESTING_DEPTH + 1;
+
+  // One movement on the path to the running one, outermost first: its index
+  // in the enclosing sequence and how far into it the run is
+  struct Level {
+    uint16_t index;
+    uint16_t reserved;
+    uint32_t elapsed;
+    uint32_t iteration; // Loops only
+  };
+
+  uint32_t elapsed_ticks;
+  uint32_t step_elapsed;
+  uint16_t step_index;
+  uint8_t levels_length;
+  uint8_t movement_completed;
+  Level levels[MAX_LEVELS];
+};
+
+static_assert(sizeof(AgitationCursor) == 72, "Cursors are stored as is");
+
 class AgitationProcessInterpreter {
 public:
+  // Steps a process may have; init() puts a process with more in the Error
+  // state, as there is no room for its time estimates
+  static constexpr size_t MAX_STEPS = AGITATION_PROCESS_MAX_STEPS;
+
   AgitationProcessInterpreter();
 
   void init(const AgitationProcessStatic *process,
             MotorController *motor_controller);
+
+  // Whether steps load through the peephole pass of MovementLoader, on by
+  // default. Set before init(); a cursor only restores with the same setting
+  // it was saved with.
+  void setOptimize(bool optimize) {
+    for (StepBuffer &buffer : step_buffers) {
+      buffer.loader.setOptimize(optimize);
+    }
+  }
   bool tick();
+
+  // Same final state as `ticks` calls to tick(), at a cost that depends on
+  // the number of movements passed and their nesting, not on `ticks`. The
+  // motor only sees the commands in effect at movement boundaries.
+  bool advanceBy(uint32_t ticks);
+
+  // Fast-forward to `ticks` since init(); does nothing if already past it
+  bool advanceTo(uint32_t ticks);
+
+  // Ticks run since init()
+  uint32_t getElapsedTicks() const { return elapsed_ticks; }
+
+  // Clock-driven use. Ticks fall due every AGITATION_TICK_MS of a monotonic
+  // ms clock, furi_get_tick() on the device, counted from the last anchor().
+  // Every time is computed from the anchor, so however late the calls come
+  // the error never exceeds one tick. Times may wrap around.
+
+  // Starts counting at `now_ms`, with tick getElapsedTicks() + 1 due one tick
+  // later. Call after init() and on anything that should not count, such as
+  // resuming from a pause.
+  void anchor(uint32_t now_ms);
+
+  // Ticks since init() due by `now_ms`
+  uint32_t ticksDueAt(uint32_t now_ms) const;
+
+  // Time tick number `ticks` since init() falls due
+  uint32_t tickTimeMs(uint32_t ticks) const;
+
+  // Runs every tick due by `now_ms` in one call, catching up on ticks missed
+  // while the caller was stalled. Only the motor command in effect at the
+  // last of them reaches the motor, never those of movements already over.
+  bool runUntil(uint32_t now_ms);
+
   void reset();
   void confirm();
 
+  // Saves where the running process is; false unless a step is running and
+  // its path fits a cursor
+  bool saveCursor(AgitationCursor &cursor) const;
+
+  // Continues at a saved cursor, right after init() with the process it was
+  // saved from. The motor is not touched before the next tick. False, with
+  // the process back at its start, if the cursor does not fit the process.
+  bool restoreCursor(const AgitationCursor &cursor);
+
   // Advances to the next step and resets the interpreter state
   void advanceToNextStep();
 
@@ -32,10 +123,32 @@ public:
   size_t getCurrentStepIndex() const { return current_step_index; }
   const AgitationProcessStatic *getCurrentProcess() const { return process; }
   AgitationProcessState getState() const { return process_state; }
+  AgitationProcessError getError() const { return process_error; }
+
+  // Changes whenever the step, the running movement or the process state
+  // does, so callers can tell when to refresh what they derive from them
+  uint32_t getGeneration() const { return generation; }
+
+  // Movement times are in ticks of AGITATION_TICK_MS
   uint32_t getCurrentMovementTimeRemaining() const;
   uint32_t getCurrentMovementTimeElapsed() const;
   uint32_t getCurrentMovementDuration() const;
 
+  // Remaining time in ticks, AgitationMovement::UNBOUNDED_DURATION if the
+  // step or process never ends on its own. Waiting for the user at a step's
+  // own prompts is not counted, the step clock stops there; a loop that
+  // waits only ends on its own at its max_duration, see SequenceStats.
+  // Step durations are computed once in init().
+  uint32_t getStepDuration() const;
+  uint32_t getStepTimeRemaining() const;
+  uint32_t getProcessTimeRemaining() const;
+
+  // Ticks until the next tick that changes motor or movement state. The ticks
+  // before it only repeat the current command, so the caller can sleep until
+  // then and run them in one batch. Returns AgitationMovement::NO_PENDING_EVENT
+  // when only user input (or nothing) can move the process forward.
+  uint32_t nextEventIn() const;
+
   // Advances to the next movement in the current sequence
   void advanceToNextMovement();
 
@@ -43,13 +156,63 @@ public:
   const AgitationStepStatic* getCurrentStep() const;
   const AgitationMovement* getCurrentMovement() const;
 
+  // Pool usage of the running step, and the most any step has needed
+  const MovementFactory &getMovementFactory() const {
+    return active_buffer->factory;
+  }
+
+  // True once the step after the current one is loaded and ready to swap in
+  bool isNextStepPreloaded() const;
+
 private:
-  void initializeMovementSequence(const AgitationStepStatic *step);
+  static constexpr size_t NO_STEP = SIZE_MAX;
+
+  // One loaded step: its movements and the pool they live in
+  struct StepBuffer {
+    MovementFactory factory;
+    MovementLoader loader{factory};
+    AgitationMovement *sequence[MovementLoader::MAX_SEQUENCE_LENGTH];
+    size_t length;
+    size_t step_index; // NO_STEP if nothing usable is loaded
+  };
+
+  // Loads step `step_index` into `buffer`, replacing what it held
+  bool loadStep(StepBuffer &buffer, size_t step_index);
+
+  // Makes `step_index` the running step, swapping in the preloaded buffer
+  // when it holds that step and loading it on the spot otherwise
+  bool activateStep(size_t step_index);
+
+  // Loads the next step into the pending buffer while the motor is idle
+  void preloadNextStep();
+
+  void computeStepDurations();
+
+  // Records the start of the current movement in the trace
+  void traceMovementStart() const;
+
+  // Advances the running movement by up to `ticks`, sending only the last
+  // motor command, and stops at the first movement or step boundary
+  uint32_t skipWithinMovement(uint32_t ticks);
 
   // Process state
   const AgitationProcessStatic *process;
   size_t current_step_index;
   AgitationProcessState process_state;
+  AgitationProcessError process_error;
+  uint32_t elapsed_ticks;
+
+  // Clock time at which elapsed_ticks was anchor_ticks
+  uint32_t anchor_ms;
+  uint32_t anchor_ticks;
+
+  uint32_t generation;
+
+  // Time estimates: duration of each step, the time all steps after it
+  // take, and how far into the current step we are
+  uint32_t step_duration[MAX_STEPS];
+  uint32_t time_after_step[MAX_STEPS];
+  uint32_t step_elapsed;
 
   // Temperature tracking
   float current_temperature;
@@ -58,10 +221,14 @@ private:
   // Motor control
   MotorController *motor_controller;
 
-  // Movement system
-  MovementFactory movement_factory;
-  MovementLoader movement_loader;
-  AgitationMovement *loaded_sequence[MovementLoader::MAX_SEQUENCE_LENGTH];
+  // Movement system. The running step lives in active_buffer while the next
+  // one is loaded into pending_buffer during pauses, so a step boundary is a
+  // pointer swap. Each buffer holds a single step, so a process needs twice
+  // the pool its largest step takes.
+  StepBuffer step_buffers[2];
+  StepBuffer *active_buffer;
+  StepBuffer *pending_buffer;
+  AgitationMovement **loaded_sequence;
   size_t sequence_length;
   size_t current_movement_index;
 
@@ -0,0 +1,1119 @@
+#include "agitation_sequence.hpp"
+#include <string.h>
+
+// Streaming loader and writer for the YAML subset described at
+// agitation_process_from_yaml(). Lines are read through a fixed buffer and
+// handled one at a time; the result is built straight into the arena as the
+// static tables the interpreter runs.
+//
+// Items of a sequence must end up next to each other, but the items of a
+// loop body arrive in the middle of the sequence the loop is in. Items are
+// therefore stacked at the end of the arena while their sequence is open and
+// copied down next to the loaded data once it is complete, by which time all
+// the sequences nested in it are complete and unstacked too.
+
+namespace {
+
+enum class FrameKind : uint8_t { Process, StepList, Step, MovementList, Movement };
+
+// Indentation of a list whose first item has not been read yet
+constexpr int16_t INDENT_UNSET = -1;
+
+/**
+ * @brief A mapping or list the parser is inside of
+ * Mappings fill in `record`, a process, step or movement. Lists stack their
+ * items below `mark`, the first one at `first`.
+ */
+struct Frame {
+    FrameKind kind;
+    int16_t indent;
+    uint16_t seen; // Keys given so far, one bit each
+    size_t count;
+    void* record;
+    uint8_t* mark;
+    uint8_t* first;
+};
+
+// Process, step list, step and a movement list with a movement in it, plus a
+// list and a movement for every loop level
+constexpr size_t MAX_FRAMES = 5 + 2 * AGITATION_YAML_MAX_LOOP_DEPTH;
+
+struct YamlParser {
+    AgitationArena* arena;
+    uint8_t* top; // Working state is stacked from the arena end down to here
+    AgitationYamlError* error;
+    uint32_t line;
+    bool failed;
+    bool started;
+
+    AgitationProcessStatic* process;
+    Frame frames[MAX_FRAMES];
+    size_t depth;
+
+    // Unconsumed input starts at text[start]
+    char text[AGITATION_YAML_LINE_MAX];
+    size_t start;
+    size_t length;
+};
+
+// A line split into its parts
+struct YamlLine {
+    int16_t column; // Of the key, or of the dash for list items
+    int16_t content_column; // Of the key
+    bool item;
+    const char* key;
+    size_t key_length;
+    const char* value; // Up to the end of the line, comments included
+    const char* end;
+};
+
+enum KeyBit : uint16_t {
+    KeyName = 1 << 0,
+    KeyDescription = 1 << 1,
+    KeyTemperature = 1 << 2,
+    KeySequence = 1 << 3,
+    KeyFilmType = 1 << 4,
+    KeyTankType = 1 << 5,
+    KeyChemistry = 1 << 6,
+    KeySteps = 1 << 7,
+    KeyType = 1 << 8,
+    KeyCount = 1 << 9,
+    KeyMaxDuration = 1 << 10,
+};
+
+const char EMPTY_STRING[] = "";
+
+// Records the first error; always false
+bool fail(YamlParser& parser, const char* message) {
+    if(!parser.failed && parser.error) {
+        parser.error->line = parser.line;
+        parser.error->message = message;
+    }
+    parser.failed = true;
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Arena
+//------------------------------------------------------------------------------
+
+void note_peak(YamlParser& parser) {
+    AgitationArena* arena = parser.arena;
+    size_t in_use = arena->used + (size_t)(arena->memory + arena->size - parser.top);
+    if(in_use > arena->peak) {
+        arena->peak = in_use;
+    }
+}
+
+// Loaded data, packed from the start
+void* arena_alloc(YamlParser& parser, size_t size, size_t align) {
+    AgitationArena* arena = parser.arena;
+    uintptr_t base = (uintptr_t)arena->memory;
+    uintptr_t at = (base + arena->used + align - 1) & ~(uintptr_t)(align - 1);
+    if(at > (uintptr_t)parser.top || size > (uintptr_t)parser.top - at) {
+        fail(parser, "process does not fit in memory");
+        return nullptr;
+    }
+    arena->used = (size_t)(at - base) + size;
+    note_peak(parser);
+    return (void*)at;
+}
+
+// Working state, stacked from the end
+void* scratch_push(YamlParser& parser, size_t size, size_t align) {
+    uintptr_t bottom = (uintptr_t)parser.arena->memory + parser.arena->used;
+    uintptr_t top = (uintptr_t)parser.top;
+    if(size > top - bottom) {
+        fail(parser, "process does not fit in memory");
+        return nullptr;
+    }
+    uintptr_t at = (top - size) & ~(uintptr_t)(align - 1);
+    if(at < bottom) {
+        fail(parser, "process does not fit in memory");
+        return nullptr;
+    }
+    parser.top = (uint8_t*)at;
+    note_peak(parser);
+    return (void*)at;
+}
+
+//------------------------------------------------------------------------------
+// Scalars
+//------------------------------------------------------------------------------
+
+const char* skip_spaces(const char* at, const char* end) {
+    while(at < end && *at == ' ') {
+        at++;
+    }
+    return at;
+}
+
+// Nothing but spaces and maybe a comment left
+bool is_blank(const char* at, const char* end) {
+    at = skip_spaces(at, end);
+    return at == end || *at == '#';
+}
+
+// Plain scalar: up to a comment or the end of the line, without the spaces
+// around it
+void plain_scalar(const char*& at, const char*& end) {
+    at = skip_spaces(at, end);
+    const char* stop = at;
+    while(stop < end && !(*stop == '#' && (stop == at || stop[-1] == ' '))) {
+        stop++;
+    }
+    while(stop > at && stop[-1] == ' ') {
+        stop--;
+    }
+    end = stop;
+}
+
+bool parse_uint(YamlParser& parser, const char* at, const char* end, uint32_t& value) {
+    plain_scalar(at, end);
+    if(at == end) {
+        return fail(parser, "expected a number");
+    }
+    uint32_t result = 0;
+    for(; at < end; at++) {
+        if(*at < '0' || *at > '9') {
+            return fail(parser, "expected a number");
+        }
+        uint32_t digit = (uint32_t)(*at - '0');
+        if(result > (UINT32_MAX - digit) / 10) {
+            return fail(parser, "number too large");
+        }
+        result = result * 10 + digit;
+    }
+    value = result;
+    return true;
+}
+
+// Seconds, or milliseconds with an ms suffix, as a static table duration
+bool parse_duration(YamlParser& parser, const char* at, const char* end, uint32_t& duration) {
+    plain_scalar(at, end);
+    bool ms = false;
+    if(end - at > 2 && end[-2] == 'm' && end[-1] == 's') {
+        ms = true;
+        end -= 2;
+    } else if(end - at > 1 && end[-1] == 's') {
+        end--;
+    }
+
+    uint32_t value;
+    if(!parse_uint(parser, at, end, value)) {
+        return false;
+    }
+    if(ms) {
+        if(value & AGITATION_DURATION_MS_FLAG) {
+            return fail(parser, "duration too long");
+        }
+        duration = AGITATION_MS(value);
+    } else {
+        // Must still count in ticks without overflowing
+        if(value > (AGITATION_DURATION_MS_FLAG - 1) / AGITATION_TICKS_PER_SECOND) {
+            return fail(parser, "duration too long");
+        }
+        duration = value;
+    }
+    return true;
+}
+
+// Temperatures are read as an integer mantissa and a number of decimals.
+// Mantissas below 2^23 are exact as floats and stay exact through the
+// division, which lets the writer recover them from the float.
+constexpr uint32_t TEMPERATURE_MANTISSA_LIMIT = 1u << 23;
+constexpr uint32_t TEMPERATURE_MAX_DECIMALS = 8;
+
+// Value of a temperature written as `mantissa` with `decimals` of its digits
+// after the point
+float temperature_value(uint32_t mantissa, uint32_t decimals, bool negative) {
+    float scale = 1;
+    for(uint32_t i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    float value = (float)mantissa / scale;
+    return negative ? -value : value;
+}
+
+// [-]digits[.digits]
+bool parse_temperature(YamlParser& parser, const char* at, const char* end, float& value) {
+    plain_scalar(at, end);
+    bool negative = at < end && *at == '-';
+    if(negative) {
+        at++;
+    }
+
+    uint32_t mantissa = 0;
+    uint32_t digits = 0;
+    uint32_t decimals = 0;
+    bool point = false;
+    for(; at < end; at++) {
+        if(*at == '.' && !point) {
+            point = true;
+        } else if(*at >= '0' && *at <= '9') {
+            mantissa = mantissa * 10 + (uint32_t)(*at - '0');
+            digits++;
+            decimals += point;
+            if(mantissa >= TEMPERATURE_MANTISSA_LIMIT || decimals > TEMPERATURE_MAX_DECIMALS) {
+                return fail(parser, "temperature too precise");
+            }
+        } else {
+            return fail(parser, "expected a temperature");
+        }
+    }
+    if(digits == 0) {
+        return fail(parser, "expected a temperature");
+    }
+    value = temperature_value(mantissa, decimals, negative);
+    return true;
+}
+
+// Plain, 'single' or "double" quoted, copied into the arena once. Double
+// quotes take \" \\ and \n escapes, single quotes '' for a quote.
+bool parse_string(YamlParser& parser, const char* at, const char* end, const char*& string) {
+    at = skip_spaces(at, end);
+    char quote = (at < end && (*at == '"' || *at == '\'')) ? *at : 0;
+    if(!quote) {
+        plain_scalar(at, end);
+        // Flow collections, anchors, tags and block scalars
+        if(at < end && strchr("[]{}&*!|>%@`", *at)) {
+            return fail(parser, "unsupported YAML");
+        }
+        if(at == end) {
+            string = EMPTY_STRING;
+            return true;
+        }
+        char* copy = (char*)arena_alloc(parser, (size_t)(end - at) + 1, 1);
+        if(!copy) {
+            return false;
+        }
+        memcpy(copy, at, (size_t)(end - at));
+        copy[end - at] = '\0';
+        string = copy;
+        return true;
+    }
+
+    // Quoted text only gets shorter unescaped, so reserve its length and give
+    // back what is left over
+    at++;
+    char* copy = (char*)arena_alloc(parser, (size_t)(end - at) + 1, 1);
+    if(!copy) {
+        return false;
+    }
+    char* out = copy;
+    for(;;) {
+        if(at == end) {
+            return fail(parser, "unterminated string");
+        }
+        char c = *at++;
+        if(c == quote) {
+            if(quote == '\'' && at < end && *at == '\'') {
+                *out++ = *at++;
+                continue;
+            }
+            break;
+        }
+        if(quote == '"' && c == '\\') {
+            if(at == end) {
+                return fail(parser, "unterminated string");
+            }
+            c = *at++;
+            if(c == 'n') {
+                c = '\n';
+            } else if(c != '"' && c != '\\') {
+                return fail(parser, "unknown escape");
+            }
+        }
+        *out++ = c;
+    }
+    *out++ = '\0';
+    parser.arena->used = (size_t)((uint8_t*)out - parser.arena->memory);
+
+    if(!is_blank(at, end)) {
+        return fail(parser, "unexpected text after string");
+    }
+    string = copy;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Structure
+//------------------------------------------------------------------------------
+
+bool key_is(const YamlLine& line, const char* key) {
+    return strlen(key) == line.key_length && memcmp(line.key, key, line.key_length) == 0;
+}
+
+// Marks `bit` seen in `frame`; false if it already was
+bool first_time(YamlParser& parser, Frame& frame, uint16_t bit) {
+    if(frame.seen & bit) {
+        return fail(parser, "duplicate key");
+    }
+    frame.seen |= bit;
+    return true;
+}
+
+Frame* push_frame(YamlParser& parser, FrameKind kind, int16_t indent) {
+    if(parser.depth == MAX_FRAMES) {
+        fail(parser, "loops nested too deep");
+        return nullptr;
+    }
+    Frame& frame = parser.frames[parser.depth++];
+    frame = Frame{kind, indent, 0, 0, nullptr, parser.top, nullptr};
+    return &frame;
+}
+
+// Opens the list under a key, which must have no value of its own
+bool open_list(YamlParser& parser, const YamlLine& line, FrameKind kind) {
+    if(!is_blank(line.value, line.end)) {
+        return fail(parser, "expected a list on the next lines");
+    }
+    return push_frame(parser, kind, INDENT_UNSET) != nullptr;
+}
+
+// Starts the next item of the list on top
+bool open_item(YamlParser& parser, const YamlLine& line) {
+    Frame& list = parser.frames[parser.depth - 1];
+    size_t size;
+    size_t align;
+    if(list.kind == FrameKind::StepList) {
+        size = sizeof(AgitationStepStatic);
+        align = alignof(AgitationStepStatic);
+    } else {
+        if(list.count == AGITATION_YAML_MAX_SEQUENCE_LENGTH) {
+            return fail(parser, "sequence too long");
+        }
+        size = sizeof(AgitationMovementStatic);
+        align = alignof(AgitationMovementStatic);
+    }
+
+    void* record = scratch_push(parser, size, align);
+    if(!record) {
+        return false;
+    }
+    memset(record, 0, size);
+    if(list.kind == FrameKind::StepList) {
+        ((AgitationStepStatic*)record)->description = EMPTY_STRING;
+    }
+    if(list.count == 0) {
+        list.first = (uint8_t*)record;
+    }
+    list.count++;
+
+    FrameKind kind = list.kind == FrameKind::StepList ? FrameKind::Step : FrameKind::Movement;
+    Frame* item = push_frame(parser, kind, line.content_column);
+    if(!item) {
+        return false;
+    }
+    item->record = record;
+    return true;
+}
+
+// Copies the items of a complete list next to the loaded data and unstacks
+// them; returns the copy
+template <typename T>
+T* close_list(YamlParser& parser, const Frame& list) {
+    if(list.count == 0) {
+        fail(parser, "empty list");
+        return nullptr;
+    }
+    T* items = (T*)arena_alloc(parser, list.count * sizeof(T), alignof(T));
+    if(!items) {
+        return nullptr;
+    }
+    // Stacked downwards, so the first item is at the highest address
+    for(size_t i = 0; i < list.count; i++) {
+        memcpy(&items[i], list.first - i * sizeof(T), sizeof(T));
+    }
+    parser.top = list.mark;
+    return items;
+}
+
+bool close_frame(YamlParser& parser) {
+    Frame& frame = parser.frames[--parser.depth];
+    Frame* parent = parser.depth > 0 ? &parser.frames[parser.depth - 1] : nullptr;
+
+    switch(frame.kind) {
+    case FrameKind::Process:
+        if(!(frame.seen & KeyName)) {
+            return fail(parser, "process has no process_name");
+        }
+        if(!(frame.seen & KeySteps)) {
+            return fail(parser, "process has no steps");
+        }
+        return true;
+
+    case FrameKind::StepList: {
+        AgitationStepStatic* steps = close_list<AgitationStepStatic>(parser, frame);
+        if(!steps) {
+            return false;
+        }
+        parser.process->steps = steps;
+        parser.process->steps_length = frame.count;
+        return true;
+    }
+
+    case FrameKind::Step:
+        if(!(frame.seen & KeyTemperature)) {
+            ((AgitationStepStatic*)frame.record)->temperature = parser.process->temperature;
+        }
+        if(!(frame.seen & KeyName)) {
+            return fail(parser, "step has no name");
+        }
+        if(!(frame.seen & KeySequence)) {
+            return fail(parser, "step has no sequence");
+        }
+        return true;
+
+    case FrameKind::MovementList: {
+        AgitationMovementStatic* sequence = close_list<AgitationMovementStatic>(parser, frame);
+        if(!sequence) {
+            return false;
+        }
+        if(parent->kind == FrameKind::Step) {
+            AgitationStepStatic* step = (AgitationStepStatic*)parent->record;
+            step->sequence = sequence;
+            step->sequence_length = frame.count;
+        } else {
+            AgitationMovementStatic* loop = (AgitationMovementStatic*)parent->record;
+            loop->loop.sequence = sequence;
+            loop->loop.sequence_length = frame.count;
+        }
+        return true;
+    }
+
+    case FrameKind::Movement: {
+        const AgitationMovementStatic* movement = (const AgitationMovementStatic*)frame.record;
+        if(movement->type == AgitationMovementTypeLoop && !(frame.seen & KeySequence)) {
+            return fail(parser, "loop has no sequence");
+        }
+        return true;
+    }
+    }
+    return false;
+}
+
+// Loop nesting of a movement list about to be opened under `frame`
+size_t loop_depth(const YamlParser& parser) {
+    size_t depth = 0;
+    for(size_t i = 0; i < parser.depth; i++) {
+        if(parser.frames[i].kind == FrameKind::MovementList) {
+            depth++;
+        }
+    }
+    return depth;
+}
+
+bool handle_process_key(YamlParser& parser, Frame& frame, const YamlLine& line) {
+    AgitationProcessStatic* process = parser.process;
+    if(key_is(line, "process_name")) {
+        return first_time(parser, frame, KeyName) &&
+               parse_string(parser, line.value, line.end, process->process_name);
+    } else if(key_is(line, "film_type")) {
+        return first_time(parser, frame, KeyFilmType) &&
+               parse_string(parser, line.value, line.end, process->film_type);
+    } else if(key_is(line, "tank_type")) {
+        return first_time(parser, frame, KeyTankType) &&
+               parse_string(parser, line.value, line.end, process->tank_type);
+    } else if(key_is(line, "chemistry")) {
+        return first_time(parser, frame, KeyChemistry) &&
+               parse_string(parser, line.value, line.end, process->chemistry);
+    } else if(key_is(line, "temperature")) {
+        return first_time(parser, frame, KeyTemperature) &&
+               parse_temperature(parser, line.value, line.end, process->temperature);
+    } else if(key_is(line, "steps")) {
+        return first_time(parser, frame, KeySteps) &&
+               open_list(parser, line, FrameKind::StepList);
+    }
+    return fail(parser, "unknown process key");
+}
+
+bool handle_step_key(YamlParser& parser, Frame& frame, const YamlLine& line) {
+    AgitationStepStatic* step = (AgitationStepStatic*)frame.record;
+    if(key_is(line, "name")) {
+        return first_time(parser, frame, KeyName) &&
+               parse_string(parser, line.value, line.end, step->name);
+    } else if(key_is(line, "description")) {
+        return first_time(parser, frame, KeyDescription) &&
+               parse_string(parser, line.value, line.end, step->description);
+    } else if(key_is(line, "temperature")) {
+        return first_time(parser, frame, KeyTemperature) &&
+               parse_temperature(parser, line.value, line.end, step->temperature);
+    } else if(key_is(line, "sequence")) {
+        return first_time(parser, frame, KeySequence) &&
+               open_list(parser, line, FrameKind::MovementList);
+    }
+    return fail(parser, "unknown step key");
+}
+
+bool handle_movement_key(YamlParser& parser, Frame& frame, const YamlLine& line) {
+    AgitationMovementStatic* movement = (AgitationMovementStatic*)frame.record;
+
+    if(!(frame.seen & KeyType)) {
+        frame.seen |= KeyType;
+        if(key_is(line, "cw")) {
+            movement->type = AgitationMovementTypeCW;
+        } else if(key_is(line, "ccw")) {
+            movement->type = AgitationMovementTypeCCW;
+        } else if(key_is(line, "pause")) {
+            movement->type = AgitationMovementTypePause;
+        } else if(key_is(line, "loop")) {
+            movement->type = AgitationMovementTypeLoop;
+            if(is_blank(line.value, line.end)) {
+                return true;
+            }
+            frame.seen |= KeyCount;
+            return parse_uint(parser, line.value, line.end, movement->loop.count);
+        } else if(key_is(line, "wait_user")) {
+            movement->type = AgitationMovementTypeWaitUser;
+            if(is_blank(line.value, line.end)) {
+                return true;
+            }
+            return parse_string(parser, line.value, line.end, movement->message);
+        } else {
+            return fail(parser, "movement must start with its type");
+        }
+        return parse_duration(parser, line.value, line.end, movement->duration);
+    }
+
+    if(movement->type != AgitationMovementTypeLoop) {
+        return fail(parser, "unknown movement key");
+    }
+    if(key_is(line, "count")) {
+        return first_time(parser, frame, KeyCount) &&
+               parse_uint(parser, line.value, line.end, movement->loop.count);
+    } else if(key_is(line, "max_duration")) {
+        return first_time(parser, frame, KeyMaxDuration) &&
+               parse_duration(parser, line.value, line.end, movement->loop.max_duration);
+    } else if(key_is(line, "sequence")) {
+        if(loop_depth(parser) > AGITATION_YAML_MAX_LOOP_DEPTH) {
+            return fail(parser, "loops nested too deep");
+        }
+        return first_time(parser, frame, KeySequence) &&
+               open_list(parser, line, FrameKind::MovementList);
+    }
+    return fail(parser, "unknown loop key");
+}
+
+bool handle_key(YamlParser& parser, Frame& frame, const YamlLine& line) {
+    switch(frame.kind) {
+    case FrameKind::Process:
+        return handle_process_key(parser, frame, line);
+    case FrameKind::Step:
+        return handle_step_key(parser, frame, line);
+    case FrameKind::Movement:
+        return handle_movement_key(parser, frame, line);
+    default:
+        return fail(parser, "unexpected key");
+    }
+}
+
+// Closes whatever the line's indentation ends, then hands the line to the
+// mapping or list it belongs to
+bool handle_line(YamlParser& parser, const YamlLine& line) {
+    while(parser.depth > 0) {
+        Frame& frame = parser.frames[parser.depth - 1];
+        bool is_list = frame.kind == FrameKind::StepList ||
+                       frame.kind == FrameKind::MovementList;
+
+        if(is_list) {
+            // Items may line up with the key that opened the list; items
+            // further out belong to an outer list and leave this one empty
+            if(frame.indent == INDENT_UNSET && line.item &&
+               line.column >= parser.frames[parser.depth - 2].indent) {
+                frame.indent = line.column;
+            }
+            if(line.item && line.column == frame.indent) {
+                return open_item(parser, line) &&
+                       handle_key(parser, parser.frames[parser.depth - 1], line);
+            }
+            if(frame.indent != INDENT_UNSET && line.column > frame.indent) {
+                return fail(parser, "unexpected indentation");
+            }
+        } else {
+            if(line.column == frame.indent && !line.item) {
+                return handle_key(parser, frame, line);
+            }
+            if(line.column > frame.indent) {
+                return fail(parser, "unexpected indentation");
+            }
+            if(frame.kind == FrameKind::Process) {
+                return fail(parser, "unexpected list item");
+            }
+        }
+
+        if(!close_frame(parser)) {
+            return false;
+        }
+    }
+    return fail(parser, "unexpected line");
+}
+
+// Splits a line; false for blank and comment lines, and on errors, which are
+// reported
+bool split_line(YamlParser& parser, const char* text, const char* end, YamlLine& line) {
+    for(const char* at = text; at < end; at++) {
+        if(*at == '\t' && is_blank(text, at)) {
+            fail(parser, "tabs are not allowed for indentation");
+            return false;
+        }
+        if(*at == '\0') {
+            fail(parser, "unexpected NUL");
+            return false;
+        }
+    }
+
+    const char* at = skip_spaces(text, end);
+    if(at == end || *at == '#') {
+        return false;
+    }
+    if(!parser.started && at == text && end - at >= 3 && memcmp(at, "---", 3) == 0 &&
+       is_blank(at + 3, end)) {
+        return false;
+    }
+    line.column = (int16_t)(at - text);
+    line.item = *at == '-' && (at + 1 == end || at[1] == ' ');
+    if(line.item) {
+        at = skip_spaces(at + 1, end);
+    }
+    line.content_column = (int16_t)(at - text);
+
+    line.key = at;
+    while(at < end && ((*at >= 'a' && *at <= 'z') || *at == '_')) {
+        at++;
+    }
+    line.key_length = (size_t)(at - line.key);
+    if(line.key_length == 0 || at == end || *at != ':' || (at + 1 < end && at[1] != ' ')) {
+        fail(parser, "expected key: value");
+        return false;
+    }
+    line.value = at + 1;
+    line.end = end;
+    parser.started = true;
+    return true;
+}
+
+// Finds the next line, reading more input as needed; false at the end
+bool next_line(
+    YamlParser& parser,
+    AgitationYamlRead read,
+    void* context,
+    const char*& text,
+    const char*& end) {
+    for(;;) {
+        char* line = parser.text + parser.start;
+        char* newline = (char*)memchr(line, '\n', parser.length - parser.start);
+        if(newline) {
+            parser.start = (size_t)(newline + 1 - parser.text);
+            text = line;
+            end = newline;
+            break;
+        }
+
+        // Move the partial line to the front and read more after it
+        size_t partial = parser.length - parser.start;
+        memmove(parser.text, line, partial);
+        parser.start = 0;
+        parser.length = partial;
+        if(partial == sizeof(parser.text)) {
+            parser.line++;
+            fail(parser, "line too long");
+            return false;
+        }
+        size_t got = read(parser.text + partial, sizeof(parser.text) - partial, context);
+        if(got > sizeof(parser.text) - partial) {
+            fail(parser, "read error");
+            return false;
+        }
+        if(got == 0) {
+            if(partial == 0) {
+                return false;
+            }
+            // Last line without a newline
+            parser.start = partial;
+            text = parser.text;
+            end = parser.text + partial;
+            break;
+        }
+        parser.length += got;
+    }
+
+    parser.line++;
+    if(end > text && end[-1] == '\r') {
+        end--;
+    }
+    return true;
+}
+
+} // namespace
+
+void agitation_arena_init(AgitationArena* arena, void* memory, size_t size) {
+    arena->memory = (uint8_t*)memory;
+    arena->size = size;
+    arena->used = 0;
+    arena->peak = 0;
+}
+
+const AgitationProcessStatic* agitation_process_from_yaml(
+    AgitationYamlRead read,
+    void* context,
+    AgitationArena* arena,
+    AgitationYamlError* error) {
+    if(error) {
+        error->line = 0;
+        error->message = nullptr;
+    }
+    arena->used = 0;
+    arena->peak = 0;
+
+    // The parser is working state like any other, and too big for the app
+    // stack
+    uintptr_t arena_end = (uintptr_t)arena->memory + arena->size;
+    if(arena->size < sizeof(YamlParser) + alignof(YamlParser)) {
+        if(error) {
+            error->message = "process does not fit in memory";
+        }
+        return nullptr;
+    }
+    YamlParser* parser =
+        (YamlParser*)((arena_end - sizeof(YamlParser)) & ~(uintptr_t)(alignof(YamlParser) - 1));
+    parser->arena = arena;
+    parser->top = (uint8_t*)parser;
+    parser->error = error;
+    parser->line = 0;
+    parser->failed = false;
+    parser->started = false;
+    parser->depth = 0;
+    parser->start = 0;
+    parser->length = 0;
+    note_peak(*parser);
+
+    AgitationProcessStatic* process = (AgitationProcessStatic*)arena_alloc(
+        *parser, sizeof(AgitationProcessStatic), alignof(AgitationProcessStatic));
+    if(process) {
+        *process = AgitationProcessStatic{
+            EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, 20.0f, nullptr, 0};
+        parser->process = process;
+        push_frame(*parser, FrameKind::Process, 0);
+    }
+
+    const char* text;
+    const char* end;
+    YamlLine line;
+    while(!parser->failed && next_line(*parser, read, context, text, end)) {
+        if(split_line(*parser, text, end, line)) {
+            handle_line(*parser, line);
+        }
+    }
+    while(!parser->failed && parser->depth > 0) {
+        close_frame(*parser);
+    }
+
+    if(parser->failed) {
+        arena->used = 0;
+        return nullptr;
+    }
+    return process;
+}
+
+//------------------------------------------------------------------------------
+// Writing
+//------------------------------------------------------------------------------
+
+namespace {
+
+// Output is handed to the sink in pieces of this size
+constexpr size_t WRITE_BUFFER_SIZE = 64;
+
+struct YamlWriter {
+    AgitationYamlWrite write;
+    void* context;
+    bool failed;
+    size_t column; // Bytes written on the current line
+    size_t length; // Bytes in buffer
+    char buffer[WRITE_BUFFER_SIZE];
+};
+
+void flush(YamlWriter& writer) {
+    if(writer.length > 0 && !writer.failed) {
+        writer.failed = !writer.write(writer.buffer, writer.length, writer.context);
+    }
+    writer.length = 0;
+}
+
+void put(YamlWriter& writer, const char* data, size_t size) {
+    writer.column += size;
+    while(size > 0 && !writer.failed) {
+        size_t count = WRITE_BUFFER_SIZE - writer.length;
+        if(count > size) {
+            count = size;
+        }
+        memcpy(writer.buffer + writer.length, data, count);
+        writer.length += count;
+        data += count;
+        size -= count;
+        if(writer.length == WRITE_BUFFER_SIZE) {
+            flush(writer);
+        }
+    }
+}
+
+void put(YamlWriter& writer, const char* text) {
+    put(writer, text, strlen(text));
+}
+
+void put_indent(YamlWriter& writer, size_t indent) {
+    static const char SPACES[] = "                ";
+    while(indent > 0) {
+        size_t count = indent < sizeof(SPACES) - 1 ? indent : sizeof(SPACES) - 1;
+        put(writer, SPACES, count);
+        indent -= count;
+    }
+}
+
+// Ends the line, which must fit the loader's line buffer with its newline
+void end_line(YamlWriter& writer) {
+    if(writer.column >= AGITATION_YAML_LINE_MAX) {
+        writer.failed = true;
+    }
+    put(writer, "\n", 1);
+    writer.column = 0;
+}
+
+void put_uint(YamlWriter& writer, uint32_t value, uint32_t min_digits = 1) {
+    char digits[10];
+    size_t count = 0;
+    do {
+        digits[sizeof(digits) - ++count] = (char)('0' + value % 10);
+        value /= 10;
+    } while(value > 0 || count < min_digits);
+    put(writer, digits + sizeof(digits) - count, count);
+}
+
+void put_duration(YamlWriter& writer, uint32_t duration) {
+    if(duration & AGITATION_DURATION_MS_FLAG) {
+        put_uint(writer, duration & ~AGITATION_DURATION_MS_FLAG);
+        put(writer, "ms");
+    } else if(duration > (AGITATION_DURATION_MS_FLAG - 1) / AGITATION_TICKS_PER_SECOND) {
+        writer.failed = true;
+    } else {
+        put_uint(writer, duration);
+    }
+}
+
+// The shortest text that reads back to exactly `value`, 20.0 rather than 20
+void put_temperature(YamlWriter& writer, float value) {
+    bool negative = value < 0;
+    double magnitude = negative ? -(double)value : (double)value;
+    uint32_t scale = 1;
+    for(uint32_t decimals = 0; decimals <= TEMPERATURE_MAX_DECIMALS; decimals++) {
+        double scaled = magnitude * scale + 0.5;
+        if(!(scaled < TEMPERATURE_MANTISSA_LIMIT)) {
+            break;
+        }
+        uint32_t mantissa = (uint32_t)scaled;
+        if(temperature_value(mantissa, decimals, negative) == value) {
+            if(negative) {
+                put(writer, "-");
+            }
+            put_uint(writer, mantissa / scale);
+            if(decimals > 0) {
+                put(writer, ".");
+                put_uint(writer, mantissa % scale, decimals);
+            } else if(mantissa < TEMPERATURE_MANTISSA_LIMIT / 10) {
+                put(writer, ".0");
+            }
+            return;
+        }
+        scale *= 10;
+    }
+    writer.failed = true;
+}
+
+bool is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool equals_ignoring_case(const char* text, const char* word) {
+    for(; *text && *word; text++, word++) {
+        char c = *text >= 'A' && *text <= 'Z' ? (char)(*text - 'A' + 'a') : *text;
+        if(c != *word) {
+            return false;
+        }
+    }
+    return *text == *word;
+}
+
+// Whether `text` reads back the same unquoted, here and in other YAML
+// readers, which take words like "yes" or "null" for something else
+bool is_plain_safe(const char* text) {
+    static const char* const KEYWORDS[] = {
+        "true", "false", "yes", "no", "on", "off", "null", "y", "n"};
+    if(!is_letter(text[0])) {
+        return false;
+    }
+    for(const char* keyword : KEYWORDS) {
+        if(equals_ignoring_case(text, keyword)) {
+            return false;
+        }
+    }
+    for(const char* at = text; *at; at++) {
+        unsigned char c = (unsigned char)*at;
+        if(c < 0x20 || c == 0x7f || (c == '#' && at[-1] == ' ') ||
+           (c == ':' && (at[1] == ' ' || at[1] == '\0'))) {
+            return false;
+        }
+    }
+    return text[strlen(text) - 1] != ' ';
+}
+
+void put_string(YamlWriter& writer, const char* text) {
+    if(is_plain_safe(text)) {
+        put(writer, text);
+        return;
+    }
+    put(writer, "\"");
+    const char* run = text;
+    for(const char* at = text;; at++) {
+        const char* escape = nullptr;
+        if(*at == '"') {
+            escape = "\\\"";
+        } else if(*at == '\\') {
+            escape = "\\\\";
+        } else if(*at == '\n') {
+            escape = "\\n";
+        }
+        if(escape || *at == '\0') {
+            put(writer, run, (size_t)(at - run));
+            if(!escape) {
+                break;
+            }
+            put(writer, escape);
+            run = at + 1;
+        }
+    }
+    put(writer, "\"");
+}
+
+// `key: value` on a line of its own; nothing for a missing string
+void put_string_key(YamlWriter& writer, size_t indent, const char* key, const char* value) {
+    if(!value) {
+        return;
+    }
+    put_indent(writer, indent);
+    put(writer, key);
+    put(writer, ": ");
+    put_string(writer, value);
+    end_line(writer);
+}
+
+void put_sequence(
+    YamlWriter& writer,
+    const AgitationSequenceView& sequence,
+    size_t indent,
+    size_t depth) {
+    // The loader would not take it back
+    size_t length = sequence.getLength();
+    if(sequence.isNull() || length == 0 || length > AGITATION_YAML_MAX_SEQUENCE_LENGTH ||
+       depth > AGITATION_YAML_MAX_LOOP_DEPTH) {
+        writer.failed = true;
+        return;
+    }
+
+    for(size_t i = 0; i < length && !writer.failed; i++) {
+        put_indent(writer, indent);
+        switch(sequence.getType(i)) {
+        case AgitationMovementTypeCW:
+            put(writer, "- cw: ");
+            put_duration(writer, sequence.getDuration(i));
+            end_line(writer);
+            break;
+
+        case AgitationMovementTypeCCW:
+            put(writer, "- ccw: ");
+            put_duration(writer, sequence.getDuration(i));
+            end_line(writer);
+            break;
+
+        case AgitationMovementTypePause:
+            put(writer, "- pause: ");
+            put_duration(writer, sequence.getDuration(i));
+            end_line(writer);
+            break;
+
+        case AgitationMovementTypeWaitUser:
+            put(writer, "- wait_user:");
+            if(sequence.getMessage(i)) {
+                put(writer, " ");
+                put_string(writer, sequence.getMessage(i));
+            }
+            end_line(writer);
+            break;
+
+        case AgitationMovementTypeLoop:
+            put(writer, "- loop: ");
+            put_uint(writer, sequence.getLoopCount(i));
+            end_line(writer);
+            if(sequence.getLoopMaxDuration(i)) {
+                put_indent(writer, indent + 2);
+                put(writer, "max_duration: ");
+                put_duration(writer, sequence.getLoopMaxDuration(i));
+                end_line(writer);
+            }
+            put_indent(writer, indent + 2);
+            put(writer, "sequence:");
+            end_line(writer);
+            put_sequence(writer, sequence.getLoopBody(i), indent + 4, depth + 1);
+            break;
+
+        default:
+            writer.failed = true;
+            break;
+        }
+    }
+}
+
+} // namespace
+
+bool agitation_process_to_yaml(
+    const AgitationProcessStatic* process,
+    AgitationYamlWrite write,
+    void* context) {
+    YamlWriter writer;
+    writer.write = write;
+    writer.context = context;
+    writer.failed = !process->process_name || process->steps_length == 0;
+    writer.column = 0;
+    writer.length = 0;
+
+    put_string_key(writer, 0, "process_name", process->process_name);
+    put_string_key(writer, 0, "film_type", process->film_type);
+    put_string_key(writer, 0, "tank_type", process->tank_type);
+    put_string_key(writer, 0, "chemistry", process->chemistry);
+    put(writer, "temperature: ");
+    put_temperature(writer, process->temperature);
+    end_line(writer);
+    put(writer, "steps:");
+    end_line(writer);
+
+    for(size_t i = 0; i < process->steps_length && !writer.failed; i++) {
+        const AgitationStepStatic& step = process->steps[i];
+        if(!step.name) {
+            writer.failed = true;
+            break;
+        }
+        put(writer, "  - name: ");
+        put_string(writer, step.name);
+        end_line(writer);
+        put_string_key(writer, 4, "description", step.description);
+        put(writer, "    temperature: ");
+        put_temperature(writer, step.temperature);
+        end_line(writer);
+        put(writer, "    sequence:");
+        end_line(writer);
+        put_sequence(writer, AgitationSequenceView::of(step), 6, 0);
+    }
+
+    flush(writer);
+    return !writer.failed;
+}
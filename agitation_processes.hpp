@@ -5,3 +5,11 @@
 #include "processes/stand_dev_process.hpp"
 #include "processes/continuous_gentle_process.hpp"
 #include "processes/c41_process.hpp"
+
+#include "movement/sequence_analysis.hpp"
+
+// Built-in processes must load completely, checked at build time
+AGITATION_VERIFY_PROCESS(BW_STANDARD_DEV_STATIC);
+AGITATION_VERIFY_PROCESS(STAND_DEV_STATIC);
+AGITATION_VERIFY_PROCESS(CONTINUOUS_GENTLE_STATIC);
+AGITATION_VERIFY_PROCESS(C41_FULL_PROCESS_STATIC);
@@ -0,0 +1,357 @@
+#include "agitation_sequence.hpp"
+#include "movement/movement_loader.hpp"
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t duration_add(uint32_t a, uint32_t b) {
+    return a > AGITATION_DURATION_INFINITE - b ? AGITATION_DURATION_INFINITE : a + b;
+}
+
+static uint32_t duration_mul(uint32_t a, uint32_t b) {
+    return (a != 0 && b > AGITATION_DURATION_INFINITE / a) ? AGITATION_DURATION_INFINITE :
+                                                               a * b;
+}
+
+// `in_loop` for a loop body, where waiting for the user takes unbounded time
+// instead of none
+static uint32_t sequence_duration(AgitationMovement_* sequence, size_t length, bool in_loop) {
+    uint32_t total = 0;
+
+    for(size_t i = 0; i < length; i++) {
+        const AgitationMovement_& movement = sequence[i];
+
+        switch(movement.type) {
+        case AgitationMovementTypeCW:
+        case AgitationMovementTypeCCW:
+        case AgitationMovementTypePause: {
+            uint32_t ticks = agitation_duration_to_ticks(movement.duration);
+            total = duration_add(total, ticks > 0 ? ticks : 1);
+            break;
+        }
+
+        case AgitationMovementTypeLoop: {
+            if(movement.loop.sequence_length == 0) {
+                break;
+            }
+
+            uint32_t max_duration = agitation_duration_to_ticks(movement.loop.max_duration);
+            uint32_t loop_total = AGITATION_DURATION_INFINITE;
+            if(movement.loop.count > 0) {
+                uint32_t body = sequence_duration(
+                    movement.loop.sequence, movement.loop.sequence_length, true);
+                loop_total = duration_mul(body, movement.loop.count);
+            }
+            if(max_duration > 0 && max_duration < loop_total) {
+                loop_total = max_duration;
+            }
+            total = duration_add(total, loop_total);
+            break;
+        }
+
+        case AgitationMovementTypeWaitUser:
+            if(in_loop) {
+                total = AGITATION_DURATION_INFINITE;
+            }
+            break;
+        }
+    }
+
+    return total;
+}
+
+uint32_t agitation_sequence_get_duration(AgitationMovement_* sequence, size_t length) {
+    return sequence_duration(sequence, length, false);
+}
+
+//------------------------------------------------------------------------------
+// Validation
+//------------------------------------------------------------------------------
+
+static_assert(
+    AGITATION_ISSUE_PATH_MAX == MovementLoader::MAX_NESTING_DEPTH + 1,
+    "A path holds a movement nested as deep as the loader allows");
+
+void agitation_validation_init(AgitationValidation* validation) {
+    memset(validation, 0, sizeof(*validation));
+}
+
+bool agitation_issue_is_error(AgitationIssueKind kind) {
+    return kind < AgitationIssueInfiniteLoop;
+}
+
+void agitation_issue_format(const AgitationIssue* issue, char* buffer, size_t size) {
+    static const char* const messages[] = {
+        "more steps than a process may have",
+        "unknown movement type",
+        "no movements",
+        "never reached, follows a movement that never ends",
+        "sequence too long, the rest is not loaded",
+        "loops nested too deep",
+        "does not fit the movement pool",
+        "loop never ends",
+        "sequence longer than built-in tables may be",
+    };
+
+    size_t length = 0;
+    int written = snprintf(buffer, size, "step %u", (unsigned)issue->step);
+    for(size_t i = 0; i <= issue->path_length && written >= 0; i++) {
+        length += (size_t)written;
+        if(length >= size) {
+            return;
+        }
+        if(i == issue->path_length) {
+            written = snprintf(buffer + length, size - length, ": %s", messages[issue->kind]);
+        } else {
+            written = snprintf(
+                buffer + length, size - length, i == 0 ? ", %u" : ".%u", issue->path[i]);
+        }
+    }
+}
+
+// One sequence the walk is in, from the step down to the loop body it is in now
+typedef struct {
+    AgitationSequenceView sequence{(const AgitationMovementStatic*)nullptr, 0};
+    size_t index; // Movement visited next
+    size_t loaded_length; // Movements the loader keeps so far
+    uint32_t duration; // Ticks so far, AGITATION_DURATION_INFINITE once one never ends
+    bool unreachable; // Reported already
+} ValidationFrame;
+
+typedef struct {
+    uint16_t step;
+    AgitationValidation* validation;
+    AgitationLoadCost cost;
+    bool error;
+    ValidationFrame frames[AGITATION_ISSUE_PATH_MAX];
+    size_t depth;
+} ValidationWalk;
+
+// Counts an issue about a whole step and keeps it if there is room;
+// nullptr if not kept
+static AgitationIssue*
+    validation_add(AgitationValidation* validation, AgitationIssueKind kind, uint16_t step) {
+    AgitationIssue* issue = nullptr;
+    if(validation->issues_length < AGITATION_VALIDATION_MAX_ISSUES) {
+        issue = &validation->issues[validation->issues_length];
+        issue->kind = kind;
+        issue->step = step;
+        issue->path_length = 0;
+    }
+    validation->issues_length++;
+    if(agitation_issue_is_error(kind)) {
+        validation->errors++;
+    }
+    return issue;
+}
+
+// Records an issue about the movement each frame is at, down to `path_length`
+static void validation_report(ValidationWalk* walk, AgitationIssueKind kind, size_t path_length) {
+    AgitationIssue* issue = validation_add(walk->validation, kind, walk->step);
+    if(issue) {
+        issue->path_length = (uint8_t)path_length;
+        for(size_t i = 0; i < path_length; i++) {
+            issue->path[i] = (uint8_t)walk->frames[i].index;
+        }
+    }
+    if(agitation_issue_is_error(kind)) {
+        walk->error = true;
+    }
+}
+
+// Checks the length of a sequence about to be walked; `path_length` locates
+// the step or loop it belongs to
+static void validation_check_length(
+    ValidationWalk* walk,
+    const AgitationSequenceView& sequence,
+    size_t path_length) {
+    if(sequence.isNull() || sequence.getLength() == 0) {
+        validation_report(walk, AgitationIssueEmptySequence, path_length);
+    } else if(sequence.getLength() > MovementLoader::MAX_SEQUENCE_LENGTH) {
+        validation_report(walk, AgitationIssueTruncated, path_length);
+    } else if(sequence.getLength() > MovementFactory::MAX_SEQUENCE_LENGTH) {
+        validation_report(walk, AgitationIssueLongSequence, path_length);
+    }
+}
+
+// Like SequenceAnalysis::loopDuration(), for a loop whose body takes `body`
+static uint32_t validation_loop_duration(
+    const AgitationSequenceView& sequence,
+    size_t i,
+    uint32_t body) {
+    uint32_t max_duration = agitation_duration_to_ticks(sequence.getLoopMaxDuration(i));
+    uint32_t count = sequence.getLoopCount(i);
+    uint32_t total = count > 0 ? duration_mul(body, count) : AGITATION_DURATION_INFINITE;
+    if(max_duration > 0 && max_duration < total) {
+        total = max_duration;
+    }
+    return total;
+}
+
+// True if a loop the innermost frame is in ends at its max_duration, so
+// nothing inside it runs forever
+static bool validation_is_cut_off(const ValidationWalk* walk) {
+    for(size_t level = 0; level < walk->depth; level++) {
+        const ValidationFrame* frame = &walk->frames[level];
+        if(frame->sequence.getLoopMaxDuration(frame->index) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Visits movement `frame->index` of the innermost frame. Returns true if it
+// is a loop whose body was entered, to be finished by validation_leave().
+static bool validation_visit(ValidationWalk* walk) {
+    ValidationFrame* frame = &walk->frames[walk->depth];
+    const AgitationSequenceView& sequence = frame->sequence;
+    size_t i = frame->index;
+
+    if(frame->duration == AGITATION_DURATION_INFINITE && !frame->unreachable) {
+        frame->unreachable = true;
+        validation_report(walk, AgitationIssueUnreachable, walk->depth + 1);
+    }
+
+    AgitationMovementType type = sequence.getType(i);
+    switch(type) {
+    case AgitationMovementTypeCW:
+    case AgitationMovementTypeCCW:
+    case AgitationMovementTypePause: {
+        uint32_t ticks = agitation_duration_to_ticks(sequence.getDuration(i));
+        frame->duration = duration_add(frame->duration, ticks > 0 ? ticks : 1);
+        walk->cost.movements++;
+        walk->cost.pool_bytes += type == AgitationMovementTypePause ?
+                                     MovementFactory::PAUSE_BYTES :
+                                     MovementFactory::MOTOR_BYTES;
+        frame->loaded_length++;
+        return false;
+    }
+
+    case AgitationMovementTypeWaitUser:
+        walk->cost.movements++;
+        walk->cost.pool_bytes += MovementFactory::WAIT_USER_BYTES;
+        frame->loaded_length++;
+        return false;
+
+    case AgitationMovementTypeLoop: {
+        if(sequence.getLoopCount(i) == 0 && sequence.getLoopMaxDuration(i) == 0 &&
+           !validation_is_cut_off(walk)) {
+            validation_report(walk, AgitationIssueInfiniteLoop, walk->depth + 1);
+        }
+        AgitationSequenceView body = sequence.getLoopBody(i);
+        validation_check_length(walk, body, walk->depth + 1);
+        if(body.isNull() || body.getLength() == 0) {
+            return false;
+        }
+        if(walk->depth + 1 >= AGITATION_ISSUE_PATH_MAX) {
+            validation_report(walk, AgitationIssueTooDeep, walk->depth + 1);
+            return false;
+        }
+
+        walk->depth++;
+        if(walk->depth > walk->cost.depth) {
+            walk->cost.depth = walk->depth;
+        }
+        ValidationFrame* inner = &walk->frames[walk->depth];
+        inner->sequence = body;
+        inner->index = 0;
+        inner->loaded_length = 0;
+        inner->duration = 0;
+        inner->unreachable = false;
+        return true;
+    }
+
+    default:
+        validation_report(walk, AgitationIssueUnknownType, walk->depth + 1);
+        return false;
+    }
+}
+
+// Finishes the loop whose body the innermost frame walked, as the loader
+// creates it: dropped if nothing in the body was loaded
+static void validation_leave(ValidationWalk* walk) {
+    const ValidationFrame* body = &walk->frames[walk->depth];
+    walk->depth--;
+    ValidationFrame* frame = &walk->frames[walk->depth];
+    if(body->loaded_length > 0) {
+        walk->cost.movements++;
+        walk->cost.pool_bytes += MovementFactory::loopBytes(body->loaded_length);
+        frame->loaded_length++;
+        frame->duration = duration_add(
+            frame->duration,
+            validation_loop_duration(frame->sequence, frame->index, body->duration));
+    }
+    frame->index++;
+}
+
+bool agitation_sequence_validate(
+    const AgitationSequenceView& sequence,
+    uint16_t step,
+    AgitationValidation* validation,
+    AgitationLoadCost* cost) {
+    ValidationWalk walk;
+    memset(&walk.cost, 0, sizeof(walk.cost));
+    walk.step = step;
+    walk.validation = validation;
+    walk.error = false;
+    walk.depth = 0;
+    walk.frames[0] = {sequence, 0, 0, 0, false};
+
+    validation_check_length(&walk, sequence, 0);
+    if(!sequence.isNull()) {
+        while(true) {
+            ValidationFrame* frame = &walk.frames[walk.depth];
+            size_t length = frame->sequence.getLength();
+            if(length > MovementLoader::MAX_SEQUENCE_LENGTH) {
+                length = MovementLoader::MAX_SEQUENCE_LENGTH;
+            }
+            if(frame->index < length) {
+                if(!validation_visit(&walk)) {
+                    frame->index++;
+                }
+            } else if(walk.depth > 0) {
+                validation_leave(&walk);
+            } else {
+                break;
+            }
+        }
+    }
+
+    walk.cost.stack_bytes =
+        walk.cost.depth * MovementLoader::MAX_SEQUENCE_LENGTH * sizeof(AgitationMovement*);
+    if(walk.cost.pool_bytes > MovementFactory::POOL_SIZE) {
+        validation_report(&walk, AgitationIssuePoolOverflow, 0);
+    }
+
+    AgitationLoadCost& worst = validation->worst;
+    if(walk.cost.pool_bytes > worst.pool_bytes) {
+        worst.pool_bytes = walk.cost.pool_bytes;
+    }
+    if(walk.cost.movements > worst.movements) {
+        worst.movements = walk.cost.movements;
+    }
+    if(walk.cost.depth > worst.depth) {
+        worst.depth = walk.cost.depth;
+    }
+    if(walk.cost.stack_bytes > worst.stack_bytes) {
+        worst.stack_bytes = walk.cost.stack_bytes;
+    }
+    if(cost) {
+        *cost = walk.cost;
+    }
+    return !walk.error;
+}
+
+bool agitation_process_validate(
+    const AgitationProcessStatic* process,
+    AgitationValidation* validation) {
+    agitation_validation_init(validation);
+    if(process->steps_length > AGITATION_PROCESS_MAX_STEPS) {
+        // Reported at the first step too many
+        validation_add(validation, AgitationIssueTooManySteps, AGITATION_PROCESS_MAX_STEPS);
+    }
+    for(size_t i = 0; i < process->steps_length; i++) {
+        agitation_sequence_validate(
+            AgitationSequenceView::of(process->steps[i]), (uint16_t)i, validation, nullptr);
+    }
+    return validation->errors == 0;
+}
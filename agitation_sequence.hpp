@@ -34,6 +34,49 @@ inline FuriString* furi_string_alloc_set(const char* str) {
 #include <furi_hal_gpio.h>
 #endif
 
+//------------------------------------------------------------------------------
+// Time base
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Length of one interpreter tick
+ * Movements count their elapsed time in ticks, so this is the resolution of
+ * every motor and pause transition.
+ */
+#define AGITATION_TICK_MS 100
+#define AGITATION_TICKS_PER_SECOND (1000 / AGITATION_TICK_MS)
+
+/**
+ * @brief Durations in the static tables are seconds unless marked with
+ * AGITATION_MS(), e.g. `.duration = AGITATION_MS(400)` for a 400 ms reversal.
+ * Applies to movement durations and loop max_duration alike.
+ */
+#define AGITATION_DURATION_MS_FLAG 0x80000000u
+#define AGITATION_MS(ms) (AGITATION_DURATION_MS_FLAG | (uint32_t)(ms))
+
+/**
+ * @brief Convert a static table duration to interpreter ticks
+ * Millisecond durations are rounded to the nearest tick, but never down to
+ * zero so a short movement is not dropped.
+ */
+constexpr uint32_t agitation_duration_to_ticks(uint32_t duration) {
+    if(!(duration & AGITATION_DURATION_MS_FLAG)) {
+        return duration * AGITATION_TICKS_PER_SECOND;
+    }
+    uint32_t ms = duration & ~AGITATION_DURATION_MS_FLAG;
+    uint32_t ticks = (ms + AGITATION_TICK_MS / 2) / AGITATION_TICK_MS;
+    return (ticks == 0 && ms > 0) ? 1 : ticks;
+}
+
+/**
+ * @brief Returned by duration queries for sequences that never end on their own
+ */
+#define AGITATION_DURATION_INFINITE UINT32_MAX
+
+constexpr uint32_t agitation_ticks_to_ms(uint32_t ticks) {
+    return ticks * AGITATION_TICK_MS;
+}
+
 /**
  * @brief Movement types for agitation sequence
  */
@@ -51,10 +94,12 @@ typedef enum {
 
 typedef struct AgitationMovementStatic AgitationMovementStatic;
 typedef struct AgitationStepStatic AgitationStepStatic;
+typedef struct AgitationCompiledMovement AgitationCompiledMovement;
 
 /**
  * @brief Static version of movement
  * For loops, duration is ignored. For other types, count and sequence are ignored.
+ * Durations are in seconds, or milliseconds when wrapped in AGITATION_MS().
  */
 struct AgitationMovementStatic {
     AgitationMovementType type;
@@ -75,6 +120,8 @@ struct AgitationMovementStatic {
 
 /**
  * @brief Static version of step
+ * The movements are either `sequence` or, for a step of a compiled process
+ * image, `compiled_sequence`; sequence_length counts whichever is set.
  */
 struct AgitationStepStatic {
     const char* name;
@@ -82,6 +129,7 @@ struct AgitationStepStatic {
     float temperature;
     const AgitationMovementStatic* sequence;
     size_t sequence_length;
+    const AgitationCompiledMovement* compiled_sequence = nullptr;
 };
 
 /**
@@ -97,6 +145,98 @@ typedef struct {
     size_t steps_length;
 } AgitationProcessStatic;
 
+/**
+ * @brief Steps a process may have. The interpreter keeps a time estimate for
+ * each and does not start a process with more.
+ */
+#define AGITATION_PROCESS_MAX_STEPS 16
+
+/**
+ * @brief Movement of a compiled process image, used where it lies
+ * Offsets are relative to the movement itself, so an image needs no fixup
+ * wherever it is loaded: a loop body is a run of sequence_length movements
+ * `sequence` entries further on, and a wait_user message is the string
+ * `value` bytes from the start of the movement.
+ */
+struct AgitationCompiledMovement {
+    uint8_t type; // AgitationMovementType
+    uint8_t reserved;
+    uint16_t sequence_length; // Loops: movements in the body
+    uint32_t sequence; // Loops: first body movement, counted from this one
+    uint32_t value; // Duration, loop count, or message offset (0 = no message)
+    uint32_t max_duration; // Loops
+};
+
+/**
+ * @brief The movements of a step, from static tables or a compiled image
+ * Lets the loader and the analysis walk either without caring which one a
+ * process came from.
+ */
+class AgitationSequenceView {
+public:
+    constexpr AgitationSequenceView(const AgitationMovementStatic* movements, size_t length)
+        : movements(movements)
+        , compiled(nullptr)
+        , length(length) {
+    }
+    constexpr AgitationSequenceView(const AgitationCompiledMovement* compiled, size_t length)
+        : movements(nullptr)
+        , compiled(compiled)
+        , length(length) {
+    }
+
+    static constexpr AgitationSequenceView of(const AgitationStepStatic& step) {
+        return step.compiled_sequence ?
+                   AgitationSequenceView(step.compiled_sequence, step.sequence_length) :
+                   AgitationSequenceView(step.sequence, step.sequence_length);
+    }
+
+    // True for a step or loop without movements to point to
+    constexpr bool isNull() const {
+        return !movements && !compiled;
+    }
+    constexpr size_t getLength() const {
+        return length;
+    }
+    constexpr AgitationMovementType getType(size_t i) const {
+        return compiled ? (AgitationMovementType)compiled[i].type : movements[i].type;
+    }
+    // CW, CCW and pause
+    constexpr uint32_t getDuration(size_t i) const {
+        return compiled ? compiled[i].value : movements[i].duration;
+    }
+    // Loops
+    constexpr uint32_t getLoopCount(size_t i) const {
+        return compiled ? compiled[i].value : movements[i].loop.count;
+    }
+    constexpr uint32_t getLoopMaxDuration(size_t i) const {
+        return compiled ? compiled[i].max_duration : movements[i].loop.max_duration;
+    }
+    // The first `length` movements
+    constexpr AgitationSequenceView prefix(size_t length) const {
+        return compiled ? AgitationSequenceView(compiled, length) :
+                          AgitationSequenceView(movements, length);
+    }
+    constexpr AgitationSequenceView getLoopBody(size_t i) const {
+        return compiled ? AgitationSequenceView(
+                              &compiled[i] + compiled[i].sequence, compiled[i].sequence_length) :
+                          AgitationSequenceView(
+                              movements[i].loop.sequence, movements[i].loop.sequence_length);
+    }
+    // Wait user, NULL without a message
+    const char* getMessage(size_t i) const {
+        if(!compiled) {
+            return movements[i].message;
+        }
+        return compiled[i].value ? (const char*)&compiled[i] + compiled[i].value : nullptr;
+    }
+
+private:
+    const AgitationMovementStatic* movements;
+    const AgitationCompiledMovement* compiled;
+    size_t length;
+};
+
 //------------------------------------------------------------------------------
 // Dynamic versions of structures (with FuriString)
 //------------------------------------------------------------------------------
@@ -113,7 +253,8 @@ struct AgitationMovement_ {
         uint32_t duration;
         // For loops
         struct {
-            uint32_t count;
+            uint32_t count; // 0 = use max_duration or infinite
+            uint32_t max_duration; // 0 = use count or infinite
             struct AgitationMovement_* sequence;
             size_t sequence_length;
         } loop;
@@ -132,7 +273,11 @@ struct AgitationMovement_ {
             DEBUG_PRINT("Pause, duration: %u", duration);
             break;
         case AgitationMovementTypeLoop:
-            DEBUG_PRINT("Loop, count: %u, sequence length: %zu", loop.count, loop.sequence_length);
+            DEBUG_PRINT(
+                "Loop, count: %u, max duration: %u, sequence length: %zu",
+                loop.count,
+                loop.max_duration,
+                loop.sequence_length);
             break;
         case AgitationMovementTypeWaitUser:
             DEBUG_PRINT("Wait for user");
@@ -260,7 +405,322 @@ void agitation_sequence_add_movement(
     AgitationMovementType type,
     uint32_t duration);
 
+/**
+ * @brief Time a sequence takes to run
+ * Matches the interpreter: every movement takes at least one tick, loops run
+ * count iterations cut off at max_duration. A wait for the user in the
+ * sequence itself counts nothing, as the step clock stops there; inside a
+ * loop it keeps the loop from ending on its own, as with a loop without
+ * count, so only max_duration bounds it.
+ * @return Duration in ticks of AGITATION_TICK_MS, or
+ * AGITATION_DURATION_INFINITE if a loop never ends on its own
+ */
 uint32_t agitation_sequence_get_duration(AgitationMovement_* sequence, size_t length);
-bool agitation_sequence_validate(AgitationMovement_* sequence, size_t length);
-AgitationProcess* agitation_process_from_yaml(const char* yaml_content);
-FuriString* agitation_process_to_yaml(AgitationProcess* process);
+
+//------------------------------------------------------------------------------
+// Validation
+//------------------------------------------------------------------------------
+
+/**
+ * @brief What can be wrong with a sequence, in the order it is checked
+ */
+typedef enum {
+    // Errors: the process does not run the way it is written
+    AgitationIssueTooManySteps, // More than AGITATION_PROCESS_MAX_STEPS, the process does not start
+    AgitationIssueUnknownType, // The loader skips the movement
+    AgitationIssueEmptySequence, // A step or loop without movements
+    AgitationIssueUnreachable, // Follows a movement that never ends
+    AgitationIssueTruncated, // Movements past MovementLoader::MAX_SEQUENCE_LENGTH are not loaded
+    AgitationIssueTooDeep, // Loops nested past MovementLoader::MAX_NESTING_DEPTH
+    AgitationIssuePoolOverflow, // The step does not fit the movement pool
+    // Warnings: runs, but may not be what was meant
+    AgitationIssueInfiniteLoop, // Neither count nor max_duration, ends only when the step is skipped
+    AgitationIssueLongSequence, // Longer than the built-in tables may be, MovementFactory::MAX_SEQUENCE_LENGTH
+} AgitationIssueKind;
+
+// Levels of a path to a movement: one per loop it is in, and its own index
+#define AGITATION_ISSUE_PATH_MAX 5
+
+/**
+ * @brief A problem found, and the movement it is about
+ * The path is the index of the movement in its step's sequence, then its
+ * index in that loop's body, and so on. It is empty for issues about the
+ * whole step.
+ */
+typedef struct {
+    AgitationIssueKind kind;
+    uint16_t step;
+    uint8_t path_length;
+    uint8_t path[AGITATION_ISSUE_PATH_MAX];
+} AgitationIssue;
+
+// Issues kept by a validation; more are counted but not kept
+#define AGITATION_VALIDATION_MAX_ISSUES 8
+
+/**
+ * @brief What loading one step takes, as MovementLoader builds it one to
+ * one; its peephole pass only takes less
+ */
+typedef struct {
+    size_t pool_bytes; // Movement pool bytes
+    size_t movements; // Movement objects
+    size_t depth; // Loop nesting, levels the loader recurses
+    size_t stack_bytes; // Pointer arrays the loader keeps on the stack meanwhile
+} AgitationLoadCost;
+
+typedef struct {
+    AgitationIssue issues[AGITATION_VALIDATION_MAX_ISSUES];
+    size_t issues_length; // Issues found, the first of them kept
+    size_t errors; // Issues found that are errors
+    AgitationLoadCost worst; // Most of any step validated, field by field
+} AgitationValidation;
+
+void agitation_validation_init(AgitationValidation* validation);
+
+bool agitation_issue_is_error(AgitationIssueKind kind);
+
+/**
+ * @brief Describe `issue` as a line like "step 2, 0.3: loop never ends"
+ */
+void agitation_issue_format(const AgitationIssue* issue, char* buffer, size_t size);
+
+/**
+ * @brief Check one step's movements against the loader and the pool, and
+ * work out what loading them takes
+ * Walks the sequence once with a fixed-size stack of its own, so it is safe
+ * on sequences nested deeper than the loader allows.
+ * @param step Index recorded in the issues found
+ * @param validation Receives the issues and the worst cost so far
+ * @param cost Receives the cost of this step, may be NULL
+ * @return True if no error was found
+ */
+bool agitation_sequence_validate(
+    const AgitationSequenceView& sequence,
+    uint16_t step,
+    AgitationValidation* validation,
+    AgitationLoadCost* cost);
+
+/**
+ * @brief Validate every step of a process, from static tables, YAML or an
+ * image alike
+ * @param validation Reset first
+ * @return True if no error was found
+ */
+bool agitation_process_validate(
+    const AgitationProcessStatic* process,
+    AgitationValidation* validation);
+
+//------------------------------------------------------------------------------
+// Loading processes from YAML
+//------------------------------------------------------------------------------
+
+/**
+ * @brief One block of memory a loaded process lives in
+ * The loader takes everything it builds, and its own working state while it
+ * runs, out of this block and allocates nothing else. Loaded data is packed
+ * from the start; working state is stacked from the end and released when
+ * loading finishes.
+ */
+typedef struct {
+    uint8_t* memory;
+    size_t size;
+    size_t used; // Bytes the loaded process takes
+    size_t peak; // Most bytes in use at once while loading
+} AgitationArena;
+
+void agitation_arena_init(AgitationArena* arena, void* memory, size_t size);
+
+/**
+ * @brief Reads the next chunk of a YAML file
+ * @return Bytes read into `buffer`, at most `size`; 0 at the end of the file
+ */
+typedef size_t (*AgitationYamlRead)(void* buffer, size_t size, void* context);
+
+/**
+ * @brief Why a YAML file did not load
+ */
+typedef struct {
+    uint32_t line; // 1-based, 0 if not tied to a line
+    const char* message;
+} AgitationYamlError;
+
+// Longest line the loader accepts, and the most it reads at once
+#define AGITATION_YAML_LINE_MAX 128
+
+// Limits matching MovementLoader, so whatever loads also runs
+#define AGITATION_YAML_MAX_LOOP_DEPTH 4
+#define AGITATION_YAML_MAX_SEQUENCE_LENGTH 32
+
+/**
+ * @brief Load a process from YAML, reading it in chunks
+ *
+ * The file is a subset of YAML: block mappings and sequences indented with
+ * spaces, plain or quoted scalars, and comments.
+ *
+ *     process_name: Black and White Standard Development
+ *     film_type: Black and White Negative
+ *     tank_type: Paterson
+ *     chemistry: D-76
+ *     temperature: 20.0
+ *     steps:
+ *       - name: Initial Agitation
+ *         description: First round of agitation
+ *         temperature: 20.0
+ *         sequence:
+ *           - loop: 4          # count, 0 or empty to run until max_duration
+ *             max_duration: 0  # optional
+ *             sequence:
+ *               - cw: 1
+ *               - pause: 400ms
+ *               - ccw: 1
+ *           - pause: 24
+ *           - wait_user: "Ready for the stop bath?"
+ *
+ * A movement starts with its type: cw, ccw or pause with a duration, loop
+ * with a count, or wait_user with an optional message. Durations are seconds,
+ * optionally suffixed with s, or milliseconds suffixed with ms. process_name,
+ * steps, and the name and sequence of every step are required; a step
+ * without a temperature takes the process temperature.
+ *
+ * @param read Reads the file
+ * @param arena Receives the process; reset first
+ * @param error Filled in when loading fails, may be NULL
+ * @return The process, living in `arena`, or NULL on error
+ */
+const AgitationProcessStatic* agitation_process_from_yaml(
+    AgitationYamlRead read,
+    void* context,
+    AgitationArena* arena,
+    AgitationYamlError* error);
+
+/**
+ * @brief Receives serialized YAML in pieces
+ * @return False to stop writing
+ */
+typedef bool (*AgitationYamlWrite)(const void* data, size_t size, void* context);
+
+/**
+ * @brief Write a process as YAML that agitation_process_from_yaml() loads
+ * back to the same process
+ * Output goes through a small fixed buffer, so memory use does not depend on
+ * the size of the process. Strings are quoted where a plain scalar would
+ * read back differently; missing strings are left out.
+ * @return False if `write` failed, or the process breaks a loader limit or
+ * has a line longer than AGITATION_YAML_LINE_MAX, in which case the output
+ * is incomplete
+ */
+bool agitation_process_to_yaml(
+    const AgitationProcessStatic* process,
+    AgitationYamlWrite write,
+    void* context);
+
+//------------------------------------------------------------------------------
+// Compiled process images
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Processes compiled to a binary image, to be used where they lie
+ *
+ * An image is one block of little-endian tables, each 4-byte aligned:
+ *
+ *     AgitationImageHeader
+ *     AgitationImageProcess[processes_length]
+ *     AgitationImageStep[steps_length]
+ *     AgitationCompiledMovement[movements_length]
+ *     strings, each NUL-terminated
+ *
+ * Process and step strings are offsets into the string table. Every sequence
+ * is a run of movements in the movement table, loop bodies included, which
+ * sit after the sequence they belong to. Nothing in it points anywhere, so
+ * a file read into memory as a whole can be run straight away.
+ */
+#define AGITATION_IMAGE_MAGIC 0x49504741u // "AGPI"
+#define AGITATION_IMAGE_VERSION 1
+
+/**
+ * @brief Steps a process of an image may have, as many as the interpreter
+ * times
+ */
+#define AGITATION_IMAGE_MAX_STEPS AGITATION_PROCESS_MAX_STEPS
+
+typedef struct {
+    uint32_t magic; // AGITATION_IMAGE_MAGIC
+    uint16_t version; // AGITATION_IMAGE_VERSION
+    uint16_t header_size; // Later versions may add fields at the end
+    uint32_t size; // Whole image, in bytes
+    uint32_t processes_length;
+    uint32_t processes_offset;
+    uint32_t steps_length;
+    uint32_t steps_offset;
+    uint32_t movements_length;
+    uint32_t movements_offset;
+    uint32_t strings_size;
+    uint32_t strings_offset;
+} AgitationImageHeader;
+
+typedef struct {
+    uint32_t process_name; // Strings are offsets into the string table
+    uint32_t film_type;
+    uint32_t tank_type;
+    uint32_t chemistry;
+    float temperature;
+    uint32_t steps; // First step in the step table
+    uint32_t steps_length;
+} AgitationImageProcess;
+
+typedef struct {
+    uint32_t name;
+    uint32_t description;
+    float temperature;
+    uint32_t sequence; // First movement in the movement table
+    uint32_t sequence_length;
+} AgitationImageStep;
+
+/**
+ * @brief A process of an image in the form the interpreter takes
+ * Strings and movements point into the image, which has to stay in memory
+ * as long as the process is used.
+ */
+typedef struct {
+    AgitationProcessStatic process;
+    AgitationStepStatic steps[AGITATION_IMAGE_MAX_STEPS];
+} AgitationImageProcessView;
+
+/**
+ * @brief Check that an image is well formed before using it
+ * Verifies the header and that every offset stays inside the image, every
+ * string is terminated, and every sequence keeps to the YAML loader limits,
+ * so nothing read from storage can send the interpreter astray. Takes time
+ * linear in the size of the image.
+ * @param image The image, 4-byte aligned
+ * @param error Set to the reason when the image is rejected, may be NULL
+ */
+bool agitation_image_check(const void* image, size_t size, const char** error);
+
+/**
+ * @brief Number of processes in a checked image
+ */
+size_t agitation_image_processes_length(const void* image);
+
+/**
+ * @brief Set up `view` to run process `index` of a checked image
+ * Only fills in the process and its steps; the movements are read in place.
+ * @return False if there is no such process
+ */
+bool agitation_image_get_process(
+    const void* image,
+    size_t index,
+    AgitationImageProcessView* view);
+
+/**
+ * @brief Compile processes into one image, written through `write` in order
+ * Strings missing in a process are stored as empty ones, except for
+ * wait_user messages.
+ * @return False if `write` failed or a process breaks the YAML loader
+ * limits or has more than AGITATION_IMAGE_MAX_STEPS steps
+ */
+bool agitation_image_compile(
+    const AgitationProcessStatic* const* processes,
+    size_t processes_length,
+    AgitationYamlWrite write,
+    void* context);
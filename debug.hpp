@@ -1,16 +1,32 @@
 #pragma once
+#include "trace.hpp"
 #include <cstdio>
 
 #ifdef NDEBUG
 #define DEBUG_PRINT(fmt, ...) ((void)0)
 #define DEBUG_PRINTN(fmt, ...) ((void)0)
-#define TRACE_PRINT(fmt, ...) ((void)0)
-#define TRACE_PRINTN(fmt, ...) ((void)0)
 #else
 #define DEBUG_PRINT(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
 #define DEBUG_PRINTN(fmt, ...) printf(fmt, ##__VA_ARGS__)
-#define TRACE_PRINT(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
-#define TRACE_PRINTN(fmt, ...) printf(fmt, ##__VA_ARGS__)
-// #define TRACE_PRINT(fmt, ...) ((void)0)
-// #define TRACE_PRINTN(fmt, ...) ((void)0)
+#endif
+
+// Records an event in the binary trace, e.g.
+// TRACE_EVENT(StepStart, step, movements, bytes). Up to three integer
+// arguments, the first one truncated to 16 bits. Stays on in release builds;
+// build with FILM_DEVELOPER_TRACE=0 to compile it out.
+#ifndef FILM_DEVELOPER_TRACE
+#define FILM_DEVELOPER_TRACE 1
+#endif
+
+#if FILM_DEVELOPER_TRACE
+#define TRACE_EVENT(event, ...)                                                \
+  trace_buffer.record(TraceEvent::event, ##__VA_ARGS__)
+#else
+// Still type-checks the arguments, and keeps them from being unused
+#define TRACE_EVENT(event, ...)                                                \
+  do {                                                                         \
+    if (false) {                                                               \
+      trace_buffer.record(TraceEvent::event, ##__VA_ARGS__);                   \
+    }                                                                          \
+  } while (0)
 #endif
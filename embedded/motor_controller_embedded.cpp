@@ -5,52 +5,67 @@ MotorControllerEmbedded::MotorControllerEmbedded() {}
 
 MotorControllerEmbedded::~MotorControllerEmbedded() {}
 
-void MotorControllerEmbedded::clockwise(bool enable) {
-  if (enable) {
+// Only called on a change of direction. Dead time is needed only when the
+// other pin may still be driven or was released less than the dead time ago:
+// on a reversal, from an unknown state, or right after a stop that ended the
+// opposite direction.
+void MotorControllerEmbedded::drive(Direction from, Direction to) {
+  if (from != Direction::Stop) {
+    // Leaving a direction releases its pin now, leaving an unknown state
+    // both of them
+    released = from;
+    released_at = furi_get_tick();
+  }
+
+  switch (to) {
+  case Direction::CW:
     furi_hal_gpio_write(pin_ccw, true); // Ensure CCW is off
-    furi_delay_us(SAFETY_DELAY_US);
+    awaitDeadTime(from, to);
     furi_hal_gpio_write(pin_cw, false); // Active low
-    cw_active = true;
-    ccw_active = false;
-  } else {
+    break;
+  case Direction::CCW:
+    furi_hal_gpio_write(pin_cw, true); // Ensure CW is off
+    awaitDeadTime(from, to);
+    furi_hal_gpio_write(pin_ccw, false); // Active low
+    break;
+  case Direction::Stop:
+  case Direction::Unknown:
     furi_hal_gpio_write(pin_cw, true);
-    cw_active = false;
+    furi_hal_gpio_write(pin_ccw, true);
+    break;
   }
 }
 
-void MotorControllerEmbedded::counterClockwise(bool enable) {
-  if (enable) {
-    furi_hal_gpio_write(pin_cw, true); // Ensure CW is off
+void MotorControllerEmbedded::awaitDeadTime(Direction from, Direction to) {
+  bool settled = from == Direction::Stop &&
+                 (released == to ||
+                  furi_get_tick() - released_at > SAFETY_DELAY_TICKS);
+  if (!settled) {
     furi_delay_us(SAFETY_DELAY_US);
-    furi_hal_gpio_write(pin_ccw, false); // Active low
-    ccw_active = true;
-    cw_active = false;
-  } else {
-    furi_hal_gpio_write(pin_ccw, true);
-    ccw_active = false;
   }
 }
 
-void MotorControllerEmbedded::stop() {
-  furi_hal_gpio_write(pin_cw, true);
-  furi_hal_gpio_write(pin_ccw, true);
-  cw_active = false;
-  ccw_active = false;
-}
+void MotorControllerEmbedded::initGpio(size_t channel) {
+  // CW and CCW pins of each channel, on the external header
+  static const GpioPin *const pins[CHANNELS][2] = {
+      {&gpio_ext_pa7, &gpio_ext_pa6},
+      {&gpio_ext_pb3, &gpio_ext_pb2},
+      {&gpio_ext_pc3, &gpio_ext_pc1},
+  };
+  furi_check(channel < CHANNELS);
 
-void MotorControllerEmbedded::initGpio() {
   // Initialize GPIO pins
-  pin_cw = &gpio_ext_pa7;
-  pin_ccw = &gpio_ext_pa6;
+  pin_cw = pins[channel][0];
+  pin_ccw = pins[channel][1];
 
   furi_hal_gpio_init(pin_cw, GpioModeOutputPushPull, GpioPullNo,
                      GpioSpeedVeryHigh);
   furi_hal_gpio_init(pin_ccw, GpioModeOutputPushPull, GpioPullNo,
                      GpioSpeedVeryHigh);
 
-  // Set both pins high (motor off) initially
-  furi_hal_gpio_write(pin_cw, true);
-  furi_hal_gpio_write(pin_ccw, true);
+  // Set both pins high (motor off) initially, whatever was commanded before
+  invalidateDirection();
+  stop();
 }
 
 void MotorControllerEmbedded::deinitGpio() {
@@ -58,12 +73,5 @@ void MotorControllerEmbedded::deinitGpio() {
   // Reset GPIO pins to default state
   furi_hal_gpio_init(pin_cw, GpioModeAnalog, GpioPullNo, GpioSpeedLow);
   furi_hal_gpio_init(pin_ccw, GpioModeAnalog, GpioPullNo, GpioSpeedLow);
+  invalidateDirection();
 }
-
-const char *MotorControllerEmbedded::getDirectionString() const {
-  if (cw_active)
-    return "CW";
-  if (ccw_active)
-    return "CCW";
-  return "Idle";
-}
\ No newline at end of file
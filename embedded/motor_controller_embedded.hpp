@@ -8,23 +8,31 @@ public:
   MotorControllerEmbedded();
   ~MotorControllerEmbedded();
 
-  void clockwise(bool enable) override;
-  void counterClockwise(bool enable) override;
-  void stop() override;
-  bool isRunning() const override { return cw_active || ccw_active; }
-  bool isClockwise() const override { return cw_active; }
-  bool isCounterClockwise() const override { return ccw_active; }
-  bool isStopped() const override { return !isRunning(); }
-  const char *getDirectionString() const override;
-
-  void initGpio();
+  // Motors that can be driven, each from its own pair of GPIO pins
+  static constexpr size_t CHANNELS = 3;
+
+  // Drives the motor on the pins of `channel`, below CHANNELS
+  void initGpio(size_t channel = 0);
   void deinitGpio();
 
+protected:
+  void drive(Direction from, Direction to) override;
+
 private:
   static constexpr uint32_t SAFETY_DELAY_US = 1000; // 1ms safety delay
+  // furi_get_tick() counts whole ms, so a pin released more than this many
+  // ticks ago has been off for at least SAFETY_DELAY_US
+  static constexpr uint32_t SAFETY_DELAY_TICKS = (SAFETY_DELAY_US + 999) / 1000;
+
+  // Waits out the dead time before `to` is driven, unless the other pin has
+  // been off long enough already
+  void awaitDeadTime(Direction from, Direction to);
 
   const GpioPin *pin_cw;
   const GpioPin *pin_ccw;
-  bool cw_active{false};
-  bool ccw_active{false};
+
+  // Direction whose pin was released last, Unknown for both at once, and
+  // when
+  Direction released{Direction::Unknown};
+  uint32_t released_at{0};
 };
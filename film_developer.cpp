@@ -1,12 +1,21 @@
 #include "agitation_process_interpreter.hpp"
 #include "agitation_processes.hpp"
 #include "agitation_sequence.hpp"
+#include "motor_command_queue.hpp"
 #include "motor_controller.hpp"
+#include "process_journal.hpp"
+#include "recipe_catalog.hpp"
+#include "status_model.hpp"
+#include "timing_stats.hpp"
+#include "trace.hpp"
 #include <furi.h>
+#include <furi_hal.h>
 #include <furi_hal_gpio.h>
 #include <gui/elements.h>
 #include <gui/gui.h>
 #include <gui/view_port.h>
+#include <new>
+#include <storage/storage.h>
 
 #ifdef HOST
 #include "test-film_developer/mock_controller.hpp"
@@ -14,69 +23,318 @@
 #include "embedded/motor_controller_embedded.hpp"
 #endif
 
+// Longest the timer sleeps between wakeups, so the elapsed time on screen
+// keeps moving during long pauses
+#define MAX_TIMER_SLEEP_TICKS (10 * AGITATION_TICKS_PER_SECOND)
+
+// How early the event loop runs the ticks of an event. Their motor commands
+// are queued with the time they are due, so event loop latency up to this
+// much does not shift the motor.
+#define MOTOR_COMMAND_LEAD_MS (AGITATION_TICK_MS / 2)
+
+// Where a long press on Down saves the trace, for sim/trace_decode, and the
+// timing stats
+#define TRACE_DUMP_PATH APP_DATA_PATH("trace.bin")
+#define TIMING_DUMP_PATH APP_DATA_PATH("timing.txt")
+
+// A process saved here runs instead of the built-in C41 process. It is
+// loaded into one block of PROCESS_ARENA_SIZE bytes; the built-in recipes
+// need 1-2 KB, working space included.
+#define PROCESS_YAML_PATH APP_DATA_PATH("process.yaml")
+#define PROCESS_ARENA_SIZE (4 * 1024)
+
+// Processes compiled with sim/process_compile. The first one runs, before a
+// process in PROCESS_YAML_PATH: the file is read in one go and used where it
+// lies, without parsing.
+#define PROCESS_IMAGE_PATH APP_DATA_PATH("processes.bin")
+#define PROCESS_IMAGE_MAX_SIZE (32 * 1024)
+
+// Where a long press on Left writes the current process, to edit on a
+// computer and save back as PROCESS_YAML_PATH
+#define PROCESS_EXPORT_PATH APP_DATA_PATH("export.yaml")
+
+// A recipe catalog written by sim/process_compile --catalog. When there is
+// one, the app opens on a menu of its recipes instead of running one of the
+// above; the menu reads only the index entries it shows.
+#define RECIPES_PATH APP_DATA_PATH("recipes.bin")
+#define RECIPES_INDEX_PATH APP_DATA_PATH("recipes.idx")
+#define MENU_ROWS 3
+
+// Checkpoints of the running process, see process_journal.hpp. If the app
+// did not get to finish a run, it offers to continue it on the next start.
+// One journal per tank, numbered from 0, in files that take turns
+#define JOURNAL_PATH_FORMAT APP_DATA_PATH("journal%u_%u.bin")
+
+// Tanks driven side by side, each with its own process and its motor on its
+// own GPIO pair, see MotorControllerEmbedded::initGpio(). A long press on
+// Right shows the next one; input applies to the tank shown.
+#ifndef TANK_CHANNELS
+#define TANK_CHANNELS 2
+#endif
+
+// Tanks whose ticks fall due within this much after those the state timer
+// woke up for are run in the same pass. Their motor commands keep their
+// times, so this only saves wakeups.
+#define SCHEDULE_BATCH_MS MOTOR_COMMAND_LEAD_MS
+
+// One tank: its process, an interpreter with movement pools of its own, and
+// its motor
 typedef struct {
-  FuriEventLoop *event_loop;
-  ViewPort *view_port;
-  Gui *gui;
-  FuriEventLoopTimer *state_timer;
+  size_t index;
 
-  // Add motor controller
+  // The interpreter drives motor_controller, which queues its commands.
+  // motor_timer applies them to motor_output when they are due.
   MotorController *motor_controller;
+  MotorCommandQueue motor_queue;
+  MotorController *motor_output;
+  FuriTimer *motor_timer;
 
   // Process state
   AgitationProcessInterpreter process_interpreter;
   const AgitationProcessStatic *current_process;
   bool process_active;
+  bool paused;
 
-  // Display info
-  char status_text[64];
-  char step_text[32];
-  char movement_text[32];
+  // While `scheduled`, when the next ticks of the tank fall due. The
+  // interpreter keeps the clock anchor, so no time is lost however late the
+  // state timer is.
+  uint32_t next_event_at;
+  bool scheduled;
 
-  // Additional state tracking
-  bool paused;
+  // Holds current_process when it was chosen from the recipe catalog
+  void *recipe_image;
+  AgitationImageProcessView recipe_process;
+  // Catalog entry of current_process, PROCESS_JOURNAL_NO_RECIPE if none
+  uint16_t current_recipe;
+
+  // Checkpoints of the run, and the one to resume at while resume_offered
+  ProcessJournal journal;
+  JournalRecord resume_record;
+  bool resume_offered;
+
+  // What the main screen shows for the tank, rebuilt only when its inputs
+  // change
+  StatusModel status;
+
+  // Scheduling measurements of the current run, shown instead of the
+  // process while debug_screen is set (long press Up)
+  TimingStats timing;
+} TankChannel;
+
+typedef struct {
+  FuriEventLoop *event_loop;
+  ViewPort *view_port;
+  Gui *gui;
+  FuriMessageQueue *input_queue;
+  // One timer for all tanks, armed for the one due first
+  FuriEventLoopTimer *state_timer;
+  // When the state timer is armed to fire
+  uint32_t wakeup_at;
+
+  TankChannel channels[TANK_CHANNELS];
+  // The tank on screen
+  size_t selected;
+
+  // Holds the process tanks start with when it was loaded from
+  // PROCESS_YAML_PATH
+  AgitationArena process_arena;
+
+  // Holds it when it came from PROCESS_IMAGE_PATH
+  void *process_image;
+  AgitationImageProcessView image_process;
+
+  // Open while the app runs from a recipe catalog; a tank's current_process
+  // is the recipe last chosen for it, and the menu is shown whenever the
+  // tank on screen runs no process
+  Storage *storage;
+  File *recipes_file;
+  File *index_file;
+  RecipeCatalog catalog;
+  size_t menu_selection;
+  size_t menu_top;
+
+  bool debug_screen;
 } FilmDeveloperApp;
 
+// Title of a screen about `channel`, with the tank number when there are
+// several
+static void format_title(char *title, size_t size, const TankChannel *channel,
+                         const char *text) {
+  if (TANK_CHANNELS > 1) {
+    snprintf(title, size, "%u: %s", (unsigned)(channel->index + 1), text);
+  } else {
+    snprintf(title, size, "%s", text);
+  }
+}
+
+static void draw_debug_screen(Canvas *canvas, const TankChannel *channel) {
+  const TimingStats &timing = channel->timing;
+  char line[40];
+
+  canvas_set_font(canvas, FontPrimary);
+  format_title(line, sizeof(line), channel, "Timing p50/p99/max");
+  canvas_draw_str(canvas, 2, 10, line);
+  canvas_set_font(canvas, FontSecondary);
+
+  snprintf(line, sizeof(line), "Timer ms: %lu/%lu/%lu",
+           timing.timer_late_ms.percentile(50),
+           timing.timer_late_ms.percentile(99), timing.timer_late_ms.getMax());
+  canvas_draw_str(canvas, 2, 21, line);
+  snprintf(line, sizeof(line), "Tick us: %lu/%lu/%lu",
+           timing.tick_us.percentile(50), timing.tick_us.percentile(99),
+           timing.tick_us.getMax());
+  canvas_draw_str(canvas, 2, 31, line);
+  snprintf(line, sizeof(line), "Motor ms: %lu/%lu/%lu",
+           timing.motor_late_ms.percentile(50),
+           timing.motor_late_ms.percentile(99), timing.motor_late_ms.getMax());
+  canvas_draw_str(canvas, 2, 41, line);
+
+  size_t step = timing.steps.getCurrent();
+  if (step < StepTimings::MAX_STEPS) {
+    const StepTimings::Entry &entry = timing.steps.getEntry(step);
+    if (entry.planned_ms == StepTimings::UNBOUNDED) {
+      snprintf(line, sizeof(line), "Step %u: %lus", (unsigned)step,
+               entry.actual_ms / 1000);
+    } else {
+      snprintf(line, sizeof(line), "Step %u: %lus of %lus", (unsigned)step,
+               entry.actual_ms / 1000, entry.planned_ms / 1000);
+    }
+    canvas_draw_str(canvas, 2, 51, line);
+  }
+  snprintf(line, sizeof(line), "Drift: %+ld ms", timing.steps.getTotalDrift());
+  canvas_draw_str(canvas, 2, 61, line);
+}
+
+// The recipe catalog, MENU_ROWS entries around the selection
+static void draw_menu(Canvas *canvas, FilmDeveloperApp *app) {
+  const RecipeCatalog &catalog = app->catalog;
+  char line[40];
+
+  canvas_set_font(canvas, FontPrimary);
+  format_title(line, sizeof(line), &app->channels[app->selected], "Recipes");
+  canvas_draw_str(canvas, 2, 10, line);
+  snprintf(line, sizeof(line), "%u/%u", (unsigned)(app->menu_selection + 1),
+           (unsigned)catalog.getLength());
+  canvas_draw_str_aligned(canvas, 126, 10, AlignRight, AlignBottom, line);
+  canvas_set_font(canvas, FontSecondary);
+
+  for (size_t row = 0; row < MENU_ROWS; row++) {
+    size_t index = app->menu_top + row;
+    const RecipeIndexEntry *entry = catalog.getEntry(index);
+    if (!entry) {
+      break;
+    }
+    int32_t y = 21 + (int32_t)row * 10;
+    bool selected = index == app->menu_selection;
+    if (selected) {
+      canvas_draw_box(canvas, 0, y - 9, 128, 10);
+      canvas_set_color(canvas, ColorWhite);
+    }
+    canvas_draw_str(canvas, 2, y, entry->name);
+    if (entry->duration_s == UINT32_MAX) {
+      snprintf(line, sizeof(line), "--:--");
+    } else {
+      snprintf(line, sizeof(line), "%lu:%02lu",
+               (unsigned long)(entry->duration_s / 60),
+               (unsigned long)(entry->duration_s % 60));
+    }
+    canvas_draw_str_aligned(canvas, 126, y, AlignRight, AlignBottom, line);
+    canvas_set_color(canvas, ColorBlack);
+  }
+
+  const RecipeIndexEntry *selected = catalog.getEntry(app->menu_selection);
+  if (selected) {
+    snprintf(line, sizeof(line), "%s, %s", selected->film_type,
+             selected->chemistry);
+    canvas_draw_str(canvas, 2, 51, line);
+  }
+  elements_button_center(canvas, "Start");
+}
+
+// Offers to continue the run the journal says was interrupted
+static void draw_resume(Canvas *canvas, const TankChannel *channel) {
+  const AgitationCursor &cursor = channel->resume_record.cursor;
+  const AgitationProcessStatic *process = channel->current_process;
+  char line[40];
+
+  canvas_set_font(canvas, FontPrimary);
+  format_title(line, sizeof(line), channel, "Resume run?");
+  canvas_draw_str(canvas, 2, 10, line);
+  canvas_set_font(canvas, FontSecondary);
+  canvas_draw_str(canvas, 2, 22, process->process_name);
+  snprintf(line, sizeof(line), "Step %u/%u: %s",
+           (unsigned)(cursor.step_index + 1), (unsigned)process->steps_length,
+           process->steps[cursor.step_index].name);
+  canvas_draw_str(canvas, 2, 32, line);
+  uint32_t seconds = cursor.step_elapsed / AGITATION_TICKS_PER_SECOND;
+  snprintf(line, sizeof(line), "%lu:%02lu into the step",
+           (unsigned long)(seconds / 60), (unsigned long)(seconds % 60));
+  canvas_draw_str(canvas, 2, 42, line);
+
+  elements_button_left(canvas, "Discard");
+  elements_button_center(canvas, "Resume");
+}
+
 // Add motor control callback wrappers
 static void draw_callback(Canvas *canvas, void *context) {
   FilmDeveloperApp *app = (FilmDeveloperApp *)context;
+  const TankChannel *channel = &app->channels[app->selected];
 
   canvas_clear(canvas);
+  if (app->debug_screen) {
+    draw_debug_screen(canvas, channel);
+    return;
+  }
+
+  const StatusModel &status = channel->status;
+  if (channel->resume_offered) {
+    draw_resume(canvas, channel);
+    return;
+  }
+  if (app->catalog.isOpen() && !status.isActive()) {
+    draw_menu(canvas, app);
+    return;
+  }
   canvas_set_font(canvas, FontPrimary);
 
   // Draw title
-  canvas_draw_str(canvas, 2, 12, "C41 Process");
+  char title[48];
+  format_title(title, sizeof(title), channel,
+               channel->current_process->process_name);
+  canvas_draw_str(canvas, 2, 12, title);
+  if (status.isActive()) {
+    canvas_draw_str_aligned(canvas, 126, 12, AlignRight, AlignBottom,
+                            status.getEtaText());
+  }
 
   // Draw current step info
   canvas_set_font(canvas, FontSecondary);
-  canvas_draw_str(canvas, 2, 24, app->step_text);
+  canvas_draw_str(canvas, 2, 24, status.getStepText());
 
   // Draw status or user message
-  if (app->process_interpreter.isWaitingForUser()) {
-    canvas_draw_str(canvas, 2, 36, app->process_interpreter.getUserMessage());
+  if (status.isWaitingForUser()) {
+    canvas_draw_str(canvas, 2, 36, status.getUserMessage());
   } else {
-    canvas_draw_str(canvas, 2, 36, app->status_text);
+    canvas_draw_str(canvas, 2, 36, status.getStatusText());
   }
 
   // Draw movement state if not waiting for user
-  if (!app->process_interpreter.isWaitingForUser()) {
-    canvas_draw_str(canvas, 2, 48, app->movement_text);
+  if (!status.isWaitingForUser()) {
+    canvas_draw_str(canvas, 2, 48, status.getMovementText());
   }
 
   // Draw pin states
   canvas_draw_str(canvas, 2, 60, "CW:");
-  canvas_draw_str(canvas, 50, 60,
-                  app->motor_controller->isRunning() ? "ON" : "OFF");
+  canvas_draw_str(canvas, 50, 60, status.isMotorRunning() ? "ON" : "OFF");
 
   canvas_draw_str(canvas, 2, 70, "CCW:");
-  canvas_draw_str(canvas, 50, 70,
-                  app->motor_controller->isRunning() ? "ON" : "OFF");
+  canvas_draw_str(canvas, 50, 70, status.isMotorRunning() ? "ON" : "OFF");
 
   // Draw control hints
-  if (app->process_active) {
-    if (app->process_interpreter.isWaitingForUser()) {
+  if (status.isActive()) {
+    if (status.isWaitingForUser()) {
       elements_button_center(canvas, "Continue");
-    } else if (app->paused) {
+    } else if (status.isPaused()) {
       elements_button_center(canvas, "Resume");
     } else {
       elements_button_center(canvas, "Pause");
@@ -88,86 +346,757 @@ static void draw_callback(Canvas *canvas, void *context) {
   }
 }
 
+// Runs on the timer thread, at elevated priority. Commands still queued for
+// later, e.g. when the timer fired a tick early, get the timer again.
+static void motor_timer_callback(void *context) {
+  TankChannel *channel = (TankChannel *)context;
+  uint32_t wait =
+      channel->motor_queue.execute(furi_get_tick(), *channel->motor_output);
+  if (wait != MotorCommandQueue::NO_COMMAND_PENDING) {
+    furi_timer_start(channel->motor_timer, wait);
+  }
+}
+
+// Arms the motor timer for the commands queued with time `at_ms`. A timer
+// already armed for earlier commands is left alone; the callback arms it
+// again for the rest.
+static void arm_motor_timer(TankChannel *channel, uint32_t at_ms) {
+  if (furi_timer_is_running(channel->motor_timer) &&
+      (int32_t)(furi_timer_get_expire_time(channel->motor_timer) - at_ms) <=
+          0) {
+    return;
+  }
+  int32_t delay = (int32_t)(at_ms - furi_get_tick());
+  furi_timer_start(channel->motor_timer, delay > 0 ? (uint32_t)delay : 1);
+}
+
+// Stops the motor as soon as possible, dropping commands queued ahead
+static void stop_motor_now(TankChannel *channel) {
+  uint32_t now = furi_get_tick();
+  channel->motor_queue.cancelPending();
+  channel->motor_queue.setTimestamp(now);
+  channel->motor_controller->stop();
+  arm_motor_timer(channel, now);
+}
+
+// Redraws the screen if anything on it changed, or unconditionally with
+// `force`. Nothing is formatted or drawn while the display stays the same;
+// tanks not on screen are not looked at.
+static void refresh_view(FilmDeveloperApp *app, bool force) {
+  TankChannel *channel = &app->channels[app->selected];
+  bool changed = channel->status.update(
+      channel->process_interpreter, *channel->motor_controller,
+      channel->process_active, channel->paused);
+  if (changed || force || app->debug_screen) {
+    view_port_update(app->view_port);
+  }
+}
+
+// Follows step durations for the timing stats, after anything that may have
+// changed the process state
+static void observe_step(TankChannel *channel) {
+  uint32_t now = furi_get_tick();
+  if (!channel->process_active) {
+    channel->timing.steps.finish(now);
+    return;
+  }
+
+  uint32_t planned = channel->process_interpreter.getStepDuration();
+  channel->timing.steps.observe(
+      channel->process_interpreter.getCurrentStepIndex(),
+      planned == AgitationMovement::UNBOUNDED_DURATION
+          ? StepTimings::UNBOUNDED
+          : agitation_ticks_to_ms(planned),
+      !channel->paused && !channel->process_interpreter.isWaitingForUser(),
+      now);
+}
+
+// Runs every tick due by `now`, however many were missed. The motor command
+// they leave is applied when the last of them is due.
+static void run_until(TankChannel *channel, uint32_t now) {
+  channel->motor_queue.collectLateness(channel->timing.motor_late_ms);
+  AgitationProcessInterpreter &interpreter = channel->process_interpreter;
+  uint32_t due_at = interpreter.tickTimeMs(interpreter.ticksDueAt(now));
+  channel->motor_queue.setTimestamp(due_at);
+  bool still_active = channel->process_active && interpreter.runUntil(now);
+
+  channel->process_active = still_active;
+  if (!still_active) {
+    channel->motor_controller->stop();
+  }
+  arm_motor_timer(channel, due_at);
+  observe_step(channel);
+}
+
+// Works out when the interpreter of `channel` next changes state, so nothing
+// wakes up while a movement just keeps doing the same thing
+static void plan_channel(TankChannel *channel) {
+  channel->scheduled = false;
+  if (!channel->process_active || channel->paused) {
+    return;
+  }
+
+  uint32_t ticks = channel->process_interpreter.nextEventIn();
+  if (ticks == AgitationMovement::NO_PENDING_EVENT) {
+    // Waiting for the user, input plans the tank again
+    return;
+  }
+  if (ticks > MAX_TIMER_SLEEP_TICKS) {
+    ticks = MAX_TIMER_SLEEP_TICKS;
+  }
+
+  channel->next_event_at = channel->process_interpreter.tickTimeMs(
+      channel->process_interpreter.getElapsedTicks() + ticks);
+  channel->scheduled = true;
+}
+
+// Whether the ticks of `channel` are to run in a pass at `now`
+static bool is_channel_due(const TankChannel *channel, uint32_t now) {
+  return channel->scheduled &&
+         (int32_t)(channel->next_event_at - MOTOR_COMMAND_LEAD_MS - now) <=
+             (int32_t)SCHEDULE_BATCH_MS;
+}
+
+// Arms the one-shot state timer for the tank due first, or stops it if no
+// tank is scheduled
+static void schedule_next_tick(FilmDeveloperApp *app) {
+  uint32_t now = furi_get_tick();
+  bool armed = false;
+  int32_t delay = 0;
+  for (const TankChannel &channel : app->channels) {
+    if (!channel.scheduled) {
+      continue;
+    }
+    int32_t until =
+        (int32_t)(channel.next_event_at - MOTOR_COMMAND_LEAD_MS - now);
+    if (!armed || until < delay) {
+      delay = until;
+      armed = true;
+    }
+  }
+
+  if (!armed) {
+    furi_event_loop_timer_stop(app->state_timer);
+    return;
+  }
+  if (delay < 1) {
+    delay = 1;
+  }
+  app->wakeup_at = now + (uint32_t)delay;
+  furi_event_loop_timer_start(app->state_timer, (uint32_t)delay);
+}
+
+// Runs the ticks that already passed in the current sleep, before user input
+// changes the interpreter state underneath it
+static void catch_up_ticks(TankChannel *channel) {
+  if (!channel->scheduled) {
+    return;
+  }
+  run_until(channel, furi_get_tick());
+}
+
+// Appends `record` to the journal of `channel`. When the file is full the
+// record starts the other one over, which only holds older records. The
+// file is closed after every record, so what is written stays written.
+static void append_journal(TankChannel *channel, const JournalRecord &record) {
+  ProcessJournal &journal = channel->journal;
+  char path[64];
+  snprintf(path, sizeof(path), JOURNAL_PATH_FORMAT, (unsigned)channel->index,
+           (unsigned)journal.getNextFile());
+  Storage *storage = (Storage *)furi_record_open(RECORD_STORAGE);
+  storage_simply_mkdir(storage, STORAGE_APP_DATA_PATH_PREFIX);
+  File *file = storage_file_alloc(storage);
+  bool written =
+      storage_file_open(file, path, FSAM_WRITE,
+                        journal.isFull() ? FSOM_CREATE_ALWAYS
+                                         : FSOM_OPEN_APPEND) &&
+      storage_file_write(file, &record, sizeof(record)) == sizeof(record);
+  written = storage_file_close(file) && written;
+  storage_file_free(file);
+  furi_record_close(RECORD_STORAGE);
+
+  if (written) {
+    journal.appended();
+  } else {
+    printf("%s: record %lu not written\r\n", path, record.sequence);
+    journal.failed();
+  }
+}
+
+// Journals the run when it moved on enough, and its end once it is over
+static void update_journal(TankChannel *channel) {
+  JournalRecord record;
+  if (channel->process_active) {
+    if (channel->journal.update(channel->process_interpreter, channel->paused,
+                                furi_get_tick(), record)) {
+      append_journal(channel, record);
+    }
+  } else if (channel->journal.isRunning()) {
+    channel->journal.finish(record);
+    append_journal(channel, record);
+  }
+}
+
+// Runs every tank that is due in one pass, so the cost of a wakeup grows
+// with the tanks that have something to do and nothing else
 static void timer_callback(void *context) {
   FilmDeveloperApp *app = (FilmDeveloperApp *)context;
+  uint32_t now = furi_get_tick();
+  // Against the time the timer was meant to fire, not when it was armed
+  int32_t late = (int32_t)(now - app->wakeup_at);
 
-  if (app->process_active && !app->paused) {
-    bool still_active = app->process_interpreter.tick();
+  for (TankChannel &channel : app->channels) {
+    if (!is_channel_due(&channel, now)) {
+      continue;
+    }
+    if (late < 0) {
+      channel.timing.timer_early++;
+    } else {
+      channel.timing.timer_late_ms.record((uint32_t)late);
+    }
 
-    // Update status texts
-    const AgitationStepStatic *current_step =
-        &app->current_process
-             ->steps[app->process_interpreter.getCurrentStepIndex()];
+    // Normally the planned ticks run ahead of time; a timer that fires past
+    // them also runs whatever fell due since
+    uint32_t started = DWT->CYCCNT;
+    bool behind = (int32_t)(now - channel.next_event_at) > 0;
+    run_until(&channel, behind ? now : channel.next_event_at);
+    channel.timing.tick_us.record(
+        (DWT->CYCCNT - started) /
+        furi_hal_cortex_instructions_per_microsecond());
+    update_journal(&channel);
+    plan_channel(&channel);
+  }
 
-    snprintf(app->step_text, sizeof(app->step_text), "Step: %s",
-             current_step->name);
+  uint32_t started = DWT->CYCCNT;
+  refresh_view(app, false);
+  app->channels[app->selected].timing.status_us.record(
+      (DWT->CYCCNT - started) / furi_hal_cortex_instructions_per_microsecond());
+  schedule_next_tick(app);
+}
+
+static bool trace_file_sink(const void *data, size_t size, void *context) {
+  return storage_file_write((File *)context, data, size) == size;
+}
 
-    // Show remaining time for current movement
-    snprintf(app->status_text, sizeof(app->status_text), "%s Time: %lus/%lus",
-             app->paused ? "[PAUSED]" : "",
-             app->process_interpreter.getCurrentMovementTimeElapsed(),
-             app->process_interpreter.getCurrentMovementDuration());
+static void timing_file_sink(const char *line, void *context) {
+  File *file = (File *)context;
+  storage_file_write(file, line, strlen(line));
+  storage_file_write(file, "\n", 1);
+}
 
-    // Update movement text based on motor controller state
-    snprintf(app->movement_text, sizeof(app->movement_text), "Movement: %s",
-             app->motor_controller->getDirectionString());
+static void timing_console_sink(const char *line, void *context) {
+  UNUSED(context);
+  printf("%s\r\n", line);
+}
+
+static size_t process_file_read(void *buffer, size_t size, void *context) {
+  return storage_file_read((File *)context, buffer, size);
+}
 
-    app->process_active = still_active;
-    if (!still_active) {
-      app->motor_controller->stop();
+// Prints what is wrong with `process`, loaded from `source`, and what its
+// largest step takes to load. False if it has errors and is not to be run.
+static bool validate_process(const char *source,
+                             const AgitationProcessStatic *process) {
+  AgitationValidation validation;
+  bool valid = agitation_process_validate(process, &validation);
+  char line[96];
+  for (size_t i = 0; i < validation.issues_length &&
+                     i < AGITATION_VALIDATION_MAX_ISSUES;
+       i++) {
+    agitation_issue_format(&validation.issues[i], line, sizeof(line));
+    printf("%s: %s %s\r\n", source,
+           agitation_issue_is_error(validation.issues[i].kind) ? "error"
+                                                              : "warning",
+           line);
+  }
+  printf("%s: %u pool bytes, %u movements, %u loop levels\r\n", source,
+         (unsigned)validation.worst.pool_bytes,
+         (unsigned)validation.worst.movements,
+         (unsigned)validation.worst.depth);
+  return valid;
+}
+
+// Reads PROCESS_IMAGE_PATH and sets up its first process; nullptr if there
+// is no such file, it is no valid image or the process does not validate
+static const AgitationProcessStatic *load_process_image(FilmDeveloperApp *app) {
+  const AgitationProcessStatic *process = nullptr;
+  Storage *storage = (Storage *)furi_record_open(RECORD_STORAGE);
+  File *file = storage_file_alloc(storage);
+
+  if (storage_file_open(file, PROCESS_IMAGE_PATH, FSAM_READ,
+                        FSOM_OPEN_EXISTING)) {
+    uint64_t size = storage_file_size(file);
+    const char *error = "too large";
+    if (size <= PROCESS_IMAGE_MAX_SIZE) {
+      void *image = malloc(size);
+      error = "cannot read";
+      if (storage_file_read(file, image, size) == size &&
+          agitation_image_check(image, size, &error) &&
+          agitation_image_get_process(image, 0, &app->image_process)) {
+        error = "does not validate";
+        if (validate_process(PROCESS_IMAGE_PATH,
+                             &app->image_process.process)) {
+          app->process_image = image;
+          process = &app->image_process.process;
+        }
+      }
+      if (!process) {
+        free(image);
+      }
+    }
+    if (process) {
+      printf("%s: %u processes, %u bytes\r\n", PROCESS_IMAGE_PATH,
+             (unsigned)agitation_image_processes_length(app->process_image),
+             (unsigned)size);
+    } else {
+      printf("%s: %s\r\n", PROCESS_IMAGE_PATH, error);
     }
   }
 
-  view_port_update(app->view_port);
+  storage_file_close(file);
+  storage_file_free(file);
+  furi_record_close(RECORD_STORAGE);
+  return process;
 }
 
-static void input_callback(InputEvent *input_event, void *context) {
-  FilmDeveloperApp *app = (FilmDeveloperApp *)context;
+// Loads PROCESS_YAML_PATH into the process arena; nullptr if there is no
+// such file, it does not load or the process does not validate
+static const AgitationProcessStatic *load_process_file(FilmDeveloperApp *app) {
+  const AgitationProcessStatic *process = nullptr;
+  Storage *storage = (Storage *)furi_record_open(RECORD_STORAGE);
+  File *file = storage_file_alloc(storage);
+
+  if (storage_file_open(file, PROCESS_YAML_PATH, FSAM_READ,
+                        FSOM_OPEN_EXISTING)) {
+    void *memory = malloc(PROCESS_ARENA_SIZE);
+    agitation_arena_init(&app->process_arena, memory, PROCESS_ARENA_SIZE);
+    AgitationYamlError error;
+    process = agitation_process_from_yaml(process_file_read, file,
+                                          &app->process_arena, &error);
+    if (process) {
+      printf("%s: %u bytes, %u while loading\r\n", PROCESS_YAML_PATH,
+             (unsigned)app->process_arena.used,
+             (unsigned)app->process_arena.peak);
+      if (!validate_process(PROCESS_YAML_PATH, process)) {
+        process = nullptr;
+      }
+    } else {
+      printf("%s:%lu: %s\r\n", PROCESS_YAML_PATH, error.line, error.message);
+    }
+    if (!process) {
+      free(memory);
+      agitation_arena_init(&app->process_arena, nullptr, 0);
+    }
+  }
+
+  storage_file_close(file);
+  storage_file_free(file);
+  furi_record_close(RECORD_STORAGE);
+  return process;
+}
+
+static bool process_file_write(const void *data, size_t size, void *context) {
+  return storage_file_write((File *)context, data, size) == size;
+}
+
+// Writes `process` to PROCESS_EXPORT_PATH
+static void export_process(const AgitationProcessStatic *process) {
+  if (!process) {
+    return;
+  }
+  Storage *storage = (Storage *)furi_record_open(RECORD_STORAGE);
+  storage_simply_mkdir(storage, STORAGE_APP_DATA_PATH_PREFIX);
+  File *file = storage_file_alloc(storage);
+  bool written = false;
+  if (storage_file_open(file, PROCESS_EXPORT_PATH, FSAM_WRITE,
+                        FSOM_CREATE_ALWAYS)) {
+    written = agitation_process_to_yaml(process, process_file_write, file);
+  }
+  storage_file_close(file);
+  storage_file_free(file);
+  furi_record_close(RECORD_STORAGE);
+  printf("%s: %s\r\n", PROCESS_EXPORT_PATH,
+         written ? "written" : "could not write");
+}
+
+// RecipeCatalogRead for a storage file
+static bool catalog_file_read(uint32_t offset, void *buffer, size_t size,
+                              void *context) {
+  File *file = (File *)context;
+  return storage_file_seek(file, offset, true) &&
+         storage_file_read(file, buffer, size) == size;
+}
+
+static void close_catalog(FilmDeveloperApp *app) {
+  if (!app->storage) {
+    return;
+  }
+  app->catalog.close();
+  storage_file_close(app->recipes_file);
+  storage_file_free(app->recipes_file);
+  storage_file_close(app->index_file);
+  storage_file_free(app->index_file);
+  furi_record_close(RECORD_STORAGE);
+  app->storage = nullptr;
+}
+
+// Opens the catalog at RECIPES_PATH and reads the entries the menu shows
+// first. Both files stay open while the menu is in use; false if there is no
+// catalog or its index was not built for the recipes next to it.
+static bool open_catalog(FilmDeveloperApp *app) {
+  app->storage = (Storage *)furi_record_open(RECORD_STORAGE);
+  app->recipes_file = storage_file_alloc(app->storage);
+  app->index_file = storage_file_alloc(app->storage);
+  app->menu_selection = 0;
+  app->menu_top = 0;
+
+  if (!storage_file_open(app->recipes_file, RECIPES_PATH, FSAM_READ,
+                         FSOM_OPEN_EXISTING)) {
+    close_catalog(app);
+    return false;
+  }
+  bool opened =
+      storage_file_open(app->index_file, RECIPES_INDEX_PATH, FSAM_READ,
+                        FSOM_OPEN_EXISTING) &&
+      app->catalog.open(catalog_file_read, app->index_file,
+                        (uint32_t)storage_file_size(app->recipes_file)) &&
+      app->catalog.getLength() > 0 && app->catalog.fetch(0, MENU_ROWS);
+  if (opened) {
+    printf("%s: %u recipes\r\n", RECIPES_INDEX_PATH,
+           (unsigned)app->catalog.getLength());
+  } else {
+    printf("%s: missing, empty or stale\r\n", RECIPES_INDEX_PATH);
+    close_catalog(app);
+  }
+  return opened;
+}
+
+// Moves the menu selection by one row, scrolling to keep it in view. Entries
+// are read a window at a time, ahead in the direction of travel.
+static void move_selection(FilmDeveloperApp *app, bool up) {
+  RecipeCatalog &catalog = app->catalog;
+  size_t length = catalog.getLength();
+  if (up && app->menu_selection > 0) {
+    app->menu_selection--;
+  } else if (!up && app->menu_selection + 1 < length) {
+    app->menu_selection++;
+  }
+  if (app->menu_selection < app->menu_top) {
+    app->menu_top = app->menu_selection;
+  } else if (app->menu_selection >= app->menu_top + MENU_ROWS) {
+    app->menu_top = app->menu_selection + 1 - MENU_ROWS;
+  }
+
+  size_t last = app->menu_top + MENU_ROWS < length
+                    ? app->menu_top + MENU_ROWS - 1
+                    : length - 1;
+  if (!catalog.getEntry(app->menu_top) || !catalog.getEntry(last)) {
+    size_t first = app->menu_top;
+    if (up) {
+      first = last + 1 > RecipeCatalog::WINDOW_SIZE
+                  ? last + 1 - RecipeCatalog::WINDOW_SIZE
+                  : 0;
+    }
+    catalog.fetch(first, RecipeCatalog::WINDOW_SIZE);
+  }
+}
+
+// Reads recipe `index` of the catalog and makes it the current process of
+// `channel`. The recipe loaded before stays if it cannot be read, is no
+// valid image or does not validate.
+static bool load_recipe(FilmDeveloperApp *app, TankChannel *channel,
+                        size_t index) {
+  const RecipeIndexEntry *entry =
+      app->catalog.fetch(index, 1) ? app->catalog.getEntry(index) : nullptr;
+  if (!entry) {
+    return false;
+  }
+
+  const char *error = "too large";
+  bool loaded = false;
+  if (entry->size <= PROCESS_IMAGE_MAX_SIZE) {
+    void *image = malloc(entry->size);
+    error = "cannot read";
+    // A valid image always has a first process
+    loaded = catalog_file_read(entry->offset, image, entry->size,
+                               app->recipes_file) &&
+             agitation_image_check(image, entry->size, &error) &&
+             agitation_image_get_process(image, 0, &channel->recipe_process);
+    if (loaded) {
+      error = "does not validate";
+      loaded = validate_process(RECIPES_PATH, &channel->recipe_process.process);
+    }
+    if (loaded) {
+      free(channel->recipe_image);
+      channel->recipe_image = image;
+      channel->current_process = &channel->recipe_process.process;
+      channel->current_recipe =
+          index < PROCESS_JOURNAL_NO_RECIPE ? (uint16_t)index
+                                            : PROCESS_JOURNAL_NO_RECIPE;
+    } else {
+      free(image);
+    }
+  }
+  if (!loaded) {
+    printf("%s: recipe %u: %s\r\n", RECIPES_PATH, (unsigned)index, error);
+  }
+  return loaded;
+}
+
+// Reads the newest intact record of the journal of `channel`, from either
+// of its files. If it is the progress of a run that did not finish, and its
+// process is at hand, resume_offered is set and the process made current.
+static void check_journal(FilmDeveloperApp *app, TankChannel *channel) {
+  char path[64];
+  Storage *storage = (Storage *)furi_record_open(RECORD_STORAGE);
+  File *file = storage_file_alloc(storage);
+  JournalRecord &newest = channel->resume_record;
+  JournalRecord record;
+  bool found = false;
+  // Where the newest record is; with nothing found, file 0 is started over
+  uint32_t newest_file = ProcessJournal::FILES - 1;
+  uint32_t newest_file_records = ProcessJournal::MAX_RECORDS;
+  for (uint32_t index = 0; index < ProcessJournal::FILES; index++) {
+    snprintf(path, sizeof(path), JOURNAL_PATH_FORMAT,
+             (unsigned)channel->index, (unsigned)index);
+    if (!storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+      storage_file_close(file);
+      continue;
+    }
+    // A record torn by a power loss fails its check and is skipped
+    uint32_t records = 0;
+    bool newest_here = false;
+    size_t read;
+    while ((read = storage_file_read(file, &record, sizeof(record))) ==
+           sizeof(record)) {
+      records++;
+      if (journal_record_check(record) &&
+          (!found || (int32_t)(record.sequence - newest.sequence) > 0)) {
+        newest = record;
+        found = true;
+        newest_here = true;
+      }
+    }
+    storage_file_close(file);
+    if (newest_here) {
+      newest_file = index;
+      // Records appended after a partial one would not line up
+      newest_file_records = read > 0 ? ProcessJournal::MAX_RECORDS : records;
+    }
+  }
+  storage_file_free(file);
+  furi_record_close(RECORD_STORAGE);
+
+  channel->journal.reset(newest_file, newest_file_records,
+                         found ? newest.sequence : 0);
+  if (!found || newest.kind != (uint8_t)JournalKind::Progress) {
+    return;
+  }
+
+  uint16_t recipe = newest.recipe;
+  if (recipe != PROCESS_JOURNAL_NO_RECIPE && app->catalog.isOpen() &&
+      recipe < app->catalog.getLength() && load_recipe(app, channel, recipe) &&
+      channel->index == app->selected) {
+    app->menu_selection = recipe;
+    app->menu_top = recipe;
+    app->catalog.fetch(recipe, MENU_ROWS);
+  }
+  channel->resume_offered =
+      channel->current_process &&
+      newest.cursor.step_index < channel->current_process->steps_length &&
+      agitation_process_id(channel->current_process) == newest.process_id;
+  snprintf(path, sizeof(path), JOURNAL_PATH_FORMAT, (unsigned)channel->index,
+           (unsigned)newest_file);
+  printf("%s: run at step %u, %s\r\n", path,
+         (unsigned)newest.cursor.step_index,
+         channel->resume_offered ? "offered to resume" : "process not found");
+}
+
+// Prints the trace and the timing stats of the tank on screen to the
+// console, and saves them. The trace holds the events of all tanks.
+static void dump_diagnostics(FilmDeveloperApp *app) {
+  TankChannel *channel = &app->channels[app->selected];
+  channel->motor_queue.collectLateness(channel->timing.motor_late_ms);
+  const TimingStats &timing = channel->timing;
+  TraceRecord record;
+  char line[96];
+  uint32_t end = trace_buffer.end();
+  for (uint32_t sequence = trace_buffer.begin(); sequence != end; sequence++) {
+    trace_buffer.read(sequence, record);
+    trace_format(record, line, sizeof(line));
+    printf("%lu %lu %s\r\n", sequence, record.timestamp, line);
+  }
+  timing.print(timing_console_sink, nullptr);
+
+  Storage *storage = (Storage *)furi_record_open(RECORD_STORAGE);
+  storage_simply_mkdir(storage, STORAGE_APP_DATA_PATH_PREFIX);
+  File *file = storage_file_alloc(storage);
+  if (storage_file_open(file, TRACE_DUMP_PATH, FSAM_WRITE,
+                        FSOM_CREATE_ALWAYS)) {
+    trace_write_dump(trace_buffer, trace_file_sink, file);
+  }
+  storage_file_close(file);
+  if (storage_file_open(file, TIMING_DUMP_PATH, FSAM_WRITE,
+                        FSOM_CREATE_ALWAYS)) {
+    timing.print(timing_file_sink, file);
+  }
+  storage_file_close(file);
+  storage_file_free(file);
+  furi_record_close(RECORD_STORAGE);
+}
+
+static void start_process(TankChannel *channel, uint32_t now) {
+  stop_motor_now(channel);
+  channel->process_interpreter.init(channel->current_process,
+                                    channel->motor_controller);
+  channel->process_active = true;
+  channel->paused = false;
+  channel->process_interpreter.anchor(now);
+  // Commands of the last run applied so far are not counted in this one
+  channel->motor_queue.collectLateness(channel->timing.motor_late_ms);
+  channel->timing.reset();
+  channel->journal.begin(agitation_process_id(channel->current_process),
+                         channel->current_recipe, now);
+}
+
+// Continues the run the journal offered, paused so the tank can be set up
+// before the motor starts
+static void resume_process(TankChannel *channel, uint32_t now) {
+  channel->resume_offered = false;
+  start_process(channel, now);
+  if (!channel->process_interpreter.restoreCursor(
+          channel->resume_record.cursor)) {
+    printf("Tank %u: cannot resume\r\n", (unsigned)(channel->index + 1));
+    channel->process_active = false;
+    return;
+  }
+  channel->process_interpreter.anchor(now);
+  channel->paused = true;
+}
+
+// Input applies to the tank on screen; the others keep running as they are
+static void handle_input(FilmDeveloperApp *app, const InputEvent *input_event) {
+  TankChannel *channel = &app->channels[app->selected];
+  catch_up_ticks(channel);
+  uint32_t now = furi_get_tick();
+  bool redraw = false;
+  // The recipe menu is up whenever the tank runs no process
+  bool menu = app->catalog.isOpen() && !channel->process_active;
 
   if (input_event->type == InputTypeShort) {
-    if (input_event->key == InputKeyOk) {
-      if (!app->process_active) {
+    if (channel->resume_offered) {
+      if (input_event->key == InputKeyOk) {
+        resume_process(channel, now);
+      } else if (input_event->key == InputKeyLeft) {
+        // Nothing left to resume on the next start either
+        JournalRecord record;
+        channel->resume_offered = false;
+        channel->journal.finish(record);
+        append_journal(channel, record);
+      }
+      redraw = true;
+    } else if (menu && (input_event->key == InputKeyUp ||
+                        input_event->key == InputKeyDown)) {
+      move_selection(app, input_event->key == InputKeyUp);
+      redraw = true;
+    } else if (input_event->key == InputKeyOk) {
+      if (menu) {
+        // Start the chosen recipe
+        if (load_recipe(app, channel, app->menu_selection)) {
+          start_process(channel, now);
+        }
+      } else if (!channel->process_active) {
         // Start new process
-        app->process_interpreter.init(&C41_FULL_PROCESS_STATIC,
-                                      app->motor_controller);
-        app->process_active = true;
-        app->paused = false;
-      } else if (app->process_interpreter.isWaitingForUser()) {
+        start_process(channel, now);
+      } else if (channel->process_interpreter.isWaitingForUser()) {
         // Handle user confirmation
-        app->process_interpreter.confirm();
+        channel->process_interpreter.confirm();
+        channel->process_interpreter.anchor(now);
       } else {
         // Toggle pause
-        app->paused = !app->paused;
-        if (app->paused) {
-          app->motor_controller->stop();
+        channel->paused = !channel->paused;
+        if (channel->paused) {
+          stop_motor_now(channel);
+        } else {
+          channel->process_interpreter.anchor(now);
         }
       }
-    } else if (app->process_active && input_event->key == InputKeyRight) {
+    } else if (channel->process_active && input_event->key == InputKeyRight) {
       // Skip to next step (only if not waiting for user)
-      if (!app->process_interpreter.isWaitingForUser()) {
-        app->motor_controller->stop();
-        app->process_interpreter.skipToNextStep();
-        if (app->process_interpreter.getCurrentStepIndex() >=
-            app->current_process->steps_length) {
-          app->process_active = false;
+      if (!channel->process_interpreter.isWaitingForUser()) {
+        stop_motor_now(channel);
+        channel->process_interpreter.skipToNextStep();
+        channel->process_interpreter.anchor(now);
+        if (channel->process_interpreter.getCurrentStepIndex() >=
+            channel->current_process->steps_length) {
+          channel->process_active = false;
         }
       }
-    } else if (app->process_active && input_event->key == InputKeyLeft) {
+    } else if (channel->process_active && input_event->key == InputKeyLeft) {
       // Restart current step
-      app->motor_controller->stop();
-      app->process_interpreter.reset();
-    }
-  } else if (input_event->type == InputTypeShort &&
-             input_event->key == InputKeyBack) {
-    if (app->process_active) {
-      // Stop process
-      app->process_active = false;
-      app->paused = false;
-      app->motor_controller->stop();
-    } else {
-      furi_event_loop_stop(app->event_loop);
+      stop_motor_now(channel);
+      channel->process_interpreter.reset();
+      channel->process_interpreter.anchor(now);
+    } else if (input_event->key == InputKeyBack) {
+      if (channel->process_active) {
+        // Stop process
+        channel->process_active = false;
+        channel->paused = false;
+        stop_motor_now(channel);
+      } else {
+        // Leaving would stop the other tanks, show one that still runs
+        bool running = false;
+        for (const TankChannel &other : app->channels) {
+          if (other.process_active) {
+            app->selected = other.index;
+            running = true;
+            break;
+          }
+        }
+        if (running) {
+          redraw = true;
+        } else {
+          furi_event_loop_stop(app->event_loop);
+        }
+      }
     }
+  } else if (input_event->type == InputTypeLong &&
+             input_event->key == InputKeyDown) {
+    dump_diagnostics(app);
+  } else if (input_event->type == InputTypeLong &&
+             input_event->key == InputKeyLeft) {
+    export_process(channel->current_process);
+  } else if (input_event->type == InputTypeLong &&
+             input_event->key == InputKeyUp) {
+    app->debug_screen = !app->debug_screen;
+    redraw = true;
+  } else if (input_event->type == InputTypeLong &&
+             input_event->key == InputKeyRight) {
+    app->selected = (app->selected + 1) % TANK_CHANNELS;
+    redraw = true;
   }
+
+  observe_step(channel);
+  update_journal(channel);
+  plan_channel(channel);
+  schedule_next_tick(app);
+  refresh_view(app, redraw);
+}
+
+// Input arrives on the GUI thread; hand it over to the event loop so that
+// interpreter and timer are only ever touched from one thread
+static void input_callback(InputEvent *input_event, void *context) {
+  FilmDeveloperApp *app = (FilmDeveloperApp *)context;
+  furi_message_queue_put(app->input_queue, input_event, 0);
+}
+
+static void input_queue_callback(FuriEventLoopObject *object, void *context) {
+  FilmDeveloperApp *app = (FilmDeveloperApp *)context;
+  FuriMessageQueue *queue = (FuriMessageQueue *)object;
+
+  InputEvent input_event;
+  furi_check(furi_message_queue_get(queue, &input_event, 0) == FuriStatusOk);
+  handle_input(app, &input_event);
 }
 
 #ifdef __cplusplus
@@ -176,23 +1105,44 @@ extern "C" {
 
 int32_t film_developer_app(void *p) {
   UNUSED(p);
-  FilmDeveloperApp *app = (FilmDeveloperApp *)malloc(sizeof(FilmDeveloperApp));
+  static_assert(TANK_CHANNELS >= 1 &&
+                    TANK_CHANNELS <= MotorControllerEmbedded::CHANNELS,
+                "Every tank needs a motor channel");
+  // The interpreters own the movement pools, so the app has to be
+  // constructed
+  FilmDeveloperApp *app =
+      new (malloc(sizeof(FilmDeveloperApp))) FilmDeveloperApp();
 
-  MotorControllerEmbedded motorController;
-  motorController.initGpio();
+  MotorControllerEmbedded motors[TANK_CHANNELS];
 
-  // Create appropriate motor controller
+  // Motor commands are applied from the timer thread, which gets priority
+  // over the GUI and the event loop
+  furi_timer_set_thread_priority(FuriTimerThreadPriorityElevated);
+  for (size_t i = 0; i < TANK_CHANNELS; i++) {
+    TankChannel *channel = &app->channels[i];
+    channel->index = i;
+    motors[i].initGpio(i);
+    // Create appropriate motor controller
 #ifdef HOST
-  app->motor_controller = new MockController();
+    channel->motor_output = new MockController();
 #else
-  app->motor_controller = &motorController;
+    channel->motor_output = &motors[i];
 #endif
+    channel->motor_controller = &channel->motor_queue;
+    // Each tank has its own, so a command of one never waits on another's
+    channel->motor_timer =
+        furi_timer_alloc(motor_timer_callback, FuriTimerTypeOnce, channel);
+  }
 
   // Register app instance for callbacks
   furi_record_create("film_developer", app);
 
   // Create event loop
   app->event_loop = furi_event_loop_alloc();
+  app->input_queue = furi_message_queue_alloc(8, sizeof(InputEvent));
+  furi_event_loop_subscribe_message_queue(app->event_loop, app->input_queue,
+                                          FuriEventLoopEventIn,
+                                          input_queue_callback, app);
 
   // Create GUI
   app->gui = (Gui *)furi_record_open(RECORD_GUI);
@@ -201,18 +1151,41 @@ int32_t film_developer_app(void *p) {
   view_port_input_callback_set(app->view_port, input_callback, app);
   gui_add_view_port(app->gui, app->view_port, GuiLayerFullscreen);
 
-  // Create timer
+  // Create timer, armed on demand for the next state change of any tank
   app->state_timer = furi_event_loop_timer_alloc(
-      app->event_loop, timer_callback, FuriEventLoopTimerTypePeriodic, app);
-  furi_event_loop_timer_start(app->state_timer, 1000); // 1 second intervals
+      app->event_loop, timer_callback, FuriEventLoopTimerTypeOnce, app);
+  app->wakeup_at = furi_get_tick();
 
   // Set initial state
-  app->current_process = &C41_FULL_PROCESS_STATIC;
-  app->process_active = false;
-  app->paused = false;
-  snprintf(app->status_text, sizeof(app->status_text), "Press OK to start");
-  snprintf(app->step_text, sizeof(app->step_text), "Ready");
-  snprintf(app->movement_text, sizeof(app->movement_text), "Movement: Idle");
+  agitation_arena_init(&app->process_arena, nullptr, 0);
+  app->process_image = nullptr;
+  app->storage = nullptr;
+  app->selected = 0;
+  // With a catalog, there is no process until one is chosen from the menu
+  const AgitationProcessStatic *process = nullptr;
+  if (!open_catalog(app)) {
+    process = load_process_image(app);
+    if (!process) {
+      process = load_process_file(app);
+    }
+    if (!process) {
+      process = &C41_FULL_PROCESS_STATIC;
+    }
+  }
+  for (TankChannel &channel : app->channels) {
+    channel.current_process = process;
+    channel.current_recipe = PROCESS_JOURNAL_NO_RECIPE;
+    channel.recipe_image = nullptr;
+    channel.resume_offered = false;
+    check_journal(app, &channel);
+    channel.process_active = false;
+    channel.paused = false;
+    channel.scheduled = false;
+    channel.next_event_at = app->wakeup_at;
+    channel.timing.reset();
+    channel.status.reset();
+  }
+  app->debug_screen = false;
 
   // furi_assert(false, "Hello");
 
@@ -221,16 +1194,30 @@ int32_t film_developer_app(void *p) {
 
   // Cleanup
   furi_event_loop_timer_free(app->state_timer);
+  for (TankChannel &channel : app->channels) {
+    furi_timer_stop(channel.motor_timer);
+    furi_timer_free(channel.motor_timer);
+  }
+  furi_timer_set_thread_priority(FuriTimerThreadPriorityNormal);
+  furi_event_loop_unsubscribe(app->event_loop, app->input_queue);
+  furi_message_queue_free(app->input_queue);
   view_port_enabled_set(app->view_port, false);
   gui_remove_view_port(app->gui, app->view_port);
   view_port_free(app->view_port);
   furi_record_close(RECORD_GUI);
   furi_event_loop_free(app->event_loop);
+  close_catalog(app);
+  free(app->process_arena.memory);
+  free(app->process_image);
 
-  // Clean up motor controller
-  motorController.deinitGpio();
+  // Clean up motor controllers
+  for (size_t i = 0; i < TANK_CHANNELS; i++) {
+    free(app->channels[i].recipe_image);
+    motors[i].deinitGpio();
+  }
   furi_record_destroy("film_developer");
 
+  app->~FilmDeveloperApp();
   free(app);
 
   return 0;
@@ -0,0 +1,168 @@
+#pragma once
+#include "debug.hpp"
+#include "motor_controller.hpp"
+#include "timing_stats.hpp"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A motor direction to apply at a given time
+ * Times are in ms of whatever clock the producer and consumer share
+ * (furi_get_tick() on the device) and may wrap around.
+ */
+struct MotorCommand {
+  uint32_t at_ms;
+  uint32_t epoch; // Commands from before cancelPending() are dropped
+  MotorController::Direction direction;
+};
+
+/**
+ * @brief Lock-free single producer, single consumer ring, of motor commands
+ * one way and of their lateness the other
+ * push() is only called from one thread and peek()/pop() only from another.
+ */
+template <typename Item, size_t Capacity> class MotorRing {
+  static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+public:
+  bool push(const Item &item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= Capacity) {
+      return false;
+    }
+    slots[head & (Capacity - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool peek(Item &item) const {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = slots[tail & (Capacity - 1)];
+    return true;
+  }
+
+  void pop() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  bool empty() const {
+    return tail_.load(std::memory_order_acquire) ==
+           head_.load(std::memory_order_acquire);
+  }
+
+private:
+  Item slots[Capacity];
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+};
+
+/**
+ * @brief Motor controller that queues its transitions instead of driving pins
+ * The interpreter drives this on the event loop, stamping each command with
+ * the time it is due via setTimestamp(). A high priority timer calls
+ * execute() to apply due commands to the real controller, so reversals
+ * happen on time however busy the event loop is, as long as it runs ahead
+ * of the stamps.
+ */
+class MotorCommandQueue final : public MotorController {
+public:
+  static constexpr size_t CAPACITY = 16;
+
+  // Returned by execute() when nothing is left to apply
+  static constexpr uint32_t NO_COMMAND_PENDING = UINT32_MAX;
+
+  MotorCommandQueue() = default;
+
+  // Producer side
+
+  // Due time of the commands that follow
+  void setTimestamp(uint32_t at_ms) { timestamp = at_ms; }
+  uint32_t getTimestamp() const { return timestamp; }
+
+  // Drops every command queued so far that has not been applied yet. The
+  // next command is queued whatever it is, as the motor may not have seen
+  // the last one.
+  void cancelPending() {
+    epoch.fetch_add(1, std::memory_order_release);
+    invalidateDirection();
+  }
+
+  // Commands lost because the ring was full
+  uint32_t getDroppedCount() const { return dropped_count; }
+
+  // Records into `lateness` how late each command applied since the last
+  // call was. The consumer only queues the numbers, so `lateness` belongs
+  // to the producer thread and needs no lock. Nothing is lost as long as
+  // this is called before each batch of commands.
+  void collectLateness(TimingHistogram &lateness) {
+    uint32_t late;
+    while (lateness_ring.peek(late)) {
+      lateness.record(late);
+      lateness_ring.pop();
+    }
+  }
+
+  // Consumer side
+
+  /**
+   * @brief Applies every command due at `now_ms`, in order, and queues how
+   * late each one was for collectLateness()
+   * @return ms until the next queued command is due, or NO_COMMAND_PENDING
+   */
+  uint32_t execute(uint32_t now_ms, MotorController &motor) {
+    MotorCommand command;
+    while (ring.peek(command)) {
+      if (command.epoch != epoch.load(std::memory_order_acquire)) {
+        ring.pop();
+        continue;
+      }
+
+      int32_t wait = static_cast<int32_t>(command.at_ms - now_ms);
+      if (wait > 0) {
+        return static_cast<uint32_t>(wait);
+      }
+
+      switch (command.direction) {
+      case Direction::CW:
+        motor.clockwise(true);
+        break;
+      case Direction::CCW:
+        motor.counterClockwise(true);
+        break;
+      case Direction::Stop:
+      case Direction::Unknown:
+        motor.stop();
+        break;
+      }
+      TRACE_EVENT(MotorApplied, static_cast<uint32_t>(command.direction),
+                  command.at_ms, static_cast<uint32_t>(-wait));
+      lateness_ring.push(static_cast<uint32_t>(-wait));
+      ring.pop();
+    }
+    return NO_COMMAND_PENDING;
+  }
+
+protected:
+  void drive(Direction, Direction to) override {
+    MotorCommand command{timestamp, epoch.load(std::memory_order_relaxed), to};
+    TRACE_EVENT(MotorQueued, static_cast<uint32_t>(to), timestamp);
+    if (!ring.push(command)) {
+      dropped_count++;
+    }
+  }
+
+private:
+  MotorRing<MotorCommand, CAPACITY> ring;
+  // Lateness on its way back; holds the commands queued before the last
+  // collectLateness() and those queued since
+  MotorRing<uint32_t, 2 * CAPACITY> lateness_ring;
+  std::atomic<uint32_t> epoch{0};
+  uint32_t timestamp{0};
+  uint32_t dropped_count{0};
+};
@@ -1,15 +1,59 @@
 #pragma once
 
+#include <stdint.h>
+
+// Tracks the commanded direction and only passes real transitions on to the
+// hardware. Movements repeat their command every tick, so most commands are
+// no-ops and never touch a pin or wait out dead time.
 class MotorController {
 public:
-  virtual void clockwise(bool enable) = 0;
-  virtual void counterClockwise(bool enable) = 0;
-  virtual void stop() = 0;
-  virtual bool isRunning() const = 0;
-  virtual const char *getDirectionString() const = 0;
-  virtual bool isClockwise() const = 0;
-  virtual bool isCounterClockwise() const = 0;
-  virtual bool isStopped() const = 0;
+  // Unknown until the first command, so that one always reaches the pins
+  enum class Direction : uint8_t { Unknown, Stop, CW, CCW };
+
+  void clockwise(bool enable) {
+    if (enable) {
+      command(Direction::CW);
+    } else if (direction == Direction::CW) {
+      command(Direction::Stop);
+    } else {
+      command_count++;
+    }
+  }
+
+  void counterClockwise(bool enable) {
+    if (enable) {
+      command(Direction::CCW);
+    } else if (direction == Direction::CCW) {
+      command(Direction::Stop);
+    } else {
+      command_count++;
+    }
+  }
+
+  void stop() { command(Direction::Stop); }
+
+  Direction getDirection() const { return direction; }
+  bool isRunning() const {
+    return direction == Direction::CW || direction == Direction::CCW;
+  }
+  bool isClockwise() const { return direction == Direction::CW; }
+  bool isCounterClockwise() const { return direction == Direction::CCW; }
+  bool isStopped() const { return !isRunning(); }
+  const char *getDirectionString() const {
+    return direction == Direction::CW    ? "CW"
+           : direction == Direction::CCW ? "CCW"
+                                         : "Idle";
+  }
+
+  // Commands received, transitions passed on to the hardware, and commands
+  // dropped because the motor was already doing that
+  uint32_t getCommandCount() const { return command_count; }
+  uint32_t getTransitionCount() const { return transition_count; }
+  uint32_t getAvoidedCount() const { return command_count - transition_count; }
+  void resetCounters() {
+    command_count = 0;
+    transition_count = 0;
+  }
 
   virtual ~MotorController() = default;
 
@@ -19,4 +63,61 @@ public:
 
 protected:
   MotorController() = default; // Only derived classes can construct
-};
\ No newline at end of file
+
+  // Drives the hardware from one direction to another, `from != to`
+  virtual void drive(Direction from, Direction to) = 0;
+
+  // Forgets the commanded direction, e.g. after the pins were reinitialized
+  void invalidateDirection() { direction = Direction::Unknown; }
+
+  // Takes `assumed` as the current direction without driving anything
+  void assumeDirection(Direction assumed) { direction = assumed; }
+
+private:
+  void command(Direction to) {
+    command_count++;
+    if (to == direction) {
+      return;
+    }
+    transition_count++;
+    Direction from = direction;
+    direction = to;
+    drive(from, to);
+  }
+
+  Direction direction{Direction::Unknown};
+  uint32_t command_count{0};
+  uint32_t transition_count{0};
+};
+
+// Remembers the last command instead of driving a motor. Movements are
+// fast-forwarded against a latch so only the final command reaches the real
+// motor.
+class MotorCommandLatch final : public MotorController {
+public:
+  MotorCommandLatch() = default;
+
+  // Starts out as a motor already moving in `initial`, so commands that keep
+  // it that way are no transitions
+  explicit MotorCommandLatch(Direction initial) { assumeDirection(initial); }
+
+  // Replays the latched command, if any, on a real controller
+  void applyTo(MotorController &motor) const {
+    switch (getDirection()) {
+    case Direction::CW:
+      motor.clockwise(true);
+      break;
+    case Direction::CCW:
+      motor.counterClockwise(true);
+      break;
+    case Direction::Stop:
+      motor.stop();
+      break;
+    case Direction::Unknown:
+      break;
+    }
+  }
+
+protected:
+  void drive(Direction, Direction) override {}
+};
@@ -7,21 +7,20 @@ public:
   LoopMovement(AgitationMovement **sequence, size_t sequence_length,
                uint32_t iterations, uint32_t max_duration)
       : AgitationMovement(Type::Loop, max_duration), sequence(sequence),
-        sequence_length(sequence_length), iterations(iterations),
-        current_iteration(0), current_index(0) {}
+        iterations(iterations), current_iteration(0),
+        sequence_length(static_cast<uint16_t>(sequence_length)),
+        current_index(0) {
+    body_ticks = 0;
+    for (size_t i = 0; i < sequence_length; i++) {
+      body_ticks = saturatingAdd(body_ticks, sequence[i]->getTotalTicks());
+    }
+  }
 
-  bool execute(MotorController &motor) override {
+  bool execute(MotorController &motor) {
     if (isComplete()) {
       return false;
     }
 
-    DEBUG_PRINT("Executing LoopMovement | Iteration: %u/%u | Movement: %lu/%lu",
-                current_iteration + 1, iterations, current_index + 1,
-                sequence_length);
-
-    DEBUG_PRINT("Executing Loop SubMovement: %lu/%lu", current_index + 1,
-                sequence_length);
-    sequence[current_index]->print();
     bool result = sequence[current_index]->execute(motor);
     if (!result) {
       advanceToNextMovement();
@@ -31,13 +30,80 @@ public:
     return !isComplete();
   }
 
-  bool isComplete() const override {
+  bool isComplete() const {
     return (iterations > 0 && current_iteration >= iterations) ||
            (duration > 0 && elapsed_time >= duration);
   }
 
-  void reset() override {
-    DEBUG_PRINT("Resetting LoopMovement");
+  uint32_t getTotalTicks() const {
+    uint32_t total = UNBOUNDED_DURATION;
+    if (iterations > 0 && body_ticks != UNBOUNDED_DURATION) {
+      total = body_ticks <= UNBOUNDED_DURATION / iterations
+                  ? body_ticks * iterations
+                  : UNBOUNDED_DURATION;
+    }
+    if (duration > 0 && duration < total) {
+      total = duration;
+    }
+    return total;
+  }
+
+  uint32_t advance(uint32_t ticks, MotorController &motor) {
+    if (ticks == 0) {
+      return 0;
+    }
+    if (isComplete()) {
+      return 1;
+    }
+
+    uint32_t budget = ticks;
+    if (duration > 0 && duration - elapsed_time < budget) {
+      budget = duration - elapsed_time;
+    }
+
+    uint32_t consumed = 0;
+    while (consumed < budget && !isComplete()) {
+      // At the start of an iteration, skip whole iterations arithmetically.
+      // The last one is still walked so the motor sees its final command.
+      if (current_index == 0 && sequence[0]->timeElapsed() == 0 &&
+          body_ticks != UNBOUNDED_DURATION) {
+        uint32_t skip = (budget - consumed) / body_ticks;
+        if (iterations > 0 && iterations - current_iteration < skip) {
+          skip = iterations - current_iteration;
+        }
+        if (skip > 1) {
+          skip--;
+          current_iteration += skip;
+          consumed += skip * body_ticks;
+          elapsed_time += skip * body_ticks;
+          continue;
+        }
+      }
+
+      uint32_t step =
+          sequence[current_index]->advance(budget - consumed, motor);
+      consumed += step;
+      elapsed_time += step;
+      if (sequence[current_index]->isComplete()) {
+        advanceToNextMovement();
+      }
+    }
+    return consumed;
+  }
+
+  uint32_t nextEventIn() const {
+    if (elapsed_time == 0 || isComplete()) {
+      return 1;
+    }
+
+    uint32_t next = sequence[current_index]->nextEventIn();
+    if (duration > 0 && duration - elapsed_time + 1 < next) {
+      next = duration - elapsed_time + 1;
+    }
+    return next;
+  }
+
+  void reset() {
     elapsed_time = 0;
     current_iteration = 0;
     current_index = 0;
@@ -46,7 +112,29 @@ public:
     }
   }
 
-  void print() const override {
+  // Iterations to run, 0 if only max_duration ends the loop
+  uint32_t getIterations() const { return iterations; }
+  void setIterations(uint32_t iterations) { this->iterations = iterations; }
+
+  uint32_t getIteration() const { return current_iteration; }
+  size_t getCurrentIndex() const { return current_index; }
+  AgitationMovement *getCurrent() const { return sequence[current_index]; }
+
+  /**
+   * @brief Continue a loop just reset at body movement `index` of iteration
+   * `iteration`; the caller restores that movement itself
+   * @return False if the body has no such movement
+   */
+  bool restore(uint32_t iteration, size_t index) {
+    if (index >= sequence_length) {
+      return false;
+    }
+    current_iteration = iteration;
+    current_index = static_cast<uint16_t>(index);
+    return true;
+  }
+
+  void print() const {
     DEBUG_PRINT("LoopMovement | Iteration: %u/%u | Duration: %u ticks | "
                 "Elapsed: %u | Remaining: %u",
                 current_iteration, iterations, duration, elapsed_time,
@@ -55,7 +143,7 @@ public:
     DEBUG_PRINT("Sequence:");
     for (size_t i = 0; i < sequence_length; i++) {
       if (sequence[i]) {
-        DEBUG_PRINT("%s[%lu]%s ", i == current_index ? ">" : " ", i,
+        DEBUG_PRINT("%s[%zu]%s ", i == current_index ? ">" : " ", i,
                     i == current_index ? "<" : " ");
         sequence[i]->print();
       }
@@ -63,9 +151,11 @@ public:
   }
 
 private:
+  static uint32_t saturatingAdd(uint32_t a, uint32_t b) {
+    return a > UNBOUNDED_DURATION - b ? UNBOUNDED_DURATION : a + b;
+  }
+
   void advanceToNextMovement() {
-    DEBUG_PRINT("Advancing loop to next movement: %lu/%lu", current_index + 1,
-                sequence_length);
     current_index++;
     if (current_index >= sequence_length) {
       current_index = 0;
@@ -73,12 +163,17 @@ private:
     }
     if (current_index < sequence_length) {
       sequence[current_index]->reset();
+      TRACE_EVENT(LoopNext,
+                  static_cast<uint32_t>(sequence[current_index]->getType()),
+                  current_index, current_iteration);
     }
   }
 
   AgitationMovement **sequence;
-  size_t sequence_length;
   uint32_t iterations;
   uint32_t current_iteration;
-  size_t current_index;
+  uint32_t body_ticks; // Ticks per iteration, UNBOUNDED_DURATION if unknown
+  // At most MovementLoader::MAX_SEQUENCE_LENGTH
+  uint16_t sequence_length;
+  uint16_t current_index;
 };
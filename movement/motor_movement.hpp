@@ -11,17 +11,11 @@ public:
         }
     }
 
-    bool execute(MotorController& motor) override {
+    bool execute(MotorController& motor) {
         if(elapsed_time >= duration) {
             return false;
         }
 
-        DEBUG_PRINT(
-            "Executing MotorMovement: %s | Elapsed: %u/%u",
-            type == Type::CW ? "CW" : "CCW",
-            elapsed_time + 1,
-            duration);
-
         if(type == Type::CW) {
             motor.clockwise(true);
         } else {
@@ -37,15 +31,28 @@ public:
         return true;
     }
 
-    bool isComplete() const override {
+    uint32_t advance(uint32_t ticks, MotorController& motor) {
+        bool was_complete = isComplete();
+        uint32_t consumed = advanceElapsed(ticks);
+        if(consumed > 0 && !was_complete) {
+            if(type == Type::CW) {
+                motor.clockwise(true);
+            } else {
+                motor.counterClockwise(true);
+            }
+        }
+        return consumed;
+    }
+
+    bool isComplete() const {
         return elapsed_time >= duration;
     }
 
-    void reset() override {
+    void reset() {
         elapsed_time = 0;
     }
 
-    void print() const override {
+    void print() const {
         DEBUG_PRINT(
             "MotorMovement: %s | Duration: %u ticks | Elapsed: %u | Remaining: %u",
             type == Type::CW ? "CW" : "CCW",
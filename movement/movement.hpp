@@ -3,30 +3,104 @@
 #include "../motor_controller.hpp"
 #include <cstdint>
 
+/**
+ * @brief Base of the closed set of movement types
+ * There are no virtual functions: the calls below switch on the type tag and
+ * forward to MotorMovement, PauseMovement, WaitUserMovement or LoopMovement,
+ * which hide them with their own implementation. Movements carry no vptr and
+ * a tick makes no indirect calls. The dispatch is defined in
+ * movement_dispatch.hpp, once all the types are complete.
+ *
+ * A step runs as a tree of these, not as a flat instruction stream: cursors,
+ * advanceBy() and the peephole pass of MovementLoader all work on a
+ * movement's place in the tree. The compact form of a process is the image
+ * from process_compile, which loads into the same tree.
+ */
 class AgitationMovement {
 public:
-  enum class Type { CW, CCW, Pause, Loop, WaitUser };
+  enum class Type : uint8_t { CW, CCW, Pause, Loop, WaitUser };
 
   explicit AgitationMovement(Type type, uint32_t duration = 0)
       : type(type), duration(duration) {}
 
-  virtual ~AgitationMovement() = default;
-
-  virtual bool execute(MotorController &motor) = 0;
-  virtual bool isComplete() const = 0;
-  virtual void reset() = 0;
-  virtual void print() const = 0;
+  inline bool execute(MotorController &motor);
+  inline bool isComplete() const;
+  inline void reset();
+  inline void print() const;
 
   Type getType() const { return type; }
-  virtual uint32_t getDuration() const { return duration; }
+  uint32_t getDuration() const { return duration; }
+
+  // Only for movements not started yet, as MovementLoader merges them
+  void setDuration(uint32_t duration) { this->duration = duration; }
+
+  uint32_t timeElapsed() const { return elapsed_time; }
 
-  virtual uint32_t timeElapsed() const { return elapsed_time; }
-  virtual uint32_t timeRemaining() const {
+  // Puts a movement just reset back to `elapsed` ticks in, to continue a
+  // run saved with AgitationProcessInterpreter::saveCursor()
+  void restoreElapsed(uint32_t elapsed) { elapsed_time = elapsed; }
+  uint32_t timeRemaining() const {
     return duration > elapsed_time ? duration - elapsed_time : 0;
   }
 
+  // Returned by nextEventIn() when only user input can move things forward
+  static constexpr uint32_t NO_PENDING_EVENT = UINT32_MAX;
+
+  // Returned by getTotalTicks() for movements that never end on their own
+  static constexpr uint32_t UNBOUNDED_DURATION = UINT32_MAX;
+
+  /**
+   * @brief Ticks this movement takes from reset to completion
+   * Every movement takes at least one tick, even with a zero duration.
+   */
+  inline uint32_t getTotalTicks() const;
+
+  /**
+   * @brief Fast-forward a number of ticks
+   * Has the same effect as calling execute() up to `ticks` times, stopping
+   * after the call that completes the movement, but sends the motor at most
+   * one command per movement passed. Pass a MotorCommandLatch to keep only
+   * the final command.
+   * @return Number of ticks consumed
+   */
+  inline uint32_t advance(uint32_t ticks, MotorController &motor);
+
+  /**
+   * @brief Ticks until the next tick that changes what this movement does
+   * The ticks before it only repeat the current motor command, so a caller
+   * may sleep through them and run them in one batch.
+   */
+  inline uint32_t nextEventIn() const;
+
 protected:
+  // getTotalTicks() and nextEventIn() of movements that simply run out
+  // their duration
+  uint32_t leafTotalTicks() const { return duration > 0 ? duration : 1; }
+  uint32_t leafNextEventIn() const {
+    if (elapsed_time == 0 || elapsed_time >= duration) {
+      return 1;
+    }
+    return duration - elapsed_time + 1;
+  }
+
+  // Moves elapsed_time forward by up to `ticks` for movements that simply
+  // run out their duration. Returns the ticks execute() would have taken.
+  uint32_t advanceElapsed(uint32_t ticks) {
+    if (ticks == 0) {
+      return 0;
+    }
+    if (elapsed_time >= duration) {
+      // execute() would return false straight away
+      return 1;
+    }
+    uint32_t consumed = duration - elapsed_time < ticks
+                            ? duration - elapsed_time
+                            : ticks;
+    elapsed_time += consumed;
+    return consumed;
+  }
+
   Type type;
-  uint32_t duration;
+  uint32_t duration; // In ticks of AGITATION_TICK_MS
   uint32_t elapsed_time{0};
 };
\ No newline at end of file
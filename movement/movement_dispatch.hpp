@@ -0,0 +1,113 @@
+#pragma once
+#include "loop_movement.hpp"
+#include "motor_movement.hpp"
+#include "movement.hpp"
+#include "pause_movement.hpp"
+#include "wait_user_movement.hpp"
+
+// Type-switched dispatch of AgitationMovement. Each case calls the function
+// of the concrete type, which is resolved statically and usually inlined.
+
+inline bool AgitationMovement::execute(MotorController &motor) {
+  switch (type) {
+  case Type::CW:
+  case Type::CCW:
+    return static_cast<MotorMovement *>(this)->execute(motor);
+  case Type::Pause:
+    return static_cast<PauseMovement *>(this)->execute(motor);
+  case Type::Loop:
+    return static_cast<LoopMovement *>(this)->execute(motor);
+  case Type::WaitUser:
+    return static_cast<WaitUserMovement *>(this)->execute(motor);
+  }
+  return false;
+}
+
+inline bool AgitationMovement::isComplete() const {
+  switch (type) {
+  case Type::CW:
+  case Type::CCW:
+    return static_cast<const MotorMovement *>(this)->isComplete();
+  case Type::Pause:
+    return static_cast<const PauseMovement *>(this)->isComplete();
+  case Type::Loop:
+    return static_cast<const LoopMovement *>(this)->isComplete();
+  case Type::WaitUser:
+    return static_cast<const WaitUserMovement *>(this)->isComplete();
+  }
+  return true;
+}
+
+inline void AgitationMovement::reset() {
+  switch (type) {
+  case Type::CW:
+  case Type::CCW:
+    static_cast<MotorMovement *>(this)->reset();
+    break;
+  case Type::Pause:
+    static_cast<PauseMovement *>(this)->reset();
+    break;
+  case Type::Loop:
+    static_cast<LoopMovement *>(this)->reset();
+    break;
+  case Type::WaitUser:
+    static_cast<WaitUserMovement *>(this)->reset();
+    break;
+  }
+}
+
+inline void AgitationMovement::print() const {
+  switch (type) {
+  case Type::CW:
+  case Type::CCW:
+    static_cast<const MotorMovement *>(this)->print();
+    break;
+  case Type::Pause:
+    static_cast<const PauseMovement *>(this)->print();
+    break;
+  case Type::Loop:
+    static_cast<const LoopMovement *>(this)->print();
+    break;
+  case Type::WaitUser:
+    static_cast<const WaitUserMovement *>(this)->print();
+    break;
+  }
+}
+
+inline uint32_t AgitationMovement::getTotalTicks() const {
+  switch (type) {
+  case Type::Loop:
+    return static_cast<const LoopMovement *>(this)->getTotalTicks();
+  case Type::WaitUser:
+    return static_cast<const WaitUserMovement *>(this)->getTotalTicks();
+  default:
+    return leafTotalTicks();
+  }
+}
+
+inline uint32_t AgitationMovement::advance(uint32_t ticks,
+                                           MotorController &motor) {
+  switch (type) {
+  case Type::CW:
+  case Type::CCW:
+    return static_cast<MotorMovement *>(this)->advance(ticks, motor);
+  case Type::Pause:
+    return static_cast<PauseMovement *>(this)->advance(ticks, motor);
+  case Type::Loop:
+    return static_cast<LoopMovement *>(this)->advance(ticks, motor);
+  case Type::WaitUser:
+    return static_cast<WaitUserMovement *>(this)->advance(ticks, motor);
+  }
+  return 0;
+}
+
+inline uint32_t AgitationMovement::nextEventIn() const {
+  switch (type) {
+  case Type::Loop:
+    return static_cast<const LoopMovement *>(this)->nextEventIn();
+  case Type::WaitUser:
+    return static_cast<const WaitUserMovement *>(this)->nextEventIn();
+  default:
+    return leafNextEventIn();
+  }
+}
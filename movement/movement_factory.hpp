@@ -2,72 +2,141 @@
 #include "loop_movement.hpp"
 #include "motor_movement.hpp"
 #include "movement.hpp"
+#include "movement_dispatch.hpp"
 #include "pause_movement.hpp"
 #include "wait_user_movement.hpp"
 #include <array>
 #include <new>
 
+// Every pool allocation is rounded up to this alignment, so all movement
+// types stay aligned however they are mixed
+constexpr size_t MOVEMENT_ALIGNMENT = alignof(LoopMovement);
+constexpr size_t movement_aligned_size(size_t size) {
+  return (size + MOVEMENT_ALIGNMENT - 1) / MOVEMENT_ALIGNMENT *
+         MOVEMENT_ALIGNMENT;
+}
+
+// All durations passed to the factory are in interpreter ticks
+// (AGITATION_TICK_MS each), already converted from the static tables.
+//
+// Movements are bump-allocated from a pool owned by the factory instance.
+// Callers scope allocations with mark()/release(), e.g. one step at a time,
+// so memory use stays constant however many steps or restarts a process
+// goes through. A step's movements, and the child lists of its loops, end up
+// next to each other in the pool.
 class MovementFactory {
 public:
   static constexpr size_t MAX_MOVEMENTS = 64;
   static constexpr size_t MAX_SEQUENCE_LENGTH = 12;
 
-  static size_t getAvailableSpace() {
+  // Pool bytes taken by each kind of movement
+  static constexpr size_t MOTOR_BYTES =
+      movement_aligned_size(sizeof(MotorMovement));
+  static constexpr size_t PAUSE_BYTES =
+      movement_aligned_size(sizeof(PauseMovement));
+  static constexpr size_t WAIT_USER_BYTES =
+      movement_aligned_size(sizeof(WaitUserMovement));
+  static constexpr size_t loopBytes(size_t sequence_length) {
+    return movement_aligned_size(sizeof(AgitationMovement *) *
+                                 sequence_length) +
+           movement_aligned_size(sizeof(LoopMovement));
+  }
+
+  static constexpr size_t POOL_SIZE = MAX_MOVEMENTS * MOTOR_BYTES;
+
+  using Mark = size_t;
+
+  MovementFactory() = default;
+  MovementFactory(const MovementFactory &) = delete;
+  MovementFactory &operator=(const MovementFactory &) = delete;
+
+  size_t getAvailableSpace() const {
     return movement_pool.size() - current_pool_index;
   }
 
-  static bool canAllocate(size_t size) {
+  bool canAllocate(size_t size) const {
     return (current_pool_index + size <= movement_pool.size());
   }
 
-  static AgitationMovement *createCW(uint32_t duration) {
-    if (!canAllocate(sizeof(MotorMovement))) {
-      DEBUG_PRINT("Cannot allocate CW movement, need %zu bytes, have %zu",
-                  sizeof(MotorMovement), getAvailableSpace());
+  // Current allocation position, to hand back to release() later
+  Mark mark() const { return current_pool_index; }
+
+  // Frees everything allocated since `position` was taken. Movements created
+  // after it must not be used anymore.
+  void release(Mark position) {
+    rewind(position);
+    exhausted = false;
+  }
+
+  // Like release(), but a failed allocation stays reported, for callers that
+  // give back part of a load that is still going on
+  void rewind(Mark position) {
+    if (position < current_pool_index) {
+      current_pool_index = position;
+    }
+  }
+
+  size_t getUsed() const { return current_pool_index; }
+  size_t getHighWaterMark() const { return high_water_mark; }
+
+  // Set when an allocation did not fit; sticks until the next release()
+  bool isExhausted() const { return exhausted; }
+
+  AgitationMovement *createCW(uint32_t duration) {
+    if (!canAllocate(MOTOR_BYTES)) {
+      TRACE_EVENT(PoolExhausted,
+                  static_cast<uint32_t>(AgitationMovement::Type::CW),
+                  MOTOR_BYTES, getAvailableSpace());
+      exhausted = true;
       return nullptr;
     }
-    void *ptr = allocateMovement(sizeof(MotorMovement));
+    void *ptr = allocateMovement(MOTOR_BYTES);
     if (!ptr)
       return nullptr;
     return new (ptr) MotorMovement(AgitationMovement::Type::CW, duration);
   }
 
-  static AgitationMovement *createCCW(uint32_t duration) {
-    if (!canAllocate(sizeof(MotorMovement))) {
-      DEBUG_PRINT("Cannot allocate CCW movement, need %zu bytes, have %zu",
-                  sizeof(MotorMovement), getAvailableSpace());
+  AgitationMovement *createCCW(uint32_t duration) {
+    if (!canAllocate(MOTOR_BYTES)) {
+      TRACE_EVENT(PoolExhausted,
+                  static_cast<uint32_t>(AgitationMovement::Type::CCW),
+                  MOTOR_BYTES, getAvailableSpace());
+      exhausted = true;
       return nullptr;
     }
-    void *ptr = allocateMovement(sizeof(MotorMovement));
+    void *ptr = allocateMovement(MOTOR_BYTES);
     if (!ptr)
       return nullptr;
     return new (ptr) MotorMovement(AgitationMovement::Type::CCW, duration);
   }
 
-  static AgitationMovement *createPause(uint32_t duration) {
-    if (!canAllocate(sizeof(PauseMovement))) {
-      DEBUG_PRINT("Cannot allocate Pause movement, need %zu bytes, have %zu",
-                  sizeof(PauseMovement), getAvailableSpace());
+  AgitationMovement *createPause(uint32_t duration) {
+    if (!canAllocate(PAUSE_BYTES)) {
+      TRACE_EVENT(PoolExhausted,
+                  static_cast<uint32_t>(AgitationMovement::Type::Pause),
+                  PAUSE_BYTES, getAvailableSpace());
+      exhausted = true;
       return nullptr;
     }
-    void *ptr = allocateMovement(sizeof(PauseMovement));
+    void *ptr = allocateMovement(PAUSE_BYTES);
     if (!ptr)
       return nullptr;
     return new (ptr) PauseMovement(duration);
   }
 
-  static AgitationMovement *createLoop(const AgitationMovement **sequence,
-                                       size_t sequence_length,
-                                       uint32_t iterations,
-                                       uint32_t max_duration) {
+  AgitationMovement *createLoop(const AgitationMovement **sequence,
+                                size_t sequence_length, uint32_t iterations,
+                                uint32_t max_duration) {
     size_t sequence_storage_size =
-        sizeof(AgitationMovement *) * sequence_length;
-    size_t loop_movement_size = sizeof(LoopMovement);
-    size_t total_size = sequence_storage_size + loop_movement_size;
+        movement_aligned_size(sizeof(AgitationMovement *) * sequence_length);
+    size_t loop_movement_size = movement_aligned_size(sizeof(LoopMovement));
+    size_t total_size = loopBytes(sequence_length);
 
     if (!canAllocate(total_size)) {
-      DEBUG_PRINT("Cannot allocate Loop movement, need %zu bytes, have %zu",
+      TRACE_EVENT(PoolExhausted,
+                  static_cast<uint32_t>(AgitationMovement::Type::Loop),
                   total_size, getAvailableSpace());
+      exhausted = true;
       return nullptr;
     }
 
@@ -93,43 +162,58 @@ public:
                                        iterations, max_duration);
   }
 
-  static AgitationMovement *createWaitUser() {
-    if (!canAllocate(sizeof(WaitUserMovement))) {
-      DEBUG_PRINT("Cannot allocate WaitUser movement, need %zu bytes, have %zu",
-                  sizeof(WaitUserMovement), getAvailableSpace());
+  AgitationMovement *createWaitUser() {
+    if (!canAllocate(WAIT_USER_BYTES)) {
+      TRACE_EVENT(PoolExhausted,
+                  static_cast<uint32_t>(AgitationMovement::Type::WaitUser),
+                  WAIT_USER_BYTES, getAvailableSpace());
+      exhausted = true;
       return nullptr;
     }
-    void *ptr = allocateMovement(sizeof(WaitUserMovement));
+    void *ptr = allocateMovement(WAIT_USER_BYTES);
     if (!ptr)
       return nullptr;
     return new (ptr) WaitUserMovement();
   }
 
-  static void reset() {
-    current_pool_index = 0;
+  void reset() {
+    release(0);
     DEBUG_PRINT("Movement factory reset, %zu bytes available",
                 movement_pool.size());
   }
 
-  static void printPoolStats() {
-    DEBUG_PRINT("Movement pool: %zu/%zu bytes used (%zu%% full)",
+  void printPoolStats() const {
+    DEBUG_PRINT("Movement pool: %zu/%zu bytes used (%zu%% full), high water "
+                "mark %zu",
                 current_pool_index, movement_pool.size(),
-                (current_pool_index * 100) / movement_pool.size());
+                (current_pool_index * 100) / movement_pool.size(),
+                high_water_mark);
   }
 
 private:
-  static void *allocateMovement(size_t size) {
+  void *allocateMovement(size_t size) {
     if (current_pool_index + size > movement_pool.size()) {
       DEBUG_PRINT("Movement pool overflow: needed %zu bytes, %zu available",
                   size, movement_pool.size() - current_pool_index);
+      exhausted = true;
       return nullptr;
     }
     void *ptr = &movement_pool[current_pool_index];
     current_pool_index += size;
+    if (current_pool_index > high_water_mark) {
+      high_water_mark = current_pool_index;
+    }
     return ptr;
   }
 
-  static inline std::array<uint8_t, MAX_MOVEMENTS * sizeof(AgitationMovement)>
-      movement_pool;
-  static inline size_t current_pool_index = 0;
+  static_assert(MOVEMENT_ALIGNMENT >= alignof(MotorMovement) &&
+                    MOVEMENT_ALIGNMENT >= alignof(PauseMovement) &&
+                    MOVEMENT_ALIGNMENT >= alignof(WaitUserMovement) &&
+                    MOVEMENT_ALIGNMENT >= alignof(AgitationMovement *),
+                "MOVEMENT_ALIGNMENT must suit every movement type");
+
+  alignas(MOVEMENT_ALIGNMENT) std::array<uint8_t, POOL_SIZE> movement_pool;
+  size_t current_pool_index{0};
+  size_t high_water_mark{0};
+  bool exhausted{false};
 };
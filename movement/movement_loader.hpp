@@ -9,12 +9,35 @@ public:
   // Maximum number of movements in a sequence
   static constexpr size_t MAX_SEQUENCE_LENGTH = 32;
 
+  // Deepest loop nesting that fits the app stack; every level of
+  // loadMovement() keeps a MAX_SEQUENCE_LENGTH array of pointers on it
+  static constexpr size_t MAX_NESTING_DEPTH = 4;
+
   /**
    * @brief Construct a MovementLoader with a movement factory
    * @param factory The factory to use for creating movements
    */
   explicit MovementLoader(MovementFactory &factory) : factory_(factory) {}
 
+  /**
+   * @brief Turn the peephole pass on or off, e.g. to compare against the
+   * tables loaded one to one
+   *
+   * While loading, the pass rewrites what it is about to create, so the
+   * motor sees exactly the same commands on exactly the same ticks:
+   * - adjacent CW, CCW or pause movements of the same type are merged
+   * - a loop that runs its body once is replaced by the body
+   * - a loop body that repeats a shorter run of movements keeps only that
+   *   run, with the count multiplied
+   * - a loop around a single movement becomes that movement, lengthened, or
+   *   for a single loop with a count, that loop with the counts multiplied
+   * Movements of zero ticks still take a tick without a motor command, so
+   * they are left alone. The result never takes more pool than the tables
+   * loaded one to one, which is what SequenceAnalysis computes.
+   */
+  void setOptimize(bool optimize) { optimize_ = optimize; }
+  bool getOptimize() const { return optimize_; }
+
   /**
    * @brief Load a sequence of movements from static declarations
    * @param static_sequence Array of static movement declarations
@@ -24,92 +47,290 @@ public:
    */
   size_t loadSequence(const AgitationMovementStatic *static_sequence,
                       size_t sequence_length, AgitationMovement *sequence[]) {
-    TRACE_PRINT("Loading sequence with length: %zu", sequence_length);
+    return loadSequence(
+        AgitationSequenceView(static_sequence, sequence_length), sequence);
+  }
 
+  /**
+   * @brief Load a sequence of movements from static tables or a compiled
+   * process image
+   */
+  size_t loadSequence(const AgitationSequenceView &source,
+                      AgitationMovement *sequence[]) {
     size_t loaded_length = 0;
+    appendSequence(source, sequence, loaded_length);
+    return loaded_length;
+  }
+
+private:
+  MovementFactory &factory_;
+  bool optimize_{true};
+
+  // Loads the movements of `source` after the `length` already in `sequence`,
+  // keeping `reserved` entries free for movements still to come after it
+  void appendSequence(const AgitationSequenceView &source,
+                      AgitationMovement *sequence[], size_t &length,
+                      size_t reserved = 0) {
+    size_t start = length;
+    size_t source_length = source.getLength() < MAX_SEQUENCE_LENGTH
+                               ? source.getLength()
+                               : MAX_SEQUENCE_LENGTH;
+    for (size_t i = 0; i < source_length; i++) {
+      appendMovement(source, i, sequence, length,
+                     reserved + source_length - i - 1);
+    }
+
+    TRACE_EVENT(SequenceLoaded, 0, source.getLength(), length - start);
+  }
+
+  static bool isLeaf(AgitationMovementType type) {
+    return type == AgitationMovementTypeCW ||
+           type == AgitationMovementTypeCCW ||
+           type == AgitationMovementTypePause;
+  }
+
+  static_assert(static_cast<int>(AgitationMovement::Type::CW) ==
+                        AgitationMovementTypeCW &&
+                    static_cast<int>(AgitationMovement::Type::CCW) ==
+                        AgitationMovementTypeCCW &&
+                    static_cast<int>(AgitationMovement::Type::Pause) ==
+                        AgitationMovementTypePause,
+                "Leaf movement types convert as they are");
+
+  static bool isLeaf(AgitationMovement::Type type) {
+    return type == AgitationMovement::Type::CW ||
+           type == AgitationMovement::Type::CCW ||
+           type == AgitationMovement::Type::Pause;
+  }
+
+  /**
+   * @brief Lengthen the last movement of `sequence` by `ticks` if it is of
+   * the same type, so no new one is needed
+   */
+  bool mergeWithLast(AgitationMovement *sequence[], size_t length,
+                     AgitationMovement::Type type, uint32_t ticks) {
+    if (!optimize_ || length == 0 || ticks == 0 || !isLeaf(type)) {
+      return false;
+    }
+    AgitationMovement *last = sequence[length - 1];
+    uint32_t duration = last->getDuration();
+    if (last->getType() != type || duration == 0 ||
+        duration >= AgitationMovement::UNBOUNDED_DURATION - ticks) {
+      return false;
+    }
+    last->setDuration(duration + ticks);
+    return true;
+  }
 
-    for (size_t i = 0; i < sequence_length && i < MAX_SEQUENCE_LENGTH; i++) {
-      TRACE_PRINT("Loading movement %zu", i);
-      sequence[loaded_length] = loadMovement(static_sequence[i]);
-      if (sequence[loaded_length]) {
-        TRACE_PRINT("Loaded movement %zu", loaded_length);
-        loaded_length++;
+  // The interpreter handles a wait for the user in a step's own sequence
+  // apart from one in a loop, so such a body is not moved out of its loop
+  static bool waitsForUser(const AgitationSequenceView &body) {
+    for (size_t i = 0; i < body.getLength() && i < MAX_SEQUENCE_LENGTH; i++) {
+      if (body.getType(i) == AgitationMovementTypeWaitUser) {
+        return true;
       }
     }
+    return false;
+  }
 
-    TRACE_PRINT("Loaded sequence length: %zu", loaded_length);
-    TRACE_PRINT("");
+  /**
+   * @brief Length of the shortest run of movements `body` repeats, its whole
+   * length if none. Only bodies of CW, CCW and pause movements are looked at.
+   */
+  static size_t repeatedRun(const AgitationSequenceView &body) {
+    size_t length = body.getLength();
+    if (length > MAX_SEQUENCE_LENGTH) {
+      return length;
+    }
+    for (size_t i = 0; i < length; i++) {
+      if (!isLeaf(body.getType(i))) {
+        return length;
+      }
+    }
+    for (size_t run = 1; run < length; run++) {
+      if (length % run != 0) {
+        continue;
+      }
+      bool repeats = true;
+      for (size_t i = run; i < length && repeats; i++) {
+        repeats = body.getType(i) == body.getType(i - run) &&
+                  agitation_duration_to_ticks(body.getDuration(i)) ==
+                      agitation_duration_to_ticks(body.getDuration(i - run));
+      }
+      if (repeats) {
+        return run;
+      }
+    }
+    return length;
+  }
 
-    return loaded_length;
+  /**
+   * @brief Load movement `i` of `source` onto the end of `sequence`
+   *
+   * Every movement takes at most one entry, except a loop unwrapped into
+   * its body, which is only done while the body still leaves `reserved`
+   * entries for the movements after it. So a sequence whose source fits
+   * never outgrows MAX_SEQUENCE_LENGTH, however the pass rewrites it.
+   */
+  void appendMovement(const AgitationSequenceView &source, size_t i,
+                      AgitationMovement *sequence[], size_t &length,
+                      size_t reserved) {
+    AgitationMovementType type = source.getType(i);
+    if (isLeaf(type)) {
+      uint32_t ticks = agitation_duration_to_ticks(source.getDuration(i));
+      if (mergeWithLast(sequence, length,
+                        static_cast<AgitationMovement::Type>(type), ticks)) {
+        return;
+      }
+    }
+    if (type != AgitationMovementTypeLoop) {
+      AgitationMovement *movement = loadMovement(source, i);
+      if (movement) {
+        sequence[length++] = movement;
+      }
+      return;
+    }
+
+    AgitationSequenceView body = source.getLoopBody(i);
+    uint32_t count = source.getLoopCount(i);
+    uint32_t max_duration =
+        agitation_duration_to_ticks(source.getLoopMaxDuration(i));
+    if (optimize_ && count == 1 && max_duration == 0 &&
+        length + reserved <= MAX_SEQUENCE_LENGTH &&
+        body.getLength() <= MAX_SEQUENCE_LENGTH - length - reserved &&
+        !waitsForUser(body)) {
+      appendSequence(body, sequence, length, reserved);
+      return;
+    }
+    if (optimize_) {
+      size_t run = repeatedRun(body);
+      uint32_t repeats = static_cast<uint32_t>(body.getLength() / run);
+      if (run < body.getLength() &&
+          count <= AgitationMovement::UNBOUNDED_DURATION / repeats) {
+        body = body.prefix(run);
+        count *= repeats;
+      }
+    }
+
+    // Create temporary array for inner sequence
+    MovementFactory::Mark mark = factory_.mark();
+    AgitationMovement *inner_sequence[MAX_SEQUENCE_LENGTH];
+
+    // Load the inner sequence
+    size_t inner_length = 0;
+    appendSequence(body, inner_sequence, inner_length);
+
+    if (inner_length == 0) {
+      return;
+    }
+    if (optimize_ && inner_length == 1 &&
+        collapseLoop(inner_sequence[0], count, max_duration)) {
+      AgitationMovement *single = inner_sequence[0];
+      // The single movement is all the body allocated, so it can go again.
+      // Whatever did not fit before stays reported, so the step is rejected.
+      if (mergeWithLast(sequence, length, single->getType(),
+                        single->getDuration())) {
+        factory_.rewind(mark);
+      } else {
+        sequence[length++] = single;
+      }
+      return;
+    }
+
+    // Create the loop movement
+    AgitationMovement *result = factory_.createLoop(
+        const_cast<const AgitationMovement **>(inner_sequence), inner_length,
+        count, max_duration);
+    if (result) {
+      sequence[length++] = result;
+    } else {
+      TRACE_EVENT(LoadFailed, type);
+    }
   }
 
-private:
-  MovementFactory &factory_;
+  /**
+   * @brief Make the only movement of a loop body do what the loop would
+   * @return False if it cannot, and the loop has to stay
+   */
+  static bool collapseLoop(AgitationMovement *single, uint32_t count,
+                           uint32_t max_duration) {
+    if (isLeaf(single->getType())) {
+      uint32_t duration = single->getDuration();
+      if (duration == 0) {
+        return false;
+      }
+      uint32_t total = AgitationMovement::UNBOUNDED_DURATION;
+      if (count > 0 &&
+          duration < AgitationMovement::UNBOUNDED_DURATION / count) {
+        total = duration * count;
+      }
+      if (max_duration > 0 && max_duration < total) {
+        total = max_duration;
+      }
+      if (total == AgitationMovement::UNBOUNDED_DURATION) {
+        return false;
+      }
+      single->setDuration(total);
+      return true;
+    }
+
+    if (single->getType() != AgitationMovement::Type::Loop) {
+      return false;
+    }
+    // An inner loop with a count and no time limit, repeated `count` times
+    // or until max_duration cuts it off
+    LoopMovement *loop = static_cast<LoopMovement *>(single);
+    uint32_t iterations = loop->getIterations();
+    if (iterations == 0 || loop->getDuration() != 0 ||
+        (count > 0 &&
+         iterations > AgitationMovement::UNBOUNDED_DURATION / count)) {
+      return false;
+    }
+    loop->setIterations(count > 0 ? iterations * count : 0);
+    loop->setDuration(max_duration);
+    return true;
+  }
 
   /**
-   * @brief Load a single movement from static declaration
+   * @brief Create movement `i` of a sequence, which is no loop
    */
-  AgitationMovement *
-  loadMovement(const AgitationMovementStatic &static_movement) {
+  AgitationMovement *loadMovement(const AgitationSequenceView &source,
+                                  size_t i) {
     AgitationMovement *result = nullptr;
+    AgitationMovementType type = source.getType(i);
 
-    switch (static_movement.type) {
+    switch (type) {
     case AgitationMovementTypeCW:
-      TRACE_PRINT("Creating CW movement with duration: %u",
-                  static_movement.duration);
-      result = factory_.createCW(static_movement.duration);
+      result =
+          factory_.createCW(agitation_duration_to_ticks(source.getDuration(i)));
       break;
 
     case AgitationMovementTypeCCW:
-      TRACE_PRINT("Creating CCW movement with duration: %u",
-                  static_movement.duration);
-      result = factory_.createCCW(static_movement.duration);
+      result = factory_.createCCW(
+          agitation_duration_to_ticks(source.getDuration(i)));
       break;
 
     case AgitationMovementTypePause:
-      TRACE_PRINT("Creating pause movement with duration: %u",
-                  static_movement.duration);
-      result = factory_.createPause(static_movement.duration);
+      result = factory_.createPause(
+          agitation_duration_to_ticks(source.getDuration(i)));
       break;
 
-    case AgitationMovementTypeLoop: {
-      // Create temporary array for inner sequence
-      AgitationMovement *inner_sequence[MAX_SEQUENCE_LENGTH];
-
-      // Load the inner sequence
-      TRACE_PRINT("Loading loop sequence with length: %lu",
-                  static_movement.loop.sequence_length);
-      size_t inner_length =
-          loadSequence(static_movement.loop.sequence,
-                       static_movement.loop.sequence_length, inner_sequence);
-
-      if (inner_length == 0) {
-        TRACE_PRINT("Failed to load inner sequence");
-        return nullptr;
-      }
-
-      // Create the loop movement
-      TRACE_PRINT("Creating loop movement with count: %u, max_duration: %u",
-                  static_movement.loop.count,
-                  static_movement.loop.max_duration);
-
-      result = factory_.createLoop(
-          const_cast<const AgitationMovement **>(inner_sequence), inner_length,
-          static_movement.loop.count, static_movement.loop.max_duration);
-      break;
-    }
-
     case AgitationMovementTypeWaitUser:
       result = factory_.createWaitUser();
       break;
 
     default:
-      return nullptr;
+      break;
     }
 
     if (!result) {
-      TRACE_PRINT("Failed to create movement of type %d", static_movement.type);
+      TRACE_EVENT(LoadFailed, type);
     }
     return result;
   }
-};
\ No newline at end of file
+};
+// Processes loaded from YAML are only checked against the loader limits
+static_assert(AGITATION_YAML_MAX_LOOP_DEPTH <= MovementLoader::MAX_NESTING_DEPTH &&
+                  AGITATION_YAML_MAX_SEQUENCE_LENGTH <=
+                      MovementLoader::MAX_SEQUENCE_LENGTH,
+              "YAML limits must not exceed what the loader takes");
@@ -7,9 +7,7 @@ public:
         : AgitationMovement(Type::Pause, duration) {
     }
 
-    bool execute(MotorController& motor) override {
-        DEBUG_PRINT("Executing PauseMovement | Elapsed: %u/%u", elapsed_time + 1, duration);
-
+    bool execute(MotorController& motor) {
         if(elapsed_time >= duration) {
             return false;
         }
@@ -17,23 +15,27 @@ public:
         motor.stop();
         elapsed_time++;
 
-        if(elapsed_time >= duration) {
-            DEBUG_PRINT("PauseMovement completed");
-            return false;
+        return elapsed_time < duration;
+    }
+
+    uint32_t advance(uint32_t ticks, MotorController& motor) {
+        bool was_complete = isComplete();
+        uint32_t consumed = advanceElapsed(ticks);
+        if(consumed > 0 && !was_complete) {
+            motor.stop();
         }
-        return true;
+        return consumed;
     }
 
-    bool isComplete() const override {
+    bool isComplete() const {
         return elapsed_time >= duration;
     }
 
-    void reset() override {
-        DEBUG_PRINT("Resetting PauseMovement");
+    void reset() {
         elapsed_time = 0;
     }
 
-    void print() const override {
+    void print() const {
         DEBUG_PRINT(
             "PauseMovement | Duration: %u ticks | Elapsed: %u | Remaining: %u",
             duration,
@@ -0,0 +1,193 @@
+#pragma once
+#include "../agitation_sequence.hpp"
+#include "movement.hpp"
+#include "movement_factory.hpp"
+#include "movement_loader.hpp"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief What it takes to load and run a static sequence
+ * Mirrors MovementLoader, loading one to one, and MovementFactory exactly.
+ * The loader's peephole pass only ever makes a sequence take less, so the
+ * numbers are a bound on what actually ends up in the pool.
+ */
+struct SequenceStats {
+  // Ticks to run through, AgitationMovement::UNBOUNDED_DURATION if it never
+  // ends on its own. A wait for the user in a step's own sequence counts
+  // nothing, as the interpreter stops the step clock there. One inside a
+  // loop keeps the loop from ending on its own, so the loop counts as
+  // unbounded unless its max_duration cuts it off, as
+  // LoopMovement::getTotalTicks() has it.
+  uint32_t duration;
+  // Movement objects and pool bytes the loader creates
+  size_t movements;
+  size_t pool_bytes;
+  // Longest sequence at any level, before the loader truncates it
+  size_t max_sequence_length;
+  // Loop nesting, 0 for a flat sequence
+  size_t max_depth;
+  // Movements the loader keeps at this level
+  size_t loaded_length;
+};
+
+/**
+ * @brief constexpr analysis of the static process tables
+ * Lets built-in recipes be checked against the pool and sequence limits at
+ * build time instead of failing halfway through a process.
+ */
+class SequenceAnalysis {
+public:
+  static constexpr uint32_t saturatingAdd(uint32_t a, uint32_t b) {
+    return a > AgitationMovement::UNBOUNDED_DURATION - b
+               ? AgitationMovement::UNBOUNDED_DURATION
+               : a + b;
+  }
+
+  static constexpr uint32_t saturatingMul(uint32_t a, uint32_t b) {
+    return (a != 0 && b > AgitationMovement::UNBOUNDED_DURATION / a)
+               ? AgitationMovement::UNBOUNDED_DURATION
+               : a * b;
+  }
+
+  static constexpr SequenceStats
+  analyzeSequence(const AgitationMovementStatic *sequence,
+                  size_t sequence_length) {
+    return analyzeSequence(AgitationSequenceView(sequence, sequence_length));
+  }
+
+  // `in_loop` for a loop body, where waiting for the user takes unbounded
+  // time instead of none
+  static constexpr SequenceStats
+  analyzeSequence(const AgitationSequenceView &sequence, bool in_loop = false) {
+    SequenceStats stats{0, 0, 0, sequence.getLength(), 0, 0};
+
+    for (size_t i = 0;
+         i < sequence.getLength() && i < MovementLoader::MAX_SEQUENCE_LENGTH;
+         i++) {
+      AgitationMovementType type = sequence.getType(i);
+
+      switch (type) {
+      case AgitationMovementTypeCW:
+      case AgitationMovementTypeCCW:
+      case AgitationMovementTypePause: {
+        uint32_t ticks = agitation_duration_to_ticks(sequence.getDuration(i));
+        stats.duration = saturatingAdd(stats.duration, ticks > 0 ? ticks : 1);
+        stats.movements++;
+        stats.pool_bytes += type == AgitationMovementTypePause
+                                ? MovementFactory::PAUSE_BYTES
+                                : MovementFactory::MOTOR_BYTES;
+        stats.loaded_length++;
+        break;
+      }
+
+      case AgitationMovementTypeWaitUser:
+        if (in_loop) {
+          stats.duration = AgitationMovement::UNBOUNDED_DURATION;
+        }
+        stats.movements++;
+        stats.pool_bytes += MovementFactory::WAIT_USER_BYTES;
+        stats.loaded_length++;
+        break;
+
+      case AgitationMovementTypeLoop: {
+        SequenceStats body = analyzeSequence(sequence.getLoopBody(i), true);
+        // The body is loaded even if the loop is then dropped
+        stats.movements += body.movements;
+        stats.pool_bytes += body.pool_bytes;
+        if (body.max_sequence_length > stats.max_sequence_length) {
+          stats.max_sequence_length = body.max_sequence_length;
+        }
+        if (body.max_depth + 1 > stats.max_depth) {
+          stats.max_depth = body.max_depth + 1;
+        }
+        if (body.loaded_length == 0) {
+          break;
+        }
+
+        stats.movements++;
+        stats.pool_bytes += MovementFactory::loopBytes(body.loaded_length);
+        stats.loaded_length++;
+        stats.duration =
+            saturatingAdd(stats.duration, loopDuration(sequence, i, body));
+        break;
+      }
+
+      default:
+        break;
+      }
+    }
+
+    return stats;
+  }
+
+  static constexpr SequenceStats analyzeStep(const AgitationStepStatic &step) {
+    return analyzeSequence(AgitationSequenceView::of(step));
+  }
+
+  /**
+   * @brief Totals over all steps of a process
+   * Each step replaces the previous one in the pool, so movements and pool
+   * bytes are those of the largest step. Duration adds up across steps.
+   */
+  static constexpr SequenceStats
+  analyzeProcess(const AgitationProcessStatic &process) {
+    SequenceStats total{0, 0, 0, 0, 0, 0};
+
+    for (size_t i = 0; i < process.steps_length; i++) {
+      SequenceStats step = analyzeStep(process.steps[i]);
+      total.duration = saturatingAdd(total.duration, step.duration);
+      if (step.movements > total.movements) {
+        total.movements = step.movements;
+      }
+      if (step.pool_bytes > total.pool_bytes) {
+        total.pool_bytes = step.pool_bytes;
+      }
+      total.loaded_length += step.loaded_length;
+      if (step.max_sequence_length > total.max_sequence_length) {
+        total.max_sequence_length = step.max_sequence_length;
+      }
+      if (step.max_depth > total.max_depth) {
+        total.max_depth = step.max_depth;
+      }
+    }
+
+    return total;
+  }
+
+private:
+  static constexpr uint32_t loopDuration(const AgitationSequenceView &sequence,
+                                         size_t i, const SequenceStats &body) {
+    uint32_t max_duration =
+        agitation_duration_to_ticks(sequence.getLoopMaxDuration(i));
+    uint32_t count = sequence.getLoopCount(i);
+    uint32_t total = AgitationMovement::UNBOUNDED_DURATION;
+    if (count > 0) {
+      total = saturatingMul(body.duration, count);
+    }
+    if (max_duration > 0 && max_duration < total) {
+      total = max_duration;
+    }
+    return total;
+  }
+};
+
+/**
+ * @brief Fail the build if a static process cannot be loaded completely
+ */
+#define AGITATION_VERIFY_PROCESS(process)                                      \
+  static_assert(SequenceAnalysis::analyzeProcess(process).pool_bytes <=       \
+                    MovementFactory::POOL_SIZE,                                \
+                #process " does not fit the movement pool");                   \
+  static_assert(SequenceAnalysis::analyzeProcess(process).movements <=        \
+                    MovementFactory::MAX_MOVEMENTS,                            \
+                #process " has more movements than MAX_MOVEMENTS");            \
+  static_assert(SequenceAnalysis::analyzeProcess(process)                      \
+                        .max_sequence_length <=                                \
+                    MovementFactory::MAX_SEQUENCE_LENGTH,                      \
+                #process " has a sequence longer than MAX_SEQUENCE_LENGTH");   \
+  static_assert(SequenceAnalysis::analyzeProcess(process).max_depth <=        \
+                    MovementLoader::MAX_NESTING_DEPTH,                         \
+                #process " nests loops deeper than MAX_NESTING_DEPTH");        \
+  static_assert((process).steps_length <= AGITATION_PROCESS_MAX_STEPS,         \
+                #process " has more steps than AGITATION_PROCESS_MAX_STEPS")
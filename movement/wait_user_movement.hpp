@@ -5,28 +5,51 @@ class WaitUserMovement final : public AgitationMovement {
 public:
     WaitUserMovement() : AgitationMovement(Type::WaitUser) {}
 
-    bool execute(MotorController& motor) override {
-        DEBUG_PRINT("Executing WaitUserMovement | State: %s | Elapsed: %u", 
-            user_acknowledged ? "acknowledged" : "waiting",
-            elapsed_time + 1);
-
+    bool execute(MotorController& motor) {
         motor.stop();
+        if(!user_acknowledged) {
+            elapsed_time++;
+        }
         return !user_acknowledged;
     }
 
-    bool isComplete() const override {
+    bool isComplete() const {
         return user_acknowledged;
     }
 
-    void reset() override {
+    void reset() {
+        elapsed_time = 0;
         user_acknowledged = false;
     }
 
+    uint32_t getTotalTicks() const {
+        return UNBOUNDED_DURATION;
+    }
+
+    uint32_t advance(uint32_t ticks, MotorController& motor) {
+        if(ticks == 0) {
+            return 0;
+        }
+        motor.stop();
+        if(user_acknowledged) {
+            return 1;
+        }
+        elapsed_time += ticks;
+        return ticks;
+    }
+
+    uint32_t nextEventIn() const {
+        if(elapsed_time == 0 || user_acknowledged) {
+            return 1;
+        }
+        return NO_PENDING_EVENT;
+    }
+
     void acknowledgeUser() {
         user_acknowledged = true;
     }
 
-    void print() const override {
+    void print() const {
         DEBUG_PRINT("WaitUserMovement | State: %s | Elapsed: %u", 
             user_acknowledged ? "acknowledged" : "waiting",
             elapsed_time);
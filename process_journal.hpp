@@ -0,0 +1,230 @@
+#pragma once
+#include "agitation_process_interpreter.hpp"
+#include "agitation_sequence.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Checkpoint journal: fixed-size records appended to a file while a process
+// runs, each holding where the run is as an AgitationCursor. After a crash or
+// a power loss the newest intact record says where to continue. A record is
+// written when the run reaches a new step or stops for the user, and
+// otherwise at a movement boundary once MIN_INTERVAL_MS passed, so writes
+// fall on wakeups the timer makes anyway and stay few.
+//
+// The records go to two files in turn. Once one is full the next record
+// starts the other over, so the newest record of the full one survives a
+// power loss at any point of the write.
+
+#define PROCESS_JOURNAL_MAGIC 0x4a504741u // "AGPJ"
+
+// JournalRecord::recipe of a process that did not come from a catalog
+#define PROCESS_JOURNAL_NO_RECIPE UINT16_MAX
+
+enum class JournalKind : uint8_t {
+  Progress = 0, // The run is at `cursor`
+  Finished = 1, // The run ended or was stopped, nothing to resume
+};
+
+struct JournalRecord {
+  uint32_t magic;      // PROCESS_JOURNAL_MAGIC
+  uint32_t sequence;   // Counts up from record to record
+  uint32_t process_id; // agitation_process_id() of the process
+  uint16_t recipe;     // Catalog entry the process was chosen from
+  uint8_t kind;        // JournalKind
+  uint8_t paused;
+  AgitationCursor cursor;
+  uint32_t checksum; // journal_checksum() of everything before it
+};
+
+static_assert(sizeof(JournalRecord) == 92, "Records are stored as is");
+
+// FNV-1a, continuing from `hash`
+inline uint32_t journal_hash(uint32_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+#define JOURNAL_HASH_SEED 2166136261u
+
+inline uint32_t journal_checksum(const JournalRecord &record) {
+  return journal_hash(JOURNAL_HASH_SEED, &record,
+                      offsetof(JournalRecord, checksum));
+}
+
+// True for a record written completely
+inline bool journal_record_check(const JournalRecord &record) {
+  return record.magic == PROCESS_JOURNAL_MAGIC &&
+         record.checksum == journal_checksum(record);
+}
+
+/**
+ * @brief Identifies a process by its contents, the hash of its YAML, so a
+ * cursor is only ever restored into the process it was saved from
+ */
+inline uint32_t agitation_process_id(const AgitationProcessStatic *process) {
+  uint32_t hash = JOURNAL_HASH_SEED;
+  agitation_process_to_yaml(
+      process,
+      [](const void *data, size_t size, void *context) {
+        uint32_t *hash = static_cast<uint32_t *>(context);
+        *hash = journal_hash(*hash, data, size);
+        return true;
+      },
+      &hash);
+  return hash;
+}
+
+/**
+ * @brief Decides when a run needs a journal record and builds it
+ * The caller appends the records to file getNextFile(), starting it over
+ * first when isFull() says so, and reports back with appended() or
+ * failed().
+ */
+class ProcessJournal {
+public:
+  // Least time between records at movement boundaries
+  static constexpr uint32_t MIN_INTERVAL_MS = 10 * 1000;
+  // Most time between records while the run moves on, within one movement
+  static constexpr uint32_t MAX_INTERVAL_MS = 60 * 1000;
+  // Records in a file before the next record starts the other one
+  static constexpr uint32_t MAX_RECORDS = 64;
+  // Files taking turns
+  static constexpr uint32_t FILES = 2;
+
+  ProcessJournal() { reset(0, MAX_RECORDS, 0); }
+
+  /**
+   * @brief Continue after the records already stored
+   * @param file File the newest record is in
+   * @param records Complete records in that file now, MAX_RECORDS for the
+   * next record to start the other file
+   * @param sequence Sequence number of the newest record
+   */
+  void reset(uint32_t file, uint32_t records, uint32_t sequence) {
+    current_file = file;
+    records_in_file = records;
+    next_sequence = sequence + 1;
+    running = false;
+    finishing = false;
+    retry = false;
+  }
+
+  // Starts journaling a new run of `process_id`
+  void begin(uint32_t process_id, uint16_t recipe, uint32_t now_ms) {
+    this->process_id = process_id;
+    this->recipe = recipe;
+    running = true;
+    last_ms = now_ms;
+    last_step = UINT32_MAX;
+    last_generation = 0;
+    last_waiting = false;
+    last_paused = false;
+    finishing = false;
+    retry = false;
+  }
+
+  // True until the record that closes the run is stored
+  bool isRunning() const { return running; }
+
+  /**
+   * @brief Build a record if one is due
+   * Call after anything that may move the run on.
+   * @return True with `record` filled in if it should be appended
+   */
+  bool update(const AgitationProcessInterpreter &interpreter, bool paused,
+              uint32_t now_ms, JournalRecord &record) {
+    AgitationCursor cursor;
+    if (!running || !interpreter.saveCursor(cursor)) {
+      return false;
+    }
+
+    uint32_t since = now_ms - last_ms;
+    bool waiting = interpreter.isWaitingForUser();
+    bool moved = interpreter.getGeneration() != last_generation;
+    if (!retry && cursor.step_index == last_step && waiting == last_waiting &&
+        paused == last_paused && !(moved && since >= MIN_INTERVAL_MS) &&
+        since < MAX_INTERVAL_MS) {
+      return false;
+    }
+
+    last_ms = now_ms;
+    last_step = cursor.step_index;
+    last_generation = interpreter.getGeneration();
+    last_waiting = waiting;
+    last_paused = paused;
+    fill(record, JournalKind::Progress, paused);
+    record.cursor = cursor;
+    record.checksum = journal_checksum(record);
+    return true;
+  }
+
+  // The record that closes the run, so it is not offered to resume
+  void finish(JournalRecord &record) {
+    finishing = true;
+    fill(record, JournalKind::Finished, false);
+    record.checksum = journal_checksum(record);
+  }
+
+  // Whether the next record starts the other file over
+  bool isFull() const { return records_in_file >= MAX_RECORDS; }
+
+  // File the next record goes to
+  uint32_t getNextFile() const {
+    return isFull() ? (current_file + 1) % FILES : current_file;
+  }
+
+  // Call once a record is stored in getNextFile()
+  void appended() {
+    if (isFull()) {
+      current_file = getNextFile();
+      records_in_file = 0;
+    }
+    records_in_file++;
+    if (finishing) {
+      running = false;
+    }
+    finishing = false;
+    retry = false;
+  }
+
+  // Call when a record could not be stored. The file may now end in part
+  // of it, so the next record starts the other file, and it is made at the
+  // next update() or finish() whether due or not.
+  void failed() {
+    records_in_file = MAX_RECORDS;
+    finishing = false;
+    retry = true;
+  }
+
+private:
+  void fill(JournalRecord &record, JournalKind kind, bool paused) {
+    memset(&record, 0, sizeof(record));
+    record.magic = PROCESS_JOURNAL_MAGIC;
+    record.sequence = next_sequence++;
+    record.process_id = process_id;
+    record.recipe = recipe;
+    record.kind = static_cast<uint8_t>(kind);
+    record.paused = paused;
+  }
+
+  uint32_t current_file;
+  uint32_t records_in_file;
+  uint32_t next_sequence;
+
+  bool running;
+  bool finishing; // The record out is the one that closes the run
+  bool retry;     // The last record was not stored
+  uint32_t process_id{0};
+  uint16_t recipe{PROCESS_JOURNAL_NO_RECIPE};
+
+  // What the last record of the run saw
+  uint32_t last_ms{0};
+  uint32_t last_step{0};
+  uint32_t last_generation{0};
+  bool last_waiting{false};
+  bool last_paused{false};
+};
@@ -9,7 +9,7 @@
 /**
  * @brief Standard B&W Initial Agitation Step
  */
-static const AgitationMovementStatic INITIAL_AGITATION[] = {
+static constexpr AgitationMovementStatic INITIAL_AGITATION[] = {
     {.type = AgitationMovementTypeLoop,
      .loop =
          {
@@ -20,9 +20,9 @@ static const AgitationMovementStatic INITIAL_AGITATION[] = {
          }},
     {.type = AgitationMovementTypePause, .duration = 24},
 };
-static const size_t INITIAL_AGITATION_LENGTH = 2;
+static constexpr size_t INITIAL_AGITATION_LENGTH = 2;
 
-static const AgitationStepStatic BW_INITIAL_AGITATION_STEP = {
+static constexpr AgitationStepStatic BW_INITIAL_AGITATION_STEP = {
     .name = "Initial Agitation",
     .description = "First round of agitation to ensure even development",
     .temperature = 20.0f,
@@ -32,7 +32,7 @@ static const AgitationStepStatic BW_INITIAL_AGITATION_STEP = {
 /**
  * @brief Standard B&W Periodic Agitation Step
  */
-static const AgitationMovementStatic BW_PERIODIC_AGITATION_SEQUENCE[] = {
+static constexpr AgitationMovementStatic BW_PERIODIC_AGITATION_SEQUENCE[] = {
     {.type = AgitationMovementTypeLoop,
      .loop = {
          .count = 2,
@@ -40,7 +40,7 @@ static const AgitationMovementStatic BW_PERIODIC_AGITATION_SEQUENCE[] = {
          .sequence = (const struct AgitationMovementStatic*)STANDARD_INVERSION,
          .sequence_length = STANDARD_INVERSION_LENGTH}}};
 
-static const AgitationStepStatic BW_PERIODIC_AGITATION_STEP = {
+static constexpr AgitationStepStatic BW_PERIODIC_AGITATION_STEP = {
     .name = "Periodic Agitation",
     .description = "Continued agitation during development",
     .temperature = 20.0f,
@@ -48,14 +48,14 @@ static const AgitationStepStatic BW_PERIODIC_AGITATION_STEP = {
     .sequence_length = 1};
 
 // B&W Standard Development Static Steps
-static const AgitationStepStatic BW_STANDARD_DEV_STEPS[] = {
+static constexpr AgitationStepStatic BW_STANDARD_DEV_STEPS[] = {
     BW_INITIAL_AGITATION_STEP,
     BW_PERIODIC_AGITATION_STEP};
 
 /**
  * @brief Standard B&W Development Process
  */
-static const AgitationProcessStatic BW_STANDARD_DEV_STATIC = {
+static constexpr AgitationProcessStatic BW_STANDARD_DEV_STATIC = {
     .process_name = "Black and White Standard Development",
     .film_type = "Black and White Negative",
     .tank_type = "Developing Tank",
@@ -9,7 +9,7 @@
 /**
  * @brief C41 Pre-Wash (Optional warm rinse)
  */
-static const AgitationMovementStatic C41_PRE_WASH[] = {
+static constexpr AgitationMovementStatic C41_PRE_WASH[] = {
     {.type = AgitationMovementTypeCW, .duration = 2},
     {.type = AgitationMovementTypePause, .duration = 3},
     {.type = AgitationMovementTypeCCW, .duration = 2},
@@ -17,9 +17,9 @@ static const AgitationMovementStatic C41_PRE_WASH[] = {
     {.type = AgitationMovementTypeWaitUser,
      .message = "Pre-wash complete. Ready for developer?"},
 };
-static const size_t C41_PRE_WASH_LENGTH = 5;
+static constexpr size_t C41_PRE_WASH_LENGTH = 5;
 
-static const AgitationMovementStatic C41_MINUTE_CYCLE[] = {
+static constexpr AgitationMovementStatic C41_MINUTE_CYCLE[] = {
     // wait 50 seconds,
     // continuous agitation for 10 seconds
     {
@@ -35,12 +35,12 @@ static const AgitationMovementStatic C41_MINUTE_CYCLE[] = {
                   (const struct AgitationMovementStatic *)CONTINUOUS_GENTLE_SEQ,
               .sequence_length = CONTINUOUS_GENTLE_SEQ_LENGTH}},
 };
-static const size_t C41_MINUTE_CYCLE_LENGTH = 2;
+static constexpr size_t C41_MINUTE_CYCLE_LENGTH = 2;
 
 /**
  * @brief C41 Color Developer Stage (Continuous Gentle Agitation)
  */
-static const AgitationMovementStatic C41_COLOR_DEVELOPER[] = {
+static constexpr AgitationMovementStatic C41_COLOR_DEVELOPER[] = {
     {.type = AgitationMovementTypeLoop,
      .loop = {.count = 0,
               //   .max_duration = 210,
@@ -51,12 +51,12 @@ static const AgitationMovementStatic C41_COLOR_DEVELOPER[] = {
     {.type = AgitationMovementTypeWaitUser,
      .message = "Development complete. Ready for bleach?"},
 };
-static const size_t C41_COLOR_DEVELOPER_LENGTH = 2;
+static constexpr size_t C41_COLOR_DEVELOPER_LENGTH = 2;
 
 /**
  * @brief C41 Bleach Stage (Periodic Gentle Agitation)
  */
-static const AgitationMovementStatic C41_BLEACH_SEQUENCE[] = {
+static constexpr AgitationMovementStatic C41_BLEACH_SEQUENCE[] = {
     {.type = AgitationMovementTypeLoop,
      .loop = {.count = 3,
               //   .max_duration = 60 * 5,
@@ -68,12 +68,12 @@ static const AgitationMovementStatic C41_BLEACH_SEQUENCE[] = {
     {.type = AgitationMovementTypeWaitUser,
      .message = "Bleach complete. Ready for stabilizer?"},
 };
-static const size_t C41_BLEACH_LENGTH = 3;
+static constexpr size_t C41_BLEACH_LENGTH = 3;
 
 /**
  * @brief C41 Stabilizer/Final Rinse Stage (Gentle Agitation)
  */
-static const AgitationMovementStatic C41_STABILIZER[] = {
+static constexpr AgitationMovementStatic C41_STABILIZER[] = {
     {.type = AgitationMovementTypeCW, .duration = 3},
     {.type = AgitationMovementTypePause, .duration = 1},
     {.type = AgitationMovementTypeCCW, .duration = 3},
@@ -81,7 +81,7 @@ static const AgitationMovementStatic C41_STABILIZER[] = {
     {.type = AgitationMovementTypeWaitUser,
      .message = "Process complete! Remove film."},
 };
-static const size_t C41_STABILIZER_LENGTH = 5;
+static constexpr size_t C41_STABILIZER_LENGTH = 5;
 
 //------------------------------------------------------------------------------
 // C41 Process Steps
@@ -90,7 +90,7 @@ static const size_t C41_STABILIZER_LENGTH = 5;
 /**
  * @brief C41 Pre-Wash Step
  */
-static const AgitationStepStatic C41_PRE_WASH_STEP = {
+static constexpr AgitationStepStatic C41_PRE_WASH_STEP = {
     .name = "Pre-Wash",
     .description = "Optional warm rinse before color development",
     .temperature = 38.0f,
@@ -100,7 +100,7 @@ static const AgitationStepStatic C41_PRE_WASH_STEP = {
 /**
  * @brief C41 Color Developer Step
  */
-static const AgitationStepStatic C41_COLOR_DEVELOPER_STEP = {
+static constexpr AgitationStepStatic C41_COLOR_DEVELOPER_STEP = {
     .name = "Color Developer",
     .description =
         "Main color development stage with continuous gentle agitation",
@@ -111,7 +111,7 @@ static const AgitationStepStatic C41_COLOR_DEVELOPER_STEP = {
 /**
  * @brief C41 Bleach Step
  */
-static const AgitationStepStatic C41_BLEACH_STEP = {
+static constexpr AgitationStepStatic C41_BLEACH_STEP = {
     .name = "Bleach",
     .description = "Bleach stage with periodic gentle agitation",
     .temperature = 38.0f,
@@ -121,7 +121,7 @@ static const AgitationStepStatic C41_BLEACH_STEP = {
 /**
  * @brief C41 Stabilizer Step
  */
-static const AgitationStepStatic C41_STABILIZER_STEP = {
+static constexpr AgitationStepStatic C41_STABILIZER_STEP = {
     .name = "Stabilizer",
     .description = "Final rinse and stabilization stage",
     .temperature = 38.0f,
@@ -129,14 +129,14 @@ static const AgitationStepStatic C41_STABILIZER_STEP = {
     .sequence_length = C41_STABILIZER_LENGTH};
 
 // C41 Full Process Static Steps
-static const AgitationStepStatic C41_FULL_PROCESS_STEPS[] = {
+static constexpr AgitationStepStatic C41_FULL_PROCESS_STEPS[] = {
     C41_PRE_WASH_STEP, C41_COLOR_DEVELOPER_STEP, C41_BLEACH_STEP,
     C41_STABILIZER_STEP};
 
 /**
  * @brief Complete C41 Development Process
  */
-static const AgitationProcessStatic C41_FULL_PROCESS_STATIC = {
+static constexpr AgitationProcessStatic C41_FULL_PROCESS_STATIC = {
     .process_name = "C41 Color Film Development",
     .film_type = "Color Negative",
     .tank_type = "Developing Tank",
@@ -9,19 +9,19 @@
 /**
  * @brief Continuous gentle agitation (for C41/E6)
  */
-static const AgitationMovementStatic CONTINUOUS_GENTLE[] = {
+static constexpr AgitationMovementStatic CONTINUOUS_GENTLE[] = {
     {.type = AgitationMovementTypeLoop,
      .loop = {
          .count = 0, // Continuous
          .max_duration = 0,
          .sequence = (const struct AgitationMovementStatic*)CONTINUOUS_GENTLE_SEQ,
          .sequence_length = CONTINUOUS_GENTLE_SEQ_LENGTH}}};
-static const size_t CONTINUOUS_GENTLE_LENGTH = 1;
+static constexpr size_t CONTINUOUS_GENTLE_LENGTH = 1;
 
 /**
  * @brief Continuous Gentle Agitation Step
  */
-static const AgitationStepStatic CONTINUOUS_GENTLE_STEP = {
+static constexpr AgitationStepStatic CONTINUOUS_GENTLE_STEP = {
     .name = "Continuous Gentle Agitation",
     .description = "Gentle, continuous movement for consistent development",
     .temperature = 38.0f, // Typical color development temperature
@@ -29,12 +29,12 @@ static const AgitationStepStatic CONTINUOUS_GENTLE_STEP = {
     .sequence_length = CONTINUOUS_GENTLE_LENGTH};
 
 // Continuous Gentle Static Steps
-static const AgitationStepStatic CONTINUOUS_GENTLE_STEPS[] = {CONTINUOUS_GENTLE_STEP};
+static constexpr AgitationStepStatic CONTINUOUS_GENTLE_STEPS[] = {CONTINUOUS_GENTLE_STEP};
 
 /**
  * @brief Continuous Gentle Agitation Process
  */
-static const AgitationProcessStatic CONTINUOUS_GENTLE_STATIC = {
+static constexpr AgitationProcessStatic CONTINUOUS_GENTLE_STATIC = {
     .process_name = "Continuous Gentle Agitation",
     .film_type = "Various",
     .tank_type = "Developing Tank",
@@ -9,7 +9,7 @@
 /**
  * @brief Stand Development Initial Agitation Step
  */
-static const AgitationMovementStatic STAND_DEV_INITIAL_SEQUENCE[] = {
+static constexpr AgitationMovementStatic STAND_DEV_INITIAL_SEQUENCE[] = {
     {.type = AgitationMovementTypeLoop,
      .loop = {
          .count = 3,
@@ -17,7 +17,7 @@ static const AgitationMovementStatic STAND_DEV_INITIAL_SEQUENCE[] = {
          .sequence = (const struct AgitationMovementStatic*)STANDARD_INVERSION,
          .sequence_length = STANDARD_INVERSION_LENGTH}}};
 
-static const AgitationStepStatic STAND_DEV_INITIAL_STEP = {
+static constexpr AgitationStepStatic STAND_DEV_INITIAL_STEP = {
     .name = "Initial Agitation",
     .description = "Initial agitation before long stand period",
     .temperature = 20.0f,
@@ -27,11 +27,11 @@ static const AgitationStepStatic STAND_DEV_INITIAL_STEP = {
 /**
  * @brief Stand Development Long Stand Step
  */
-static const AgitationMovementStatic STAND_DEV_LONG_STAND_SEQUENCE[] = {
+static constexpr AgitationMovementStatic STAND_DEV_LONG_STAND_SEQUENCE[] = {
     {.type = AgitationMovementTypePause, .duration = 3600} // 1 hour stand
 };
 
-static const AgitationStepStatic STAND_DEV_LONG_STAND_STEP = {
+static constexpr AgitationStepStatic STAND_DEV_LONG_STAND_STEP = {
     .name = "Long Stand",
     .description = "Extended period with minimal agitation",
     .temperature = 20.0f,
@@ -39,14 +39,14 @@ static const AgitationStepStatic STAND_DEV_LONG_STAND_STEP = {
     .sequence_length = 1};
 
 // Stand Development Static Steps
-static const AgitationStepStatic STAND_DEV_STEPS[] = {
+static constexpr AgitationStepStatic STAND_DEV_STEPS[] = {
     STAND_DEV_INITIAL_STEP,
     STAND_DEV_LONG_STAND_STEP};
 
 /**
  * @brief Stand Development Process
  */
-static const AgitationProcessStatic STAND_DEV_STATIC = {
+static constexpr AgitationProcessStatic STAND_DEV_STATIC = {
     .process_name = "Black and White Stand Development",
     .film_type = "Black and White Negative",
     .tank_type = "Developing Tank",
@@ -0,0 +1,196 @@
+#pragma once
+#include "agitation_sequence.hpp"
+#include "movement/sequence_analysis.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// A recipe catalog is two files: the recipes, each a process image (see
+// agitation_image_check()) padded to 4 bytes, one after the other, and an
+// index of fixed-size entries describing them. A menu reads only the index
+// entries it shows, and a recipe is read only once it is chosen, so neither
+// depends on how many recipes there are.
+
+#define RECIPE_INDEX_MAGIC 0x49524741u // "AGRI"
+#define RECIPE_INDEX_VERSION 1
+
+struct RecipeIndexHeader {
+  uint32_t magic;       // RECIPE_INDEX_MAGIC
+  uint16_t version;     // RECIPE_INDEX_VERSION
+  uint16_t entry_size;  // Later versions may add fields to entries
+  uint32_t entries_length;
+  uint32_t recipes_size; // Size of the recipes file the index was built for
+};
+
+struct RecipeIndexEntry {
+  // NUL-terminated, cut off where they do not fit
+  char name[40];
+  char film_type[32];
+  char chemistry[24];
+  // Seconds the process takes without prompts, UINT32_MAX if it never ends
+  uint32_t duration_s;
+  // Where the recipe's image is in the recipes file
+  uint32_t offset;
+  uint32_t size;
+};
+
+static_assert(sizeof(RecipeIndexHeader) == 16 &&
+                  sizeof(RecipeIndexEntry) == 108,
+              "Index records must keep their size");
+
+/**
+ * @brief Describe a recipe whose image is `size` bytes at `offset`
+ */
+inline void recipe_index_entry_init(RecipeIndexEntry &entry,
+                                    const AgitationProcessStatic &process,
+                                    uint32_t offset, uint32_t size) {
+  memset(&entry, 0, sizeof(entry));
+  const char *fields[] = {process.process_name, process.film_type,
+                          process.chemistry};
+  char *targets[] = {entry.name, entry.film_type, entry.chemistry};
+  size_t sizes[] = {sizeof(entry.name), sizeof(entry.film_type),
+                    sizeof(entry.chemistry)};
+  for (size_t i = 0; i < 3; i++) {
+    if (fields[i]) {
+      strncpy(targets[i], fields[i], sizes[i] - 1);
+    }
+  }
+
+  uint32_t duration = SequenceAnalysis::analyzeProcess(process).duration;
+  entry.duration_s = duration == AgitationMovement::UNBOUNDED_DURATION
+                         ? UINT32_MAX
+                         : duration / AGITATION_TICKS_PER_SECOND;
+  entry.offset = offset;
+  entry.size = size;
+}
+
+/**
+ * @brief Reads `size` bytes at `offset` of a file
+ * @return False unless all of them were read
+ */
+typedef bool (*RecipeCatalogRead)(uint32_t offset, void *buffer, size_t size,
+                                  void *context);
+
+/**
+ * @brief Reads a catalog index a window of entries at a time
+ * Opening reads the header only; entries are read when a window that is
+ * not cached yet is asked for, with one read for the whole window.
+ */
+class RecipeCatalog {
+public:
+  // Entries kept in memory, at least as many as a menu shows at once
+  static constexpr size_t WINDOW_SIZE = 8;
+
+  RecipeCatalog() { close(); }
+
+  /**
+   * @brief Open an index
+   * @param recipes_size Size of the recipes file now; an index built for
+   * another one is stale and not opened
+   */
+  bool open(RecipeCatalogRead read, void *context, uint32_t recipes_size) {
+    close();
+    reads = 1;
+    RecipeIndexHeader header;
+    if (!read(0, &header, sizeof(header), context) ||
+        header.magic != RECIPE_INDEX_MAGIC ||
+        header.version != RECIPE_INDEX_VERSION ||
+        header.entry_size < sizeof(RecipeIndexEntry) ||
+        header.recipes_size != recipes_size) {
+      return false;
+    }
+    this->read = read;
+    this->context = context;
+    entry_size = header.entry_size;
+    length = header.entries_length;
+    return true;
+  }
+
+  void close() {
+    read = nullptr;
+    context = nullptr;
+    entry_size = 0;
+    length = 0;
+    window_first = 0;
+    window_length = 0;
+    reads = 0;
+  }
+
+  bool isOpen() const { return read != nullptr; }
+  size_t getLength() const { return length; }
+
+  // Reads of the index since open(), the header included
+  uint32_t getReads() const { return reads; }
+
+  /**
+   * @brief Make entries [first, first + count) available to getEntry()
+   * Reads a window starting at `first` unless they are cached already.
+   * @return False if the index could not be read
+   */
+  bool fetch(size_t first, size_t count) {
+    if (first >= length) {
+      return true;
+    }
+    if (count > WINDOW_SIZE) {
+      count = WINDOW_SIZE;
+    }
+    if (first + count > length) {
+      count = length - first;
+    }
+    if (first >= window_first &&
+        first + count <= window_first + window_length) {
+      return true;
+    }
+
+    window_first = first;
+    window_length =
+        length - first < WINDOW_SIZE ? length - first : WINDOW_SIZE;
+    reads++;
+    bool ok = true;
+    if (entry_size == sizeof(RecipeIndexEntry)) {
+      ok = read(entryOffset(first), window, window_length * entry_size,
+                context);
+    } else {
+      // Entries of a later version, read one by one for the fields we know
+      for (size_t i = 0; i < window_length && ok; i++) {
+        ok = read(entryOffset(first + i), &window[i], sizeof(window[i]),
+                  context);
+      }
+    }
+    if (!ok) {
+      window_length = 0;
+      return false;
+    }
+    for (size_t i = 0; i < window_length; i++) {
+      window[i].name[sizeof(window[i].name) - 1] = '\0';
+      window[i].film_type[sizeof(window[i].film_type) - 1] = '\0';
+      window[i].chemistry[sizeof(window[i].chemistry) - 1] = '\0';
+    }
+    return true;
+  }
+
+  /**
+   * @brief An entry fetched before, nullptr if it is not cached
+   */
+  const RecipeIndexEntry *getEntry(size_t index) const {
+    if (index < window_first || index >= window_first + window_length) {
+      return nullptr;
+    }
+    return &window[index - window_first];
+  }
+
+private:
+  uint32_t entryOffset(size_t index) const {
+    return (uint32_t)(sizeof(RecipeIndexHeader) + index * entry_size);
+  }
+
+  RecipeCatalogRead read;
+  void *context;
+  size_t entry_size;
+  size_t length;
+
+  RecipeIndexEntry window[WINDOW_SIZE];
+  size_t window_first;
+  size_t window_length;
+  uint32_t reads;
+};
@@ -0,0 +1,29 @@
+#pragma once
+#include "../agitation_processes.hpp"
+#include <stddef.h>
+#include <string.h>
+
+// Built-in processes by short name, for the host tools
+struct BuiltinProcess {
+  const char *id;
+  const AgitationProcessStatic *process;
+};
+
+static constexpr BuiltinProcess BUILTIN_PROCESSES[] = {
+    {"c41", &C41_FULL_PROCESS_STATIC},
+    {"bw", &BW_STANDARD_DEV_STATIC},
+    {"stand", &STAND_DEV_STATIC},
+    {"continuous", &CONTINUOUS_GENTLE_STATIC},
+};
+static constexpr size_t BUILTIN_PROCESSES_LENGTH =
+    sizeof(BUILTIN_PROCESSES) / sizeof(BUILTIN_PROCESSES[0]);
+
+inline const AgitationProcessStatic *find_builtin_process(const char *id) {
+  for (size_t i = 0; i < BUILTIN_PROCESSES_LENGTH; i++) {
+    if (strcmp(BUILTIN_PROCESSES[i].id, id) == 0 ||
+        strcmp(BUILTIN_PROCESSES[i].process->process_name, id) == 0) {
+      return BUILTIN_PROCESSES[i].process;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,444 @@
+// Host microbenchmarks for the loader, factory and interpreter hot paths.
+// Prints one JSON object per line so results can be diffed or graphed.
+//
+// Build from the app directory (not part of the fap, see application.fam):
+//   g++ -std=c++20 -O2 -DHOST -DNDEBUG -I. -o film_developer_bench
+//       sim/film_developer_bench.cpp agitation_process_interpreter.cpp trace.cpp
+//
+// Usage:
+//   film_developer_bench [--min-ms N]
+//     --min-ms N   run each measurement for at least N ms (default 50)
+//
+// Records, by "bench":
+//   step_load     ns to load one step of a recipe, and its pool bytes
+//   pool          pool bytes per recipe, computed, measured loading one to
+//                 one, and measured with the peephole pass with the bytes
+//                 it saves
+//   tick          ns per tick() at a nesting depth
+//   long_sequence ns per tick() through a sequence of maximum length
+//                 Both load one to one, without the peephole pass, so the
+//                 tree ticked is the depth or length in the record.
+//   process_hour  cost of running a recipe per simulated hour, batched as on
+//                 the device and tick by tick. "instructions" is -1 where
+//                 hardware counters are not available.
+//   channels      cost per simulated hour and tank of running C-41 on 1 to 8
+//                 tanks at once from one scheduler, as the app does
+
+#include "../agitation_process_interpreter.hpp"
+#include "builtin_processes.hpp"
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Motor that does nothing, so the numbers are the interpreter's own
+class NullMotorController final : public MotorController {
+protected:
+  void drive(Direction, Direction) override {}
+};
+
+// Counts retired user-space instructions where the kernel allows it
+class InstructionCounter {
+public:
+  InstructionCounter() {
+#ifdef __linux__
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+
+  ~InstructionCounter() {
+#ifdef __linux__
+    if (fd >= 0) {
+      close(fd);
+    }
+#endif
+  }
+
+  void start() {
+#ifdef __linux__
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  // -1 if not available
+  long long stop() {
+#ifdef __linux__
+    if (fd >= 0) {
+      long long count = 0;
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &count, sizeof(count)) == sizeof(count)) {
+        return count;
+      }
+    }
+#endif
+    return -1;
+  }
+
+private:
+  int fd{-1};
+};
+
+static double min_ms = 50;
+
+// Runs `body` until at least min_ms passed; returns ns per operation, where
+// each call of `body` performs `ops` operations
+template <typename Body> static double measure(uint64_t ops, Body body) {
+  using clock = std::chrono::steady_clock;
+  uint64_t calls = 0;
+  auto start = clock::now();
+  double elapsed_ms = 0;
+  do {
+    body();
+    calls++;
+    elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start)
+                     .count();
+  } while (elapsed_ms < min_ms);
+  return elapsed_ms * 1e6 / (double)(calls * ops);
+}
+
+//------------------------------------------------------------------------------
+// Synthetic sequences
+//------------------------------------------------------------------------------
+
+// Loops nested `depth` deep, each level a few movements around the next
+// one. The outermost loop never ends.
+class NestedSequence {
+public:
+  explicit NestedSequence(size_t depth) : levels(depth) {
+    for (size_t level = 0; level < depth; level++) {
+      std::vector<AgitationMovementStatic> &sequence = levels[level];
+      sequence.push_back(leaf(AgitationMovementTypeCW, 2));
+      sequence.push_back(leaf(AgitationMovementTypePause, 1));
+      sequence.push_back(leaf(AgitationMovementTypeCCW, 2));
+      if (level > 0) {
+        sequence.push_back(loop(3, levels[level - 1]));
+      }
+    }
+    outer.push_back(loop(0, levels[depth - 1]));
+    step = {"nested", "", 20, outer.data(), outer.size()};
+  }
+
+  const AgitationStepStatic &getStep() const { return step; }
+
+  static AgitationMovementStatic leaf(AgitationMovementType type,
+                                      uint32_t seconds) {
+    AgitationMovementStatic movement{};
+    movement.type = type;
+    movement.duration = seconds;
+    return movement;
+  }
+
+  static AgitationMovementStatic
+  loop(uint32_t count, const std::vector<AgitationMovementStatic> &body) {
+    AgitationMovementStatic movement{};
+    movement.type = AgitationMovementTypeLoop;
+    movement.loop.count = count;
+    movement.loop.max_duration = 0;
+    movement.loop.sequence = body.data();
+    movement.loop.sequence_length = body.size();
+    return movement;
+  }
+
+private:
+  std::vector<std::vector<AgitationMovementStatic>> levels;
+  std::vector<AgitationMovementStatic> outer;
+  AgitationStepStatic step;
+};
+
+static AgitationProcessStatic
+single_step_process(const char *name, const AgitationStepStatic &step) {
+  return {name, "", "", "", 20, &step, 1};
+}
+
+//------------------------------------------------------------------------------
+// Benchmarks
+//------------------------------------------------------------------------------
+
+static void bench_step_load(const BuiltinProcess &builtin) {
+  const AgitationProcessStatic &process = *builtin.process;
+  static MovementFactory factory;
+  MovementLoader loader(factory);
+  AgitationMovement *sequence[MovementLoader::MAX_SEQUENCE_LENGTH];
+
+  for (size_t i = 0; i < process.steps_length; i++) {
+    const AgitationStepStatic &step = process.steps[i];
+    double ns = measure(1, [&] {
+      factory.reset();
+      loader.loadSequence(AgitationSequenceView::of(step), sequence);
+    });
+    printf("{\"bench\":\"step_load\",\"recipe\":\"%s\",\"step\":%zu,"
+           "\"ns\":%.1f,\"pool_bytes\":%zu}\n",
+           builtin.id, i, ns, factory.getUsed());
+  }
+}
+
+// Runs a whole process and returns the most pool any step buffer took
+static size_t measure_pool(const AgitationProcessStatic &process,
+                           bool optimize) {
+  NullMotorController motor;
+  AgitationProcessInterpreter interpreter;
+  interpreter.setOptimize(optimize);
+  interpreter.init(&process, &motor);
+  size_t high_water = 0;
+  bool active = true;
+  for (uint32_t tick = 0; active && tick < 10u * 3600u * 10u; tick++) {
+    active = interpreter.tick();
+    if (interpreter.isWaitingForUser()) {
+      interpreter.confirm();
+    }
+    size_t used = interpreter.getMovementFactory().getHighWaterMark();
+    if (used > high_water) {
+      high_water = used;
+    }
+  }
+  return high_water;
+}
+
+static void bench_pool(const BuiltinProcess &builtin) {
+  SequenceStats stats = SequenceAnalysis::analyzeProcess(*builtin.process);
+  size_t measured = measure_pool(*builtin.process, false);
+  size_t optimized = measure_pool(*builtin.process, true);
+
+  printf("{\"bench\":\"pool\",\"recipe\":\"%s\",\"pool_bytes\":%zu,"
+         "\"measured_bytes\":%zu,\"optimized_bytes\":%zu,\"saved_bytes\":%zu,"
+         "\"pool_size\":%zu,\"movements\":%zu}\n",
+         builtin.id, stats.pool_bytes, measured, optimized,
+         measured - optimized, MovementFactory::POOL_SIZE, stats.movements);
+}
+
+static void bench_tick(size_t depth) {
+  NestedSequence nested(depth);
+  AgitationProcessStatic process =
+      single_step_process("nested", nested.getStep());
+  NullMotorController motor;
+  constexpr uint64_t TICKS = 1000;
+
+  AgitationProcessInterpreter interpreter;
+  interpreter.setOptimize(false);
+  interpreter.init(&process, &motor);
+  double tree_ns = measure(TICKS, [&] {
+    for (uint64_t i = 0; i < TICKS; i++) {
+      interpreter.tick();
+    }
+  });
+
+  printf("{\"bench\":\"tick\",\"depth\":%zu,\"tree_ns\":%.2f,"
+         "\"pool_bytes\":%zu}\n",
+         depth, tree_ns, interpreter.getMovementFactory().getUsed());
+}
+
+static void bench_long_sequence() {
+  std::vector<AgitationMovementStatic> body;
+  for (size_t i = 0; i < MovementLoader::MAX_SEQUENCE_LENGTH; i++) {
+    body.push_back(NestedSequence::leaf(
+        i % 2 ? AgitationMovementTypeCCW : AgitationMovementTypeCW, 1));
+  }
+  AgitationMovementStatic outer[] = {NestedSequence::loop(0, body)};
+  AgitationStepStatic step = {"long", "", 20, outer, 1};
+  AgitationProcessStatic process = single_step_process("long", step);
+  NullMotorController motor;
+  constexpr uint64_t TICKS = 1000;
+
+  AgitationProcessInterpreter interpreter;
+  interpreter.setOptimize(false);
+  interpreter.init(&process, &motor);
+  double ns = measure(TICKS, [&] {
+    for (uint64_t i = 0; i < TICKS; i++) {
+      interpreter.tick();
+    }
+  });
+
+  printf("{\"bench\":\"long_sequence\",\"length\":%zu,\"tree_ns\":%.2f,"
+         "\"pool_bytes\":%zu}\n",
+         body.size(), ns, interpreter.getMovementFactory().getUsed());
+}
+
+// Runs a whole process the way the app does: sleep until the next event,
+// then run the ticks up to it in one batch. Returns simulated ticks.
+static uint32_t run_process(const AgitationProcessStatic &process,
+                            bool batched, uint32_t &calls) {
+  NullMotorController motor;
+  AgitationProcessInterpreter interpreter;
+  interpreter.init(&process, &motor);
+  calls = 0;
+
+  bool active = true;
+  while (active) {
+    uint32_t ticks = interpreter.nextEventIn();
+    if (ticks == AgitationMovement::NO_PENDING_EVENT) {
+      if (!interpreter.isWaitingForUser()) {
+        break;
+      }
+      interpreter.confirm();
+      continue;
+    }
+    calls++;
+    active = batched ? interpreter.advanceBy(ticks) : interpreter.tick();
+  }
+  return interpreter.getElapsedTicks();
+}
+
+static void bench_process_hour(const BuiltinProcess &builtin) {
+  if (SequenceAnalysis::analyzeProcess(*builtin.process).duration ==
+      AgitationMovement::UNBOUNDED_DURATION) {
+    return;
+  }
+
+  constexpr double TICKS_PER_HOUR = 3600.0 * AGITATION_TICKS_PER_SECOND;
+  InstructionCounter counter;
+
+  for (bool batched : {true, false}) {
+    uint32_t calls = 0;
+    counter.start();
+    uint32_t ticks = run_process(*builtin.process, batched, calls);
+    long long instructions = counter.stop();
+
+    double hours = ticks / TICKS_PER_HOUR;
+    double ns = measure(ticks, [&] {
+      uint32_t unused;
+      run_process(*builtin.process, batched, unused);
+    }) * ticks;
+
+    printf("{\"bench\":\"process_hour\",\"recipe\":\"%s\",\"mode\":\"%s\","
+           "\"ticks\":%" PRIu32 ",\"wakeups_per_hour\":%.0f,\"ns_per_hour\":%.0f,"
+           "\"instructions_per_hour\":%.0f}\n",
+           builtin.id, batched ? "batched" : "tick", ticks, calls / hours,
+           ns / hours, instructions < 0 ? -1.0 : instructions / hours);
+  }
+}
+
+// Tanks start this far apart, so their events do not line up
+static constexpr uint32_t CHANNEL_STAGGER_MS = 1234;
+// Tanks due this soon after the first one run in the same wakeup, as
+// SCHEDULE_BATCH_MS in the app
+static constexpr uint32_t CHANNEL_BATCH_MS = 50;
+
+// Works out when `interpreter` is next due, confirming prompts right away.
+// False once it has nothing left to do.
+static bool plan_channel(AgitationProcessInterpreter &interpreter,
+                         uint32_t now, uint32_t &due) {
+  uint32_t ticks = interpreter.nextEventIn();
+  if (ticks == AgitationMovement::NO_PENDING_EVENT &&
+      interpreter.isWaitingForUser()) {
+    interpreter.confirm();
+    interpreter.anchor(now);
+    ticks = interpreter.nextEventIn();
+  }
+  if (ticks == AgitationMovement::NO_PENDING_EVENT) {
+    return false;
+  }
+  due = interpreter.tickTimeMs(interpreter.getElapsedTicks() + ticks);
+  return true;
+}
+
+// Runs `process` on `length` tanks the way the app's state timer does: wake
+// up when the first tank is due, run every tank due by then and plan those
+// again. Returns simulated ticks of all tanks.
+static uint64_t run_channels(const AgitationProcessStatic &process,
+                             size_t length, uint32_t &wakeups) {
+  std::vector<NullMotorController> motors(length);
+  std::unique_ptr<AgitationProcessInterpreter[]> interpreters(
+      new AgitationProcessInterpreter[length]);
+  std::vector<bool> scheduled(length);
+  std::vector<uint32_t> due(length);
+  for (size_t i = 0; i < length; i++) {
+    uint32_t start = (uint32_t)i * CHANNEL_STAGGER_MS;
+    interpreters[i].init(&process, &motors[i]);
+    interpreters[i].anchor(start);
+    scheduled[i] = plan_channel(interpreters[i], start, due[i]);
+  }
+  wakeups = 0;
+
+  while (true) {
+    bool any = false;
+    uint32_t now = 0;
+    for (size_t i = 0; i < length; i++) {
+      if (scheduled[i] && (!any || (int32_t)(due[i] - now) < 0)) {
+        now = due[i];
+        any = true;
+      }
+    }
+    if (!any) {
+      break;
+    }
+
+    wakeups++;
+    for (size_t i = 0; i < length; i++) {
+      if (scheduled[i] && due[i] - now <= CHANNEL_BATCH_MS) {
+        scheduled[i] = interpreters[i].runUntil(due[i]) &&
+                       plan_channel(interpreters[i], due[i], due[i]);
+      }
+    }
+  }
+
+  uint64_t ticks = 0;
+  for (size_t i = 0; i < length; i++) {
+    ticks += interpreters[i].getElapsedTicks();
+  }
+  return ticks;
+}
+
+static void bench_channels(size_t length) {
+  constexpr double TICKS_PER_HOUR = 3600.0 * AGITATION_TICKS_PER_SECOND;
+  const AgitationProcessStatic &process = C41_FULL_PROCESS_STATIC;
+
+  uint32_t wakeups = 0;
+  uint64_t ticks = run_channels(process, length, wakeups);
+  double hours = ticks / TICKS_PER_HOUR;
+  double ns = measure(ticks, [&] {
+    uint32_t unused;
+    run_channels(process, length, unused);
+  }) * ticks;
+
+  // Per tank hour, which stays flat if the cost is linear in the tanks
+  printf("{\"bench\":\"channels\",\"channels\":%zu,\"ticks\":%" PRIu64
+         ",\"wakeups_per_channel_hour\":%.0f,\"ns_per_channel_hour\":%.0f}\n",
+         length, ticks, wakeups / hours, ns / hours);
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) {
+      min_ms = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--min-ms N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  for (const BuiltinProcess &builtin : BUILTIN_PROCESSES) {
+    bench_step_load(builtin);
+    bench_pool(builtin);
+  }
+  for (size_t depth = 1; depth <= MovementLoader::MAX_NESTING_DEPTH; depth++) {
+    bench_tick(depth);
+  }
+  bench_long_sequence();
+  for (const BuiltinProcess &builtin : BUILTIN_PROCESSES) {
+    bench_process_hour(builtin);
+  }
+  for (size_t length : {1, 2, 4, 8}) {
+    bench_channels(length);
+  }
+  return 0;
+}
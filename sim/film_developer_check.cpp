@@ -0,0 +1,729 @@
+// Host checks of the interpreter against its reference behavior. Prints one
+// line per check and exits non-zero if any of them fails.
+//
+// Build from the app directory (not part of the fap, see application.fam):
+//   g++ -std=c++20 -O2 -DHOST -DNDEBUG -I. -o film_developer_check
+//       sim/film_developer_check.cpp agitation_process_interpreter.cpp
+//       trace.cpp
+//
+// Usage:
+//   film_developer_check [--seed N] [--trials N] [CHECK...]
+//     --seed N     seed of the random processes (default 1)
+//     --trials N   random processes per check (default 3000)
+//
+// Checks, all of them if none is named:
+//   advance      advanceBy() against tick() by tick() on random nested
+//                processes, with user prompts confirmed in between: step,
+//                movement, elapsed times, next event, motor direction and
+//                the return values must match after every batch
+//   motor-queue  MotorCommandQueue on a fake clock: commands apply at their
+//                time and in order, execute() returns the time to the next
+//                one, collectLateness() gets how late each was,
+//                cancelPending() drops what is queued, a full ring counts
+//                drops, and times wrap around. Then the built-in
+//                recipes and random processes run the way the app runs
+//                them, the event loop early or late at random within what
+//                the app allows, and the motor timeline, every stop between
+//                reversals included, must be the one of tick() by tick() to
+//                the ms
+//   loader       MovementLoader in a pool with room for 0 to 4 motor
+//                movements, with and without the peephole pass: a load that
+//                did not fit is reported, also when the pass folds the part
+//                that did fit, and a load that is not reported is complete.
+//                Then loops run once, with 1 to 32 movements, before up to
+//                31 more: the pass unwraps them only as far as the sequence
+//                has room, and the load comes out complete
+
+#include "../agitation_process_interpreter.hpp"
+#include "../motor_command_queue.hpp"
+#include "builtin_processes.hpp"
+#include "recording_motor_controller.hpp"
+#include "sim_clock.hpp"
+#include <deque>
+#include <inttypes.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Motor that only tracks the commanded direction
+class SilentMotorController final : public MotorController {
+protected:
+  void drive(Direction, Direction) override {}
+};
+
+struct CheckOptions {
+  uint32_t seed{1};
+  uint32_t trials{3000};
+};
+
+//------------------------------------------------------------------------------
+// Random processes
+//------------------------------------------------------------------------------
+
+// Random steps of CW, CCW, pause and wait movements in loops nested up to
+// MAX_DEPTH deep. The tables live as long as the generator or until clear().
+class RandomProcess {
+public:
+  static constexpr size_t MAX_DEPTH = 3;
+  static constexpr size_t MAX_STEPS = 3;
+
+  explicit RandomProcess(std::mt19937 &random) : random(random) {}
+
+  const AgitationProcessStatic &generate() {
+    sequences.clear();
+    steps.assign(1 + random() % MAX_STEPS, AgitationStepStatic{});
+    for (AgitationStepStatic &step : steps) {
+      step.name = "random";
+      step.description = "";
+      step.temperature = 20;
+      step.sequence = sequence(0, step.sequence_length);
+    }
+    process = {"random", "", "", "", 20, steps.data(), steps.size()};
+    return process;
+  }
+
+private:
+  const AgitationMovementStatic *sequence(size_t depth, size_t &length) {
+    length = 1 + random() % 4;
+    sequences.emplace_back(length);
+    std::vector<AgitationMovementStatic> &movements = sequences.back();
+    for (AgitationMovementStatic &movement : movements) {
+      uint32_t kind = random() % 10;
+      if (kind < 6 || depth >= MAX_DEPTH) {
+        movement.type = static_cast<AgitationMovementType>(random() % 3);
+        // Mostly whole seconds, some in ms to land between ticks
+        movement.duration = random() % 5 == 0
+                                ? AGITATION_MS(random() % 700)
+                                : static_cast<uint32_t>(random() % 4);
+      } else if (kind < 9) {
+        movement.type = AgitationMovementTypeLoop;
+        movement.loop.sequence =
+            sequence(depth + 1, movement.loop.sequence_length);
+        movement.loop.count = random() % 4;
+        movement.loop.max_duration = random() % 3 ? random() % 6 : 0;
+        if (movement.loop.count == 0 && movement.loop.max_duration == 0) {
+          movement.loop.count = 2;
+        }
+      } else {
+        movement.type = AgitationMovementTypeWaitUser;
+        movement.message = "random";
+      }
+    }
+    return movements.data();
+  }
+
+  std::mt19937 &random;
+  std::deque<std::vector<AgitationMovementStatic>> sequences;
+  std::vector<AgitationStepStatic> steps;
+  AgitationProcessStatic process{};
+};
+
+//------------------------------------------------------------------------------
+// advance
+//------------------------------------------------------------------------------
+
+// What a caller can observe of an interpreter and its motor
+struct Observed {
+  size_t step;
+  AgitationProcessState state;
+  MotorController::Direction direction;
+  uint32_t movement_duration;
+  uint32_t movement_elapsed;
+  uint32_t next_event;
+  uint32_t elapsed_ticks;
+  uint32_t step_remaining;
+  bool waiting;
+
+  static Observed of(const AgitationProcessInterpreter &interpreter,
+                     const MotorController &motor) {
+    return {interpreter.getCurrentStepIndex(),
+            interpreter.getState(),
+            motor.getDirection(),
+            interpreter.getCurrentMovementDuration(),
+            interpreter.getCurrentMovementTimeElapsed(),
+            interpreter.nextEventIn(),
+            interpreter.getElapsedTicks(),
+            interpreter.getStepTimeRemaining(),
+            interpreter.isWaitingForUser()};
+  }
+
+  bool operator==(const Observed &other) const {
+    return step == other.step && state == other.state &&
+           direction == other.direction &&
+           movement_duration == other.movement_duration &&
+           movement_elapsed == other.movement_elapsed &&
+           next_event == other.next_event &&
+           elapsed_ticks == other.elapsed_ticks &&
+           step_remaining == other.step_remaining && waiting == other.waiting;
+  }
+
+  void print(const char *label) const {
+    fprintf(stderr,
+            "  %s: step %zu state %d motor %d movement %" PRIu32 "/%" PRIu32
+            " next %" PRIu32 " elapsed %" PRIu32 " step left %" PRIu32
+            "%s\n",
+            label, step, static_cast<int>(state), static_cast<int>(direction),
+            movement_elapsed, movement_duration, next_event, elapsed_ticks,
+            step_remaining, waiting ? " waiting" : "");
+  }
+};
+
+static bool check_advance(const CheckOptions &options) {
+  static constexpr size_t BATCHES = 30;
+  std::mt19937 random(options.seed);
+  RandomProcess generator(random);
+  uint32_t batches = 0;
+  uint32_t failures = 0;
+
+  for (uint32_t trial = 0; trial < options.trials; trial++) {
+    const AgitationProcessStatic &process = generator.generate();
+    // Mostly short batches, some long enough to cross several movements
+    uint32_t lengths[BATCHES];
+    bool confirms[BATCHES];
+    for (size_t i = 0; i < BATCHES; i++) {
+      lengths[i] = random() % 3 == 0 ? random() % 200 : random() % 8;
+      confirms[i] = random() % 2;
+    }
+
+    SilentMotorController reference_motor;
+    SilentMotorController motor;
+    AgitationProcessInterpreter reference;
+    AgitationProcessInterpreter interpreter;
+    reference.init(&process, &reference_motor);
+    interpreter.init(&process, &motor);
+
+    for (size_t i = 0; i < BATCHES; i++) {
+      bool reference_active = true;
+      for (uint32_t tick = 0; tick < lengths[i] && reference_active; tick++) {
+        reference_active = reference.tick();
+      }
+      bool active = interpreter.advanceBy(lengths[i]);
+      batches++;
+
+      Observed expected = Observed::of(reference, reference_motor);
+      Observed observed = Observed::of(interpreter, motor);
+      if (!(expected == observed) ||
+          (lengths[i] > 0 && active != reference_active)) {
+        if (failures++ < 5) {
+          fprintf(stderr,
+                  "advance: trial %" PRIu32 " batch %zu of %" PRIu32
+                  " ticks, returned %d, tick() %d\n",
+                  trial, i, lengths[i], active, reference_active);
+          expected.print("tick()");
+          observed.print("advanceBy()");
+        }
+        break;
+      }
+
+      if (confirms[i]) {
+        if (reference.isWaitingForUser()) {
+          reference.confirm();
+        }
+        if (interpreter.isWaitingForUser()) {
+          interpreter.confirm();
+        }
+      }
+    }
+  }
+
+  printf("advance: %" PRIu32 " processes, %" PRIu32 " batches, %" PRIu32
+         " failed\n",
+         options.trials, batches, failures);
+  return failures == 0;
+}
+
+//------------------------------------------------------------------------------
+// motor-queue
+//------------------------------------------------------------------------------
+
+// As in film_developer.cpp
+static constexpr uint32_t MOTOR_COMMAND_LEAD_MS = AGITATION_TICK_MS / 2;
+static constexpr uint32_t SCHEDULE_BATCH_MS = MOTOR_COMMAND_LEAD_MS;
+
+// Counts failed expectations of a check, printing the first few
+class Expectations {
+public:
+  explicit Expectations(const char *check) : check(check) {}
+
+  void expect(bool condition, const char *what) {
+    if (!condition && failures++ < 5) {
+      fprintf(stderr, "%s: expected %s\n", check, what);
+    }
+  }
+
+  uint32_t getFailures() const { return failures; }
+
+private:
+  const char *check;
+  uint32_t failures{0};
+};
+
+static void check_queue_basics(Expectations &expectations) {
+  SimClock clock;
+  RecordingMotorController motor(clock);
+  MotorCommandQueue queue;
+  TimingHistogram lateness;
+
+  queue.setTimestamp(100);
+  queue.clockwise(true);
+  queue.setTimestamp(250);
+  queue.stop();
+  queue.setTimestamp(300);
+  queue.counterClockwise(true);
+  queue.clockwise(true); // Same time, applies right after
+
+  expectations.expect(queue.execute(50, motor) == 50,
+                      "50 ms to the first command");
+  expectations.expect(motor.getTransitions().empty(),
+                      "nothing applied before its time");
+  clock.advanceTo(100);
+  expectations.expect(queue.execute(100, motor) == 150,
+                      "CW applied on time, 150 ms to the stop");
+  clock.advanceTo(260);
+  expectations.expect(queue.execute(260, motor) == 40,
+                      "stop applied 10 ms late, 40 ms to CCW");
+  queue.collectLateness(lateness);
+  expectations.expect(lateness.getCount() == 2 && lateness.getMax() == 10,
+                      "lateness of 0 and 10 ms collected");
+  clock.advanceTo(300);
+  expectations.expect(queue.execute(300, motor) ==
+                          MotorCommandQueue::NO_COMMAND_PENDING,
+                      "both commands at 300 applied");
+
+  const auto &transitions = motor.getTransitions();
+  using Direction = MotorController::Direction;
+  static const struct {
+    uint32_t at_ms;
+    Direction to;
+  } expected[] = {{100, Direction::CW},
+                  {260, Direction::Stop},
+                  {300, Direction::CCW},
+                  {300, Direction::CW}};
+  bool matches = transitions.size() == 4;
+  for (size_t i = 0; matches && i < transitions.size(); i++) {
+    matches = transitions[i].at_ms == expected[i].at_ms &&
+              transitions[i].to == expected[i].to;
+  }
+  expectations.expect(matches, "CW, stop, CCW, CW at 100, 260, 300, 300");
+
+  // Commands queued ahead are dropped; the stop after the cancel is queued
+  // although the queue last saw a stop, as the motor may not have
+  queue.setTimestamp(400);
+  queue.stop();
+  queue.setTimestamp(500);
+  queue.counterClockwise(true);
+  queue.cancelPending();
+  queue.setTimestamp(410);
+  queue.stop();
+  clock.advanceTo(600);
+  expectations.expect(queue.execute(600, motor) ==
+                          MotorCommandQueue::NO_COMMAND_PENDING,
+                      "nothing pending after a cancel");
+  expectations.expect(transitions.size() == 5 &&
+                          transitions.back().at_ms == 600 &&
+                          transitions.back().to == Direction::Stop,
+                      "only the stop queued after the cancel applied");
+
+  // A full ring drops what does not fit, and counts it
+  for (size_t i = 0; i <= MotorCommandQueue::CAPACITY; i++) {
+    queue.setTimestamp(700);
+    if (i % 2) {
+      queue.stop();
+    } else {
+      queue.clockwise(true);
+    }
+  }
+  expectations.expect(queue.getDroppedCount() == 1,
+                      "one command dropped by a full ring");
+  queue.collectLateness(lateness);
+  lateness.reset();
+  clock.advanceTo(700);
+  queue.execute(700, motor);
+  queue.collectLateness(lateness);
+  expectations.expect(lateness.getCount() == MotorCommandQueue::CAPACITY,
+                      "the lateness of a full ring collected");
+
+  // Times wrap around
+  SilentMotorController wrapped;
+  queue.setTimestamp(UINT32_MAX - 10);
+  queue.counterClockwise(true);
+  queue.setTimestamp(5);
+  queue.stop();
+  expectations.expect(queue.execute(UINT32_MAX - 20, wrapped) == 10,
+                      "10 ms to a command before the wrap");
+  expectations.expect(queue.execute(UINT32_MAX - 10, wrapped) == 16 &&
+                          wrapped.isCounterClockwise(),
+                      "16 ms from before the wrap to a command after it");
+  expectations.expect(queue.execute(5, wrapped) ==
+                              MotorCommandQueue::NO_COMMAND_PENDING &&
+                          wrapped.isStopped(),
+                      "the command after the wrap applied");
+}
+
+// One-shot motor timer, armed the way film_developer.cpp arms motor_timer
+struct FakeMotorTimer {
+  bool running{false};
+  uint32_t expire_at{0};
+
+  void start(uint32_t now, uint32_t delay) {
+    running = true;
+    expire_at = now + delay;
+  }
+
+  // arm_motor_timer()
+  void arm(uint32_t now, uint32_t at_ms) {
+    if (running && static_cast<int32_t>(expire_at - at_ms) <= 0) {
+      return;
+    }
+    int32_t delay = static_cast<int32_t>(at_ms - now);
+    start(now, delay > 0 ? static_cast<uint32_t>(delay) : 1);
+  }
+};
+
+// Time at which a prompt is confirmed, the same in both runs
+static constexpr uint32_t CONFIRM_AFTER_MS = 1500;
+// Recipes that do not end are compared up to here
+static constexpr uint32_t QUEUE_RUN_MS = 30u * 60u * 1000u;
+
+// tick() by tick(), each tick applied the moment it is due
+static void run_reference(const AgitationProcessStatic &process,
+                          SimClock &clock, MotorController &motor) {
+  AgitationProcessInterpreter interpreter;
+  interpreter.init(&process, &motor);
+  interpreter.anchor(0);
+  while (clock.nowMs() < QUEUE_RUN_MS) {
+    if (interpreter.nextEventIn() == AgitationMovement::NO_PENDING_EVENT) {
+      if (!interpreter.isWaitingForUser()) {
+        break;
+      }
+      uint32_t at = interpreter.tickTimeMs(interpreter.getElapsedTicks()) +
+                    CONFIRM_AFTER_MS;
+      interpreter.confirm();
+      interpreter.anchor(at);
+      continue;
+    }
+    clock.advanceTo(interpreter.tickTimeMs(interpreter.getElapsedTicks() + 1));
+    if (!interpreter.tick()) {
+      motor.stop();
+      break;
+    }
+  }
+}
+
+// As the app: the event loop runs the ticks of each event into the queue
+// MOTOR_COMMAND_LEAD_MS early, late by a random part of that, or up to
+// SCHEDULE_BATCH_MS earlier still when the pass of another tank takes it
+// along; the motor timer applies the commands on the consumer's clock. On a
+// tie the event loop goes first, so the timer finds later commands queued
+// behind the ones it was armed for and must arm itself again.
+static void run_queued(const AgitationProcessStatic &process,
+                       std::mt19937 &random, SimClock &clock,
+                       MotorController &motor, TimingHistogram &lateness) {
+  AgitationProcessInterpreter interpreter;
+  MotorCommandQueue queue;
+  FakeMotorTimer timer;
+  interpreter.init(&process, &queue);
+  interpreter.anchor(0);
+
+  bool active = true;
+  bool scheduled = false;
+  uint32_t next_event_at = 0;
+  uint32_t wakeup_at = 0;
+  while (true) {
+    if (active && !scheduled) {
+      uint32_t ticks = interpreter.nextEventIn();
+      if (ticks == AgitationMovement::NO_PENDING_EVENT &&
+          interpreter.isWaitingForUser()) {
+        uint32_t at = interpreter.tickTimeMs(interpreter.getElapsedTicks()) +
+                      CONFIRM_AFTER_MS;
+        interpreter.confirm();
+        interpreter.anchor(at);
+        ticks = interpreter.nextEventIn();
+      }
+      active = ticks != AgitationMovement::NO_PENDING_EVENT &&
+               interpreter.tickTimeMs(interpreter.getElapsedTicks()) <
+                   QUEUE_RUN_MS;
+      if (active) {
+        next_event_at =
+            interpreter.tickTimeMs(interpreter.getElapsedTicks() + ticks);
+        wakeup_at = next_event_at - MOTOR_COMMAND_LEAD_MS;
+        if (random() % 4 == 0) {
+          wakeup_at -= random() % 2 ? SCHEDULE_BATCH_MS
+                                    : random() % SCHEDULE_BATCH_MS;
+        } else {
+          wakeup_at += random() % MOTOR_COMMAND_LEAD_MS;
+        }
+        scheduled = true;
+      }
+    }
+
+    bool producer = scheduled && (!timer.running ||
+                                  static_cast<int32_t>(wakeup_at -
+                                                       timer.expire_at) <= 0);
+    if (producer) {
+      // run_until() for the planned event
+      scheduled = false;
+      queue.collectLateness(lateness);
+      uint32_t due_at =
+          interpreter.tickTimeMs(interpreter.ticksDueAt(next_event_at));
+      queue.setTimestamp(due_at);
+      active = interpreter.runUntil(next_event_at);
+      if (!active) {
+        queue.stop();
+      }
+      timer.arm(wakeup_at, due_at);
+    } else if (timer.running) {
+      // motor_timer_callback()
+      timer.running = false;
+      clock.advanceTo(timer.expire_at);
+      uint32_t wait = queue.execute(timer.expire_at, motor);
+      if (wait != MotorCommandQueue::NO_COMMAND_PENDING) {
+        timer.start(timer.expire_at, wait);
+      }
+    } else {
+      break;
+    }
+  }
+  queue.collectLateness(lateness);
+}
+
+static void check_queue_timeline(const char *name,
+                                 const AgitationProcessStatic &process,
+                                 std::mt19937 &random,
+                                 Expectations &expectations,
+                                 uint32_t &reversals) {
+  SimClock reference_clock;
+  RecordingMotorController reference(reference_clock);
+  run_reference(process, reference_clock, reference);
+
+  SimClock clock;
+  RecordingMotorController motor(clock);
+  TimingHistogram lateness;
+  run_queued(process, random, clock, motor, lateness);
+
+  using Direction = MotorController::Direction;
+  const auto &expected = reference.getTransitions();
+  const auto &observed = motor.getTransitions();
+  size_t length = 0;
+  while (length < expected.size() && expected[length].at_ms < QUEUE_RUN_MS) {
+    length++;
+  }
+  bool matches = observed.size() >= length;
+  for (size_t i = 0; i < length && matches; i++) {
+    matches = observed[i].at_ms == expected[i].at_ms &&
+              observed[i].from == expected[i].from &&
+              observed[i].to == expected[i].to;
+    if (!matches) {
+      fprintf(stderr,
+              "motor-queue: %s transition %zu at %" PRIu32 " ms to %s, "
+              "tick() by tick() at %" PRIu32 " ms to %s\n",
+              name, i, observed[i].at_ms,
+              RecordingMotorController::directionName(observed[i].to),
+              expected[i].at_ms,
+              RecordingMotorController::directionName(expected[i].to));
+    }
+    // A stop between opposite directions keeps its length
+    if (i >= 2 && expected[i - 1].to == Direction::Stop &&
+        expected[i].to != Direction::Stop &&
+        expected[i - 2].to != Direction::Stop &&
+        expected[i].to != expected[i - 2].to) {
+      reversals++;
+    }
+  }
+  expectations.expect(matches, "the motor timeline of tick() by tick()");
+  expectations.expect(lateness.getCount() ==
+                              observed.size() + motor.getAvoidedCount() &&
+                          lateness.getMax() == 0,
+                      "every command collected as applied on time");
+}
+
+static bool check_motor_queue(const CheckOptions &options) {
+  Expectations expectations("motor-queue");
+  check_queue_basics(expectations);
+
+  std::mt19937 random(options.seed);
+  uint32_t reversals = 0;
+  for (const BuiltinProcess &builtin : BUILTIN_PROCESSES) {
+    check_queue_timeline(builtin.id, *builtin.process, random, expectations,
+                         reversals);
+  }
+  // Movements shorter than a second, so commands queue up behind each other
+  RandomProcess generator(random);
+  for (uint32_t trial = 0; trial < options.trials; trial++) {
+    check_queue_timeline("random", generator.generate(), random, expectations,
+                         reversals);
+  }
+
+  printf("motor-queue: %zu recipes and %" PRIu32 " processes, %" PRIu32
+         " stops between reversals, %" PRIu32 " failed\n",
+         BUILTIN_PROCESSES_LENGTH, options.trials, reversals,
+         expectations.getFailures());
+  return expectations.getFailures() == 0;
+}
+
+//------------------------------------------------------------------------------
+// loader
+//------------------------------------------------------------------------------
+
+// CW 10 s, then 2 x (CW 1 s, CCW 1 s). With room for two motor movements the
+// body's CCW does not fit; the pass would then fold what is left of the loop
+// into the CW before it.
+static constexpr AgitationMovementStatic LOADER_BODY[] = {
+    {.type = AgitationMovementTypeCW, .duration = 1},
+    {.type = AgitationMovementTypeCCW, .duration = 1},
+};
+static constexpr AgitationMovementStatic LOADER_SEQUENCE[] = {
+    {.type = AgitationMovementTypeCW, .duration = 10},
+    {.type = AgitationMovementTypeLoop,
+     .loop = {.count = 2,
+              .max_duration = 0,
+              .sequence = LOADER_BODY,
+              .sequence_length = 2}},
+};
+static constexpr uint32_t LOADER_SEQUENCE_TICKS =
+    14 * AGITATION_TICKS_PER_SECOND;
+
+static bool check_loader(const CheckOptions &) {
+  Expectations expectations("loader");
+  uint32_t loads = 0;
+  for (bool optimize : {false, true}) {
+    for (size_t room = 0; room <= 4; room++) {
+      MovementFactory factory;
+      MovementLoader loader(factory);
+      loader.setOptimize(optimize);
+      size_t space = room * MovementFactory::MOTOR_BYTES;
+      while (factory.getAvailableSpace() > space) {
+        factory.createPause(1);
+      }
+
+      AgitationMovement *sequence[MovementLoader::MAX_SEQUENCE_LENGTH];
+      size_t length = loader.loadSequence(
+          LOADER_SEQUENCE,
+          sizeof(LOADER_SEQUENCE) / sizeof(LOADER_SEQUENCE[0]), sequence);
+      uint32_t ticks = 0;
+      for (size_t i = 0; i < length; i++) {
+        ticks += sequence[i]->getTotalTicks();
+      }
+      loads++;
+
+      if (room == 2) {
+        expectations.expect(factory.isExhausted(),
+                            "the load with room for 2 motor movements "
+                            "reported");
+      }
+      if (!factory.isExhausted()) {
+        expectations.expect(ticks == LOADER_SEQUENCE_TICKS,
+                            "a load not reported to be complete");
+      }
+    }
+  }
+
+  // A loop run once, CW and CCW in turn, then pauses and CW in turn
+  static constexpr size_t MAX_LENGTH = MovementLoader::MAX_SEQUENCE_LENGTH;
+  for (size_t body_length = 1; body_length <= MAX_LENGTH; body_length++) {
+    for (size_t rest = 0; rest < MAX_LENGTH; rest++) {
+      std::vector<AgitationMovementStatic> body(body_length);
+      for (size_t i = 0; i < body_length; i++) {
+        body[i].type =
+            i % 2 ? AgitationMovementTypeCCW : AgitationMovementTypeCW;
+        body[i].duration = 1;
+      }
+      std::vector<AgitationMovementStatic> source(1 + rest);
+      source[0].type = AgitationMovementTypeLoop;
+      source[0].loop = {1, 0, body.data(), body.size()};
+      for (size_t i = 1; i <= rest; i++) {
+        source[i].type =
+            i % 2 ? AgitationMovementTypePause : AgitationMovementTypeCW;
+        source[i].duration = 1;
+      }
+
+      MovementFactory factory;
+      MovementLoader loader(factory);
+      // Room past the end, so an overrun shows in the length
+      AgitationMovement *sequence[2 * MAX_LENGTH];
+      size_t length =
+          loader.loadSequence(source.data(), source.size(), sequence);
+      uint32_t ticks = 0;
+      for (size_t i = 0; i < length && i < MAX_LENGTH; i++) {
+        ticks += sequence[i]->getTotalTicks();
+      }
+      loads++;
+
+      expectations.expect(length <= MAX_LENGTH,
+                          "an unwrapped loop to fit the sequence");
+      if (!factory.isExhausted()) {
+        expectations.expect(ticks == (body_length + rest) *
+                                         AGITATION_TICKS_PER_SECOND,
+                            "an unwrapped load to be complete");
+      }
+    }
+  }
+
+  printf("loader: %" PRIu32 " loads, %" PRIu32 " failed\n", loads,
+         expectations.getFailures());
+  return expectations.getFailures() == 0;
+}
+
+//------------------------------------------------------------------------------
+
+struct Check {
+  const char *name;
+  bool (*run)(const CheckOptions &options);
+};
+
+static constexpr Check CHECKS[] = {
+    {"advance", check_advance},
+    {"motor-queue", check_motor_queue},
+    {"loader", check_loader},
+};
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--seed N] [--trials N] [CHECK...]\nchecks:",
+          argv0);
+  for (const Check &check : CHECKS) {
+    fprintf(stderr, " %s", check.name);
+  }
+  fprintf(stderr, "\n");
+}
+
+static const Check *find_check(const char *name) {
+  for (const Check &check : CHECKS) {
+    if (strcmp(check.name, name) == 0) {
+      return &check;
+    }
+  }
+  return nullptr;
+}
+
+int main(int argc, char **argv) {
+  CheckOptions options;
+  std::vector<const Check *> selected;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    const Check *check = nullptr;
+    if (strcmp(arg, "--seed") == 0 && has_value) {
+      options.seed = (uint32_t)strtoul(argv[++i], nullptr, 0);
+    } else if (strcmp(arg, "--trials") == 0 && has_value) {
+      options.trials = (uint32_t)strtoul(argv[++i], nullptr, 0);
+    } else if ((check = find_check(arg))) {
+      selected.push_back(check);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (selected.empty()) {
+    for (const Check &check : CHECKS) {
+      selected.push_back(&check);
+    }
+  }
+
+  bool passed = true;
+  for (const Check *check : selected) {
+    passed = check->run(options) && passed;
+  }
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,528 @@
+// Headless host simulator: runs a built-in process against a recording motor
+// controller on a virtual clock and prints the motor timeline as CSV.
+//
+// Build from the app directory (not part of the fap, see application.fam):
+//   g++ -std=c++20 -O2 -DHOST -DNDEBUG -I. -o film_developer_sim
+//       sim/film_developer_sim.cpp agitation_process_interpreter.cpp
+//       agitation_process_yaml.cpp agitation_process_image.cpp trace.cpp
+//
+// Usage:
+//   film_developer_sim [options] PROCESS
+//     PROCESS             c41, bw, stand, continuous, a full process name,
+//                         a YAML process file ending in .yaml, or a process
+//                         image from process_compile ending in .bin
+//     --list              list the built-in processes and exit
+//     --speedup N         pace the run at N times real time (default: no
+//                         pacing, as fast as possible)
+//     --confirm-after S   seconds before each user prompt is confirmed
+//                         (default 0)
+//     --max-minutes M     stop processes that have not ended after M
+//                         simulated minutes (default 180)
+//     --tick-by-tick      call tick() for every tick instead of batching
+//                         with nextEventIn()/advanceBy()
+//     -o FILE             write the CSV to FILE instead of stdout
+//     --trace FILE        save the binary trace to FILE, for trace_decode.
+//                         Only the last FILM_DEVELOPER_TRACE_CAPACITY events
+//                         are kept; raise it with -D to trace a whole run.
+//     --export-yaml FILE  also write the process as YAML to FILE, e.g. to
+//                         copy a built-in recipe to the SD card and tune it
+//     --image-index N     which process of a .bin image to run (default 0)
+//     --resume-every S    every S simulated seconds, save the cursor, start
+//                         the process over and continue at the cursor, as
+//                         the app does after a restart. The timeline must
+//                         come out the same as without.
+//     --no-optimize       load steps one to one, without the peephole pass
+//                         of MovementLoader. The timeline must come out the
+//                         same as with it.
+//     --stall             drive the process the way the app does, with
+//                         anchor() and runUntil() from a clock that starts
+//                         a minute before it wraps around and wakes up at
+//                         random: early, in the middle of movements, or up
+//                         to a tick late. Checks that every wakeup runs
+//                         exactly the ticks due by then, and that the
+//                         timeline comes out the same as a normal run.
+
+#include "../agitation_process_interpreter.hpp"
+#include "../trace.hpp"
+#include "builtin_processes.hpp"
+#include "process_image.hpp"
+#include "recording_motor_controller.hpp"
+#include "sim_clock.hpp"
+#include "yaml_source.hpp"
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct SimOptions {
+  const char *process_id{nullptr};
+  double speedup{0};
+  uint32_t confirm_after_ms{0};
+  uint32_t max_ms{180u * 60u * 1000u};
+  bool tick_by_tick{false};
+  const char *output{nullptr};
+  const char *trace{nullptr};
+  const char *export_yaml{nullptr};
+  size_t image_index{0};
+  uint32_t resume_every_ms{0};
+  bool optimize{true};
+  bool stall{false};
+};
+
+struct SimResult {
+  uint32_t ticks;
+  uint32_t end_ms;
+  uint32_t estimated_ticks; // Process ETA at the start, excluding prompts
+  uint32_t prompts;
+  uint32_t resumes;
+  uint32_t wakeups;
+  uint32_t max_catch_up; // Most ticks a single runUntil() ran
+  bool timed_out;
+  AgitationProcessState state;
+};
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--list] [--speedup N] [--confirm-after S] "
+          "[--max-minutes M] [--tick-by-tick] [-o FILE] [--trace FILE] "
+          "[--export-yaml FILE] [--image-index N] [--resume-every S] "
+          "[--no-optimize] [--stall] PROCESS\n",
+          argv0);
+}
+
+static void list_processes() {
+  for (size_t i = 0; i < BUILTIN_PROCESSES_LENGTH; i++) {
+    const AgitationProcessStatic *process = BUILTIN_PROCESSES[i].process;
+    uint32_t duration = SequenceAnalysis::analyzeProcess(*process).duration;
+    if (duration == AgitationMovement::UNBOUNDED_DURATION) {
+      printf("%-12s %-40s unbounded\n", BUILTIN_PROCESSES[i].id,
+             process->process_name);
+    } else {
+      printf("%-12s %-40s %" PRIu32 " s\n", BUILTIN_PROCESSES[i].id,
+             process->process_name, duration / AGITATION_TICKS_PER_SECOND);
+    }
+  }
+}
+
+static bool parse_options(int argc, char **argv, SimOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+
+    if (strcmp(arg, "--list") == 0) {
+      list_processes();
+      exit(0);
+    } else if (strcmp(arg, "--speedup") == 0 && has_value) {
+      options.speedup = atof(argv[++i]);
+    } else if (strcmp(arg, "--confirm-after") == 0 && has_value) {
+      options.confirm_after_ms = (uint32_t)(atof(argv[++i]) * 1000);
+    } else if (strcmp(arg, "--max-minutes") == 0 && has_value) {
+      options.max_ms = (uint32_t)(atof(argv[++i]) * 60 * 1000);
+    } else if (strcmp(arg, "--tick-by-tick") == 0) {
+      options.tick_by_tick = true;
+    } else if (strcmp(arg, "-o") == 0 && has_value) {
+      options.output = argv[++i];
+    } else if (strcmp(arg, "--trace") == 0 && has_value) {
+      options.trace = argv[++i];
+    } else if (strcmp(arg, "--export-yaml") == 0 && has_value) {
+      options.export_yaml = argv[++i];
+    } else if (strcmp(arg, "--image-index") == 0 && has_value) {
+      options.image_index = (size_t)atoi(argv[++i]);
+    } else if (strcmp(arg, "--resume-every") == 0 && has_value) {
+      options.resume_every_ms = (uint32_t)(atof(argv[++i]) * 1000);
+    } else if (strcmp(arg, "--no-optimize") == 0) {
+      options.optimize = false;
+    } else if (strcmp(arg, "--stall") == 0) {
+      options.stall = true;
+    } else if (arg[0] == '-' || options.process_id) {
+      return false;
+    } else {
+      options.process_id = arg;
+    }
+  }
+  return options.process_id != nullptr;
+}
+
+// Tick n of the process runs at the clock time the run reached when it is
+// due; time spent at user prompts moves the clock but not the tick count.
+static SimResult run(const AgitationProcessStatic *process,
+                     const SimOptions &options, SimClock &clock,
+                     RecordingMotorController &motor) {
+  AgitationProcessInterpreter interpreter;
+  interpreter.setOptimize(options.optimize);
+  interpreter.init(process, &motor);
+
+  SimResult result{};
+  result.estimated_ticks = interpreter.getProcessTimeRemaining();
+
+  bool active = true;
+  uint32_t resume_at_ms = options.resume_every_ms;
+  while (active) {
+    if (clock.nowMs() >= options.max_ms) {
+      result.timed_out = true;
+      break;
+    }
+
+    uint32_t ticks = interpreter.nextEventIn();
+    if (ticks == AgitationMovement::NO_PENDING_EVENT) {
+      if (!interpreter.isWaitingForUser()) {
+        break;
+      }
+      clock.advanceBy(options.confirm_after_ms);
+      interpreter.confirm();
+      result.prompts++;
+      continue;
+    }
+    if (options.tick_by_tick) {
+      ticks = 1;
+    }
+
+    // Ticks before the last one of the batch only repeat the current command
+    clock.advanceBy(agitation_ticks_to_ms(ticks - 1));
+    motor.setStep(interpreter.getCurrentStepIndex());
+    uint32_t before = interpreter.getElapsedTicks();
+    active = options.tick_by_tick ? interpreter.tick()
+                                  : interpreter.advanceBy(ticks);
+    result.ticks += interpreter.getElapsedTicks() - before;
+    clock.advanceBy(AGITATION_TICK_MS);
+
+    AgitationCursor cursor;
+    if (options.resume_every_ms > 0 && clock.nowMs() >= resume_at_ms &&
+        interpreter.saveCursor(cursor)) {
+      resume_at_ms = clock.nowMs() + options.resume_every_ms;
+      interpreter.init(process, &motor);
+      if (!interpreter.restoreCursor(cursor)) {
+        fprintf(stderr, "cursor at tick %" PRIu32 " does not restore\n",
+                cursor.elapsed_ticks);
+        exit(1);
+      }
+      result.resumes++;
+    }
+  }
+
+  motor.stop();
+  result.end_ms = clock.nowMs();
+  result.state = interpreter.getState();
+  return result;
+}
+
+// Clock time of the device at the start of a --stall run
+static constexpr uint32_t STALL_CLOCK_START = UINT32_MAX - 60u * 1000u;
+
+// Stops a --stall run that went wrong
+static void stall_failed(const AgitationProcessInterpreter &interpreter,
+                         uint32_t now, const char *what) {
+  fprintf(stderr,
+          "stall: %s at clock %" PRIu32 ", tick %" PRIu32 " due at %" PRIu32
+          ", %" PRIu32 " due\n",
+          what, now, interpreter.getElapsedTicks(),
+          interpreter.tickTimeMs(interpreter.getElapsedTicks()),
+          interpreter.ticksDueAt(now));
+  exit(1);
+}
+
+// The app's way to run a process: ticks fall due on the device clock, here
+// the run's clock plus STALL_CLOCK_START, and every wakeup runs those due by
+// then. Wakeups come at random up to the next event or less than a tick
+// past it, so the motor sees every command; each command is recorded at
+// the time its tick fell due, as the app's motor queue applies it. The rest
+// of the sim runs a tick at the time reached when it falls due, one tick
+// before the anchor() convention, so the anchors are a tick early.
+static SimResult run_stalled(const AgitationProcessStatic *process,
+                             const SimOptions &options, SimClock &clock,
+                             RecordingMotorController &motor) {
+  AgitationProcessInterpreter interpreter;
+  interpreter.setOptimize(options.optimize);
+  interpreter.init(process, &motor);
+  interpreter.anchor(STALL_CLOCK_START + clock.nowMs() - AGITATION_TICK_MS);
+
+  SimResult result{};
+  result.estimated_ticks = interpreter.getProcessTimeRemaining();
+
+  std::mt19937 random(1);
+  uint32_t now = STALL_CLOCK_START + clock.nowMs();
+  bool active = true;
+  bool at_event = true; // Whether the last wakeup reached the planned event
+  while (active) {
+    uint32_t next_tick_at =
+        interpreter.tickTimeMs(interpreter.getElapsedTicks() + 1);
+    if (at_event && next_tick_at - STALL_CLOCK_START >= options.max_ms) {
+      result.timed_out = true;
+      break;
+    }
+
+    uint32_t ticks = interpreter.nextEventIn();
+    if (ticks == AgitationMovement::NO_PENDING_EVENT) {
+      if (!interpreter.isWaitingForUser()) {
+        break;
+      }
+      clock.advanceTo(next_tick_at - STALL_CLOCK_START);
+      clock.advanceBy(options.confirm_after_ms);
+      interpreter.confirm();
+      interpreter.anchor(STALL_CLOCK_START + clock.nowMs() - AGITATION_TICK_MS);
+      now = STALL_CLOCK_START + clock.nowMs();
+      result.prompts++;
+      continue;
+    }
+
+    uint32_t event_tick = interpreter.getElapsedTicks() + ticks;
+    uint32_t event_at = interpreter.tickTimeMs(event_tick);
+    uint32_t until_event = event_at - now;
+    if (random() % 2 && until_event > 1) {
+      now += 1 + random() % (until_event - 1);
+    } else {
+      now = event_at + random() % AGITATION_TICK_MS;
+    }
+
+    uint32_t due = interpreter.ticksDueAt(now);
+    uint32_t before = interpreter.getElapsedTicks();
+    result.wakeups++;
+    if (due != before) {
+      clock.advanceTo(interpreter.tickTimeMs(due) - STALL_CLOCK_START);
+      motor.setStep(interpreter.getCurrentStepIndex());
+    }
+    active = interpreter.runUntil(now);
+    uint32_t ran = interpreter.getElapsedTicks() - before;
+    result.ticks += ran;
+    if (ran > result.max_catch_up) {
+      result.max_catch_up = ran;
+    }
+    if (!active) {
+      break;
+    }
+
+    at_event = interpreter.getElapsedTicks() == event_tick;
+    if (interpreter.getElapsedTicks() != due) {
+      stall_failed(interpreter, now, "ticks run are not the ticks due");
+    }
+    uint32_t late = now - interpreter.tickTimeMs(interpreter.getElapsedTicks());
+    if (static_cast<int32_t>(late) < 0 || late >= AGITATION_TICK_MS) {
+      stall_failed(interpreter, now, "more than a tick off the clock");
+    }
+  }
+
+  clock.advanceTo(interpreter.tickTimeMs(interpreter.getElapsedTicks() + 1) -
+                  STALL_CLOCK_START);
+  motor.stop();
+  result.end_ms = clock.nowMs();
+  result.state = interpreter.getState();
+  return result;
+}
+
+// Whether two runs commanded the motor the same, at the same times
+static bool same_timeline(const RecordingMotorController &a,
+                          const RecordingMotorController &b) {
+  const auto &left = a.getTransitions();
+  const auto &right = b.getTransitions();
+  for (size_t i = 0; i < left.size() || i < right.size(); i++) {
+    if (i >= left.size() || i >= right.size() ||
+        left[i].at_ms != right[i].at_ms || left[i].step != right[i].step ||
+        left[i].from != right[i].from || left[i].to != right[i].to) {
+      fprintf(stderr, "stall: timelines differ at transition %zu\n", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+static void write_csv(FILE *out, const AgitationProcessStatic *process,
+                      const RecordingMotorController &motor) {
+  fprintf(out, "time_ms,step,step_name,from,to\n");
+  for (const auto &transition : motor.getTransitions()) {
+    const char *name = transition.step < process->steps_length
+                           ? process->steps[transition.step].name
+                           : "";
+    fprintf(out, "%" PRIu32 ",%zu,\"%s\",%s,%s\n", transition.at_ms,
+            transition.step, name,
+            RecordingMotorController::directionName(transition.from),
+            RecordingMotorController::directionName(transition.to));
+  }
+}
+
+static bool file_sink(const void *data, size_t size, void *context) {
+  return fwrite(data, 1, size, static_cast<FILE *>(context)) == size;
+}
+
+static bool write_trace(const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  bool written = trace_write_dump(trace_buffer, file_sink, file);
+  return fclose(file) == 0 && written;
+}
+
+static bool write_yaml(const AgitationProcessStatic *process,
+                       const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  bool written = agitation_process_to_yaml(process, file_sink, file);
+  if (fclose(file) != 0 || !written) {
+    fprintf(stderr, "%s: could not write the process\n", path);
+    return false;
+  }
+  return true;
+}
+
+// Loads a YAML process file into `arena`; the file is read the way the app
+// reads it, a line buffer at a time
+static const AgitationProcessStatic *load_yaml(const char *path,
+                                               AgitationArena &arena) {
+  std::string text;
+  if (!read_file(path, text)) {
+    perror(path);
+    return nullptr;
+  }
+  YamlSource source(text, AGITATION_YAML_LINE_MAX);
+  AgitationYamlError error;
+  const AgitationProcessStatic *process =
+      agitation_process_from_yaml(YamlSource::read, &source, &arena, &error);
+  if (!process) {
+    fprintf(stderr, "%s:%" PRIu32 ": %s\n", path, error.line, error.message);
+  }
+  return process;
+}
+
+static bool ends_with(const char *text, const char *suffix) {
+  size_t length = strlen(text);
+  size_t suffix_length = strlen(suffix);
+  return length >= suffix_length &&
+         strcmp(text + length - suffix_length, suffix) == 0;
+}
+
+static const char *state_name(AgitationProcessState state) {
+  switch (state) {
+  case AgitationProcessState::Idle:
+    return "idle";
+  case AgitationProcessState::Running:
+    return "running";
+  case AgitationProcessState::Complete:
+    return "complete";
+  case AgitationProcessState::Error:
+    return "error";
+  }
+  return "unknown";
+}
+
+int main(int argc, char **argv) {
+  SimOptions options;
+  if (!parse_options(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // The size of the app arena. Pointers are wider on the host, so whatever
+  // fits here fits on the device too.
+  static uint8_t arena_memory[4 * 1024];
+  AgitationArena arena;
+  agitation_arena_init(&arena, arena_memory, sizeof(arena_memory));
+
+  // Used in place from the mapped file, as the app does from its read buffer
+  MappedImage image;
+  AgitationImageProcessView image_process;
+
+  const AgitationProcessStatic *process;
+  if (ends_with(options.process_id, ".bin")) {
+    const char *error = nullptr;
+    if (!image.map(options.process_id, &error)) {
+      fprintf(stderr, "%s: %s\n", options.process_id, error);
+      return 1;
+    }
+    if (!agitation_image_get_process(image.getData(), options.image_index,
+                                     &image_process)) {
+      fprintf(stderr, "%s: no process %zu, the image has %zu\n",
+              options.process_id, options.image_index,
+              agitation_image_processes_length(image.getData()));
+      return 2;
+    }
+    process = &image_process.process;
+  } else if (ends_with(options.process_id, ".yaml")) {
+    process = load_yaml(options.process_id, arena);
+    if (!process) {
+      return 1;
+    }
+  } else {
+    process = find_builtin_process(options.process_id);
+    if (!process) {
+      fprintf(stderr, "Unknown process '%s', try --list\n",
+              options.process_id);
+      return 2;
+    }
+  }
+  if (options.export_yaml && !write_yaml(process, options.export_yaml)) {
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (options.output) {
+    out = fopen(options.output, "w");
+    if (!out) {
+      perror(options.output);
+      return 1;
+    }
+  }
+
+  SimClock clock(options.speedup);
+  RecordingMotorController motor(clock);
+  trace_buffer.setClock(
+      [](void *context) { return static_cast<SimClock *>(context)->nowMs(); },
+      &clock);
+
+  auto wall_start = std::chrono::steady_clock::now();
+  SimResult result = options.stall
+                         ? run_stalled(process, options, clock, motor)
+                         : run(process, options, clock, motor);
+  double wall_ms = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - wall_start)
+                       .count();
+
+  write_csv(out, process, motor);
+  if (out != stdout) {
+    fclose(out);
+  }
+  if (options.trace && !write_trace(options.trace)) {
+    return 1;
+  }
+
+  fprintf(stderr,
+          "%s: %s after %" PRIu32 " ticks, %.1f simulated minutes "
+          "(%" PRIu32 " prompts), %zu transitions, %" PRIu32
+          " commands avoided, %.3f ms wall time\n",
+          process->process_name,
+          result.timed_out ? "timed out" : state_name(result.state),
+          result.ticks, result.end_ms / 60000.0, result.prompts,
+          motor.getTransitions().size(), motor.getAvoidedCount(), wall_ms);
+  if (options.resume_every_ms > 0) {
+    fprintf(stderr, "  resumed %" PRIu32 " times\n", result.resumes);
+  }
+  if (options.stall) {
+    SimOptions normal_options = options;
+    normal_options.speedup = 0;
+    normal_options.stall = false;
+    SimClock normal_clock;
+    RecordingMotorController normal_motor(normal_clock);
+    SimResult normal = run(process, normal_options, normal_clock, normal_motor);
+    fprintf(stderr,
+            "  %" PRIu32 " wakeups, up to %" PRIu32 " ticks at once\n",
+            result.wakeups, result.max_catch_up);
+    if (!same_timeline(motor, normal_motor) || normal.end_ms != result.end_ms ||
+        normal.state != result.state) {
+      fprintf(stderr, "  not the timeline of a normal run\n");
+      return 1;
+    }
+  }
+  if (result.estimated_ticks != AgitationMovement::UNBOUNDED_DURATION) {
+    fprintf(stderr, "  estimated %" PRIu32 " ticks before starting\n",
+            result.estimated_ticks);
+  }
+
+  if (result.state == AgitationProcessState::Error) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,248 @@
+// Compiles processes into an image the app runs without parsing, see
+// agitation_image_check(), or into a recipe catalog, see recipe_catalog.hpp.
+// Copy the output to the app data folder on the SD card: an image as
+// processes.bin, a catalog as is.
+//
+// Build from the app directory (not part of the fap, see application.fam):
+//   g++ -std=c++20 -O2 -DHOST -DNDEBUG -I. -o process_compile
+//       sim/process_compile.cpp agitation_process_image.cpp
+//       agitation_process_yaml.cpp agitation_sequence.cpp trace.cpp
+//
+// Usage:
+//   process_compile (-o OUTPUT | --catalog DIR) INPUT...
+//     -o OUTPUT      write one image holding all processes
+//     --catalog DIR  write DIR/recipes.bin and its index DIR/recipes.idx
+//     INPUT          c41, bw, stand, continuous, a full process name, or a
+//                    YAML process file ending in .yaml
+//   e.g. process_compile --catalog out c41 sim/yaml_corpus/*.yaml
+//
+// Every process is validated first, see agitation_process_validate(): errors
+// stop the compile, warnings are printed. The output is read back and
+// checked once written, and every process in it must write out as the same
+// YAML as the process it was compiled from.
+
+#include "../movement/movement_loader.hpp"
+#include "builtin_processes.hpp"
+#include "process_image.hpp"
+#include "yaml_source.hpp"
+#include <inttypes.h>
+#include <memory>
+#include <vector>
+
+// Room for anything within the loader limits
+static constexpr size_t ARENA_SIZE = 128 * 1024;
+
+static bool ends_with(const char *text, const char *suffix) {
+  size_t length = strlen(text);
+  size_t suffix_length = strlen(suffix);
+  return length >= suffix_length &&
+         strcmp(text + length - suffix_length, suffix) == 0;
+}
+
+static std::string to_yaml(const AgitationProcessStatic &process) {
+  std::string text;
+  agitation_process_to_yaml(&process, append_yaml, &text);
+  return text;
+}
+
+static bool check_image(const char *path, const std::string &image,
+                        size_t index, const AgitationProcessStatic &source) {
+  // Aligned like the app's read buffer
+  std::vector<uint32_t> buffer((image.size() + 3) / 4);
+  memcpy(buffer.data(), image.data(), image.size());
+  const char *error = nullptr;
+  AgitationImageProcessView view;
+  if (!agitation_image_check(buffer.data(), image.size(), &error)) {
+    fprintf(stderr, "%s: recipe %zu: %s\n", path, index, error);
+    return false;
+  }
+  if (!agitation_image_get_process(buffer.data(), 0, &view) ||
+      to_yaml(view.process) != to_yaml(source)) {
+    fprintf(stderr, "%s: recipe %zu does not match its source\n", path,
+            index);
+    return false;
+  }
+  return true;
+}
+
+// Reads the catalog back the way the app does and checks every recipe
+static bool check_catalog(const char *recipes_path, const char *index_path,
+                          const std::vector<const AgitationProcessStatic *>
+                              &processes) {
+  std::string recipes;
+  FILE *index = fopen(index_path, "rb");
+  if (!read_file(recipes_path, recipes) || !index) {
+    fprintf(stderr, "%s: cannot read back\n", index_path);
+    if (index) {
+      fclose(index);
+    }
+    return false;
+  }
+
+  static RecipeCatalog catalog;
+  bool ok = catalog.open(read_from_file, index, (uint32_t)recipes.size()) &&
+            catalog.getLength() == processes.size();
+  for (size_t i = 0; ok && i < catalog.getLength(); i++) {
+    const RecipeIndexEntry *entry =
+        catalog.fetch(i, 1) ? catalog.getEntry(i) : nullptr;
+    ok = entry && entry->offset <= recipes.size() &&
+         entry->size <= recipes.size() - entry->offset &&
+         check_image(recipes_path, recipes.substr(entry->offset, entry->size),
+                     i, *processes[i]);
+  }
+  fclose(index);
+  if (!ok) {
+    fprintf(stderr, "%s: does not match %s\n", index_path, recipes_path);
+  }
+  return ok;
+}
+
+// Pool bytes the largest step of `process` takes as the app loads it, with
+// the peephole pass of MovementLoader
+static size_t loaded_pool_bytes(const AgitationProcessStatic &process) {
+  static MovementFactory factory;
+  static MovementLoader loader(factory);
+  AgitationMovement *sequence[MovementLoader::MAX_SEQUENCE_LENGTH];
+  size_t most = 0;
+  for (size_t i = 0; i < process.steps_length; i++) {
+    factory.release(0);
+    loader.loadSequence(AgitationSequenceView::of(process.steps[i]), sequence);
+    if (factory.getUsed() > most) {
+      most = factory.getUsed();
+    }
+  }
+  return most;
+}
+
+// Prints the issues of `process`, and what its largest step takes to load
+static bool validate(const char *input, const AgitationProcessStatic &process) {
+  AgitationValidation validation;
+  bool valid = agitation_process_validate(&process, &validation);
+  char line[96];
+  for (size_t i = 0; i < validation.issues_length &&
+                     i < AGITATION_VALIDATION_MAX_ISSUES;
+       i++) {
+    agitation_issue_format(&validation.issues[i], line, sizeof(line));
+    fprintf(stderr, "%s: %s: %s\n", input,
+            agitation_issue_is_error(validation.issues[i].kind) ? "error"
+                                                               : "warning",
+            line);
+  }
+  if (validation.issues_length > AGITATION_VALIDATION_MAX_ISSUES) {
+    fprintf(stderr, "%s: %zu more issues\n", input,
+            validation.issues_length - AGITATION_VALIDATION_MAX_ISSUES);
+  }
+  size_t loaded = loaded_pool_bytes(process);
+  printf("%s: %zu pool bytes, %zu saved by the peephole pass, %zu movements, "
+         "%zu loop levels, %zu stack bytes\n",
+         input, loaded, validation.worst.pool_bytes - loaded,
+         validation.worst.movements, validation.worst.depth,
+         validation.worst.stack_bytes);
+  return valid;
+}
+
+int main(int argc, char **argv) {
+  const char *output = nullptr;
+  const char *catalog = nullptr;
+  std::vector<const char *> inputs;
+  bool usage = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (strcmp(argv[i], "--catalog") == 0 && i + 1 < argc) {
+      catalog = argv[++i];
+    } else if (argv[i][0] == '-') {
+      usage = true;
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  if (usage || !output == !catalog || inputs.empty()) {
+    fprintf(stderr, "usage: %s (-o OUTPUT | --catalog DIR) INPUT...\n",
+            argv[0]);
+    return 2;
+  }
+
+  // Every YAML process keeps its own arena until the image is written
+  std::vector<std::unique_ptr<uint8_t[]>> arenas;
+  std::vector<const AgitationProcessStatic *> processes;
+  for (const char *input : inputs) {
+    if (!ends_with(input, ".yaml")) {
+      const AgitationProcessStatic *process = find_builtin_process(input);
+      if (!process) {
+        fprintf(stderr, "Unknown process '%s'\n", input);
+        return 2;
+      }
+      if (!validate(input, *process)) {
+        return 1;
+      }
+      processes.push_back(process);
+      continue;
+    }
+
+    std::string text;
+    if (!read_file(input, text)) {
+      perror(input);
+      return 1;
+    }
+    arenas.emplace_back(new uint8_t[ARENA_SIZE]);
+    AgitationArena arena;
+    agitation_arena_init(&arena, arenas.back().get(), ARENA_SIZE);
+    YamlSource source(text, AGITATION_YAML_LINE_MAX);
+    AgitationYamlError error;
+    const AgitationProcessStatic *process =
+        agitation_process_from_yaml(YamlSource::read, &source, &arena, &error);
+    if (!process) {
+      fprintf(stderr, "%s:%" PRIu32 ": %s\n", input, error.line,
+              error.message);
+      return 1;
+    }
+    if (!validate(input, *process)) {
+      return 1;
+    }
+    processes.push_back(process);
+  }
+
+  if (catalog) {
+    std::string recipes_path = std::string(catalog) + "/recipes.bin";
+    std::string index_path = std::string(catalog) + "/recipes.idx";
+    std::string recipes;
+    std::string index;
+    if (!build_catalog(processes.data(), processes.size(), recipes, index)) {
+      fprintf(stderr, "%s: a process does not compile\n", catalog);
+      return 1;
+    }
+    if (!write_file(recipes_path.c_str(), recipes) ||
+        !write_file(index_path.c_str(), index) ||
+        !check_catalog(recipes_path.c_str(), index_path.c_str(), processes)) {
+      return 1;
+    }
+    printf("%s: %zu recipes, %zu bytes, index %zu bytes\n", catalog,
+           processes.size(), recipes.size(), index.size());
+    return 0;
+  }
+
+  if (!write_image(processes.data(), processes.size(), output)) {
+    return 1;
+  }
+
+  MappedImage image;
+  const char *error = nullptr;
+  if (!image.map(output, &error)) {
+    fprintf(stderr, "%s: %s\n", output, error);
+    return 1;
+  }
+  AgitationImageProcessView view;
+  for (size_t i = 0; i < processes.size(); i++) {
+    if (!agitation_image_get_process(image.getData(), i, &view) ||
+        to_yaml(view.process) != to_yaml(*processes[i])) {
+      fprintf(stderr, "%s: process %zu (%s) does not match its source\n",
+              output, i, inputs[i]);
+      return 1;
+    }
+  }
+
+  printf("%s: %zu processes, %zu bytes\n", output, processes.size(),
+         image.getSize());
+  return 0;
+}
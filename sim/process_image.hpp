@@ -0,0 +1,155 @@
+#pragma once
+#include "../agitation_sequence.hpp"
+#include "../recipe_catalog.hpp"
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <unistd.h>
+
+// Helpers for the host tools that compile and run process images and recipe
+// catalogs
+
+/**
+ * @brief A process image file mapped read-only, used in place like the app
+ * uses the buffer it reads the file into
+ */
+class MappedImage {
+public:
+  MappedImage() = default;
+  MappedImage(const MappedImage &) = delete;
+  MappedImage &operator=(const MappedImage &) = delete;
+  ~MappedImage() { unmap(); }
+
+  /**
+   * @brief Map and check `path`
+   * @return False if it cannot be mapped or is no valid image; `error` says
+   * why
+   */
+  bool map(const char *path, const char **error) {
+    unmap();
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      *error = "cannot open";
+      return false;
+    }
+    void *mapped =
+        mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+      *error = "cannot map";
+      return false;
+    }
+    data = mapped;
+    size = (size_t)info.st_size;
+    return agitation_image_check(data, size, error);
+  }
+
+  const void *getData() const { return data; }
+  size_t getSize() const { return size; }
+
+private:
+  void unmap() {
+    if (data) {
+      munmap(data, size);
+      data = nullptr;
+    }
+  }
+
+  void *data{nullptr};
+  size_t size{0};
+};
+
+// Sink for the writers that writes to a FILE
+inline bool write_to_file(const void *data, size_t size, void *context) {
+  return fwrite(data, 1, size, static_cast<FILE *>(context)) == size;
+}
+
+/**
+ * @brief Compile processes into an image file
+ * @return False, with the reason printed, if it could not be written
+ */
+inline bool write_image(const AgitationProcessStatic *const *processes,
+                        size_t processes_length, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  bool written = agitation_image_compile(processes, processes_length,
+                                         write_to_file, file);
+  if (fclose(file) != 0 || !written) {
+    fprintf(stderr, "%s: could not write the image\n", path);
+    return false;
+  }
+  return true;
+}
+
+// RecipeCatalogRead for a FILE
+inline bool read_from_file(uint32_t offset, void *buffer, size_t size,
+                           void *context) {
+  FILE *file = static_cast<FILE *>(context);
+  return fseek(file, (long)offset, SEEK_SET) == 0 &&
+         fread(buffer, 1, size, file) == size;
+}
+
+// Appends to a string, for building images in memory
+inline bool append_to_string(const void *data, size_t size, void *context) {
+  static_cast<std::string *>(context)->append(static_cast<const char *>(data),
+                                              size);
+  return true;
+}
+
+/**
+ * @brief Build a recipe catalog in memory: the processes compiled one by one
+ * into `recipes`, and their index into `index`
+ * @return False if a process does not compile
+ */
+inline bool build_catalog(const AgitationProcessStatic *const *processes,
+                          size_t processes_length, std::string &recipes,
+                          std::string &index) {
+  recipes.clear();
+  index.assign(sizeof(RecipeIndexHeader), '\0');
+  for (size_t i = 0; i < processes_length; i++) {
+    size_t offset = recipes.size();
+    if (!agitation_image_compile(&processes[i], 1, append_to_string,
+                                 &recipes)) {
+      return false;
+    }
+    RecipeIndexEntry entry;
+    recipe_index_entry_init(entry, *processes[i], (uint32_t)offset,
+                            (uint32_t)(recipes.size() - offset));
+    index.append(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    // The next image starts aligned, like the buffer it is read into
+    recipes.resize((recipes.size() + 3) / 4 * 4, '\0');
+  }
+
+  RecipeIndexHeader header = {};
+  header.magic = RECIPE_INDEX_MAGIC;
+  header.version = RECIPE_INDEX_VERSION;
+  header.entry_size = sizeof(RecipeIndexEntry);
+  header.entries_length = (uint32_t)processes_length;
+  header.recipes_size = (uint32_t)recipes.size();
+  index.replace(0, sizeof(header), reinterpret_cast<const char *>(&header),
+                sizeof(header));
+  return true;
+}
+
+inline bool write_file(const char *path, const std::string &data) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+  if (fclose(file) != 0 || !written) {
+    fprintf(stderr, "%s: could not write\n", path);
+    return false;
+  }
+  return true;
+}
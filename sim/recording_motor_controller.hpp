@@ -0,0 +1,52 @@
+#pragma once
+#include "../motor_controller.hpp"
+#include "sim_clock.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Mock controller that records every transition with its time
+ * Repeated commands are filtered by MotorController, so the record is the
+ * motor timeline as the pins would see it.
+ */
+class RecordingMotorController final : public MotorController {
+public:
+  struct Transition {
+    uint32_t at_ms;
+    size_t step;
+    Direction from;
+    Direction to;
+  };
+
+  explicit RecordingMotorController(const SimClock &clock) : clock(clock) {}
+
+  // Step index recorded with the following transitions
+  void setStep(size_t step) { current_step = step; }
+
+  const std::vector<Transition> &getTransitions() const { return transitions; }
+
+  static const char *directionName(Direction direction) {
+    switch (direction) {
+    case Direction::CW:
+      return "CW";
+    case Direction::CCW:
+      return "CCW";
+    case Direction::Stop:
+      return "Stop";
+    case Direction::Unknown:
+      break;
+    }
+    return "Unknown";
+  }
+
+protected:
+  void drive(Direction from, Direction to) override {
+    transitions.push_back({clock.nowMs(), current_step, from, to});
+  }
+
+private:
+  const SimClock &clock;
+  size_t current_step{0};
+  std::vector<Transition> transitions;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <stdint.h>
+#include <thread>
+
+/**
+ * @brief Virtual time for host runs
+ * Host code reads the time from here instead of the system clock, so a run
+ * goes as fast as the host allows, or is paced to `speedup` times real time.
+ */
+class SimClock {
+public:
+  // A speedup of 0 runs without pacing
+  explicit SimClock(double speedup = 0) : speedup(speedup) {}
+
+  uint32_t nowMs() const { return now_ms; }
+
+  // Moves time forward, sleeping the scaled difference when paced
+  void advanceTo(uint32_t ms) {
+    if (ms <= now_ms) {
+      return;
+    }
+    if (speedup > 0) {
+      std::this_thread::sleep_for(
+          std::chrono::duration<double, std::milli>((ms - now_ms) / speedup));
+    }
+    now_ms = ms;
+  }
+
+  void advanceBy(uint32_t ms) { advanceTo(now_ms + ms); }
+
+private:
+  double speedup;
+  uint32_t now_ms{0};
+};
@@ -0,0 +1,88 @@
+// Decodes a binary trace saved by the app (long press Down, see
+// TRACE_DUMP_PATH) or by film_developer_sim --trace, one event per line.
+//
+// Build from the app directory (not part of the fap, see application.fam):
+//   g++ -std=c++20 -O2 -DHOST -DNDEBUG -I. -o trace_decode
+//       sim/trace_decode.cpp trace.cpp
+//
+// Usage:
+//   trace_decode [FILE]   reads stdin without FILE
+//
+// Output columns: sequence number, time in ms, ms since the previous event,
+// event and arguments.
+
+#include "../trace.hpp"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool decode(FILE *in, const char *name) {
+  TraceDumpHeader header;
+  if (fread(&header, sizeof(header), 1, in) != 1 ||
+      memcmp(header.magic, TRACE_DUMP_MAGIC, sizeof(header.magic)) != 0) {
+    fprintf(stderr, "%s: not a trace dump\n", name);
+    return false;
+  }
+  if (header.version != TRACE_DUMP_VERSION ||
+      header.record_size != sizeof(TraceRecord)) {
+    fprintf(stderr, "%s: unsupported version %u, record size %u\n", name,
+            (unsigned)header.version, (unsigned)header.record_size);
+    return false;
+  }
+
+  TraceRecord record;
+  char line[128];
+  uint32_t previous = 0;
+  uint32_t lost = 0;
+  uint32_t count = 0;
+  for (; count < header.count; count++) {
+    if (fread(&record, sizeof(record), 1, in) != 1) {
+      break;
+    }
+    if (record.event == static_cast<uint16_t>(TraceEvent::None)) {
+      lost++;
+      continue;
+    }
+    trace_format(record, line, sizeof(line));
+    uint32_t delta = count > 0 ? record.timestamp - previous : 0;
+    printf("%10" PRIu32 " %10" PRIu32 " %+8" PRId32 "  %s\n",
+           header.first_sequence + count, record.timestamp,
+           static_cast<int32_t>(delta), line);
+    previous = record.timestamp;
+  }
+
+  if (count < header.count) {
+    fprintf(stderr, "%s: truncated, %" PRIu32 " of %" PRIu32 " records\n",
+            name, count, header.count);
+    return false;
+  }
+  if (header.first_sequence > 0 || lost > 0) {
+    fprintf(stderr, "%" PRIu32 " earlier events overwritten, %" PRIu32
+            " lost while dumping\n", header.first_sequence, lost);
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [FILE]\n", argv[0]);
+    return 2;
+  }
+
+  FILE *in = stdin;
+  const char *name = "stdin";
+  if (argc == 2) {
+    name = argv[1];
+    in = fopen(name, "rb");
+    if (!in) {
+      perror(name);
+      return 1;
+    }
+  }
+
+  bool ok = decode(in, name);
+  if (in != stdin) {
+    fclose(in);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,356 @@
+// Host benchmark for the YAML process loader and writer: throughput, and the
+// arena loading needs, for the given files, for a synthetic process at the
+// loader limits, and for a library of recipes, which is also compiled to a
+// process image to compare. Prints one JSON object per line, like
+// film_developer_bench.
+//
+// Build from the app directory (not part of the fap, see application.fam):
+//   g++ -std=c++20 -O2 -DHOST -DNDEBUG -I. -o yaml_bench
+//       sim/yaml_bench.cpp agitation_process_yaml.cpp
+//       agitation_process_image.cpp trace.cpp
+//
+// Usage:
+//   yaml_bench [--min-ms N] [FILE...]
+//     --min-ms N   run each measurement for at least N ms (default 50)
+//   e.g. yaml_bench sim/yaml_corpus/*.yaml
+//
+// Records, by "bench":
+//   yaml_load   ns per load and MB/s at a read size ("chunk"), with the
+//               number of reads, the bytes the loaded process takes
+//               ("arena_bytes") and the most the arena held while loading
+//               ("peak_bytes"), which is the arena size the file needs
+//   yaml_write  ns per write and MB/s of the process a file loads to
+//   yaml_failed files that did not load, with the reason
+//   yaml_library ms to write and to load back a library of "recipes"
+//               processes of assorted sizes, and per recipe
+//   image_library the same library as one image: its size, ms to compile it,
+//               and ms to check it and set up every process for the
+//               interpreter, which is all it takes to use once read
+//   recipe_catalog the same library as a recipe catalog: ms to open its
+//               index and read the first menu page ("open_ms"), and to read
+//               and set up one recipe once chosen ("choose_ms"), with the
+//               reads each takes; neither grows with the library
+
+#include "process_image.hpp"
+#include "yaml_source.hpp"
+#include <chrono>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <vector>
+
+static double min_ms = 50;
+
+// Big enough for anything within the loader limits
+static uint8_t arena_memory[256 * 1024];
+
+// Runs `body` until at least min_ms passed; returns ns per call
+template <typename Body> static double measure(Body body) {
+  using clock = std::chrono::steady_clock;
+  uint64_t calls = 0;
+  auto start = clock::now();
+  double elapsed_ms = 0;
+  do {
+    body();
+    calls++;
+    elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start)
+                     .count();
+  } while (elapsed_ms < min_ms);
+  return elapsed_ms * 1e6 / (double)calls;
+}
+
+// Counts what the writer produces without keeping it
+static bool count_sink(const void *, size_t size, void *context) {
+  *static_cast<size_t *>(context) += size;
+  return true;
+}
+
+static void bench_write(const char *name,
+                        const AgitationProcessStatic &process) {
+  size_t bytes = 0;
+  agitation_process_to_yaml(&process, count_sink, &bytes);
+  double ns = measure([&] {
+    size_t unused = 0;
+    agitation_process_to_yaml(&process, count_sink, &unused);
+  });
+  printf("{\"bench\":\"yaml_write\",\"file\":\"%s\",\"bytes\":%zu,"
+         "\"ns\":%.0f,\"mb_per_s\":%.1f}\n",
+         name, bytes, ns, bytes * 1e3 / ns);
+}
+
+static void bench_load(const char *name, const std::string &text) {
+  AgitationArena arena;
+  AgitationYamlError error;
+
+  // Reads of a few bytes, of typical storage buffer sizes, and of a whole
+  // line buffer
+  for (size_t chunk : {16, 64, AGITATION_YAML_LINE_MAX}) {
+    agitation_arena_init(&arena, arena_memory, sizeof(arena_memory));
+    YamlSource source(text, chunk);
+    if (!agitation_process_from_yaml(YamlSource::read, &source, &arena,
+                                     &error)) {
+      printf("{\"bench\":\"yaml_failed\",\"file\":\"%s\",\"line\":%" PRIu32
+             ",\"error\":\"%s\"}\n",
+             name, error.line, error.message);
+      return;
+    }
+    size_t reads = source.reads;
+    size_t used = arena.used;
+    size_t peak = arena.peak;
+
+    double ns = measure([&] {
+      YamlSource again(text, chunk);
+      agitation_process_from_yaml(YamlSource::read, &again, &arena, nullptr);
+    });
+    printf("{\"bench\":\"yaml_load\",\"file\":\"%s\",\"bytes\":%zu,"
+           "\"chunk\":%zu,\"ns\":%.0f,\"mb_per_s\":%.1f,\"reads\":%zu,"
+           "\"arena_bytes\":%zu,\"peak_bytes\":%zu}\n",
+           name, text.size(), chunk, ns, text.size() * 1e3 / ns, reads, used,
+           peak);
+  }
+
+  // The arena still holds the process from the last load
+  YamlSource source(text, AGITATION_YAML_LINE_MAX);
+  bench_write(name, *agitation_process_from_yaml(YamlSource::read, &source,
+                                                 &arena, nullptr));
+}
+
+// Appends a sequence of `length` movements whose last one is a loop nesting
+// `depth` more levels
+static void append_sequence(std::string &text, size_t indent, size_t length,
+                            size_t depth) {
+  std::string pad(indent, ' ');
+  for (size_t i = 0; i + 1 < length || (i + 1 == length && depth == 0); i++) {
+    switch (i % 4) {
+    case 0:
+      text += pad + "- cw: 2\n";
+      break;
+    case 1:
+      text += pad + "- pause: 500ms   # reversal\n";
+      break;
+    case 2:
+      text += pad + "- ccw: 2\n";
+      break;
+    case 3:
+      text += pad + "- pause: 1\n";
+      break;
+    }
+  }
+  if (depth > 0) {
+    text += pad + "- loop: 3\n";
+    text += pad + "  max_duration: 60\n";
+    text += pad + "  sequence:\n";
+    append_sequence(text, indent + 4, length, depth - 1);
+  }
+}
+
+// As many steps as the interpreter times, every sequence as long and loops
+// as deep as the loader allows
+static std::string largest_process() {
+  std::string text = "# Generated by yaml_bench\n"
+                     "process_name: Largest process\n"
+                     "film_type: Synthetic\n"
+                     "tank_type: Synthetic\n"
+                     "chemistry: Synthetic\n"
+                     "temperature: 20.0\n"
+                     "steps:\n";
+  for (size_t step = 0; step < 16; step++) {
+    text += "  - name: \"Step " + std::to_string(step) + "\"\n";
+    text += "    description: Every sequence at the length limit\n";
+    text += "    sequence:\n";
+    append_sequence(text, 6, AGITATION_YAML_MAX_SEQUENCE_LENGTH,
+                    AGITATION_YAML_MAX_LOOP_DEPTH);
+  }
+  return text;
+}
+
+// A recipe of one to eight steps, varied by `seed`, written out and loaded
+// back as the app would a library on the SD card
+static std::string library_recipe(size_t seed) {
+  std::string text = "process_name: \"Recipe " + std::to_string(seed) +
+                     "\"\nfilm_type: Black and White Negative\n"
+                     "tank_type: Paterson\nchemistry: D-76\ntemperature: " +
+                     std::to_string(18 + seed % 8) + ".5\nsteps:\n";
+  for (size_t step = 0; step < 1 + seed % 8; step++) {
+    text += "  - name: Step " + std::to_string(step) + "\n";
+    text += "    description: Agitate, then let it stand\n";
+    text += "    sequence:\n";
+    append_sequence(text, 6, 4 + (seed + step) % 8, (seed + step) % 3);
+    text += "      - wait_user: \"Ready for the next step?\"\n";
+  }
+  return text;
+}
+
+// A library of `recipes` recipes loaded from their YAML, each in its own
+// arena
+struct Library {
+  std::vector<std::string> texts;
+  std::vector<std::vector<uint8_t>> arenas;
+  std::vector<const AgitationProcessStatic *> processes;
+  size_t bytes{0};
+
+  explicit Library(size_t recipes) : arenas(recipes) {
+    for (size_t i = 0; i < recipes; i++) {
+      texts.push_back(library_recipe(i));
+      bytes += texts.back().size();
+      arenas[i].resize(16 * 1024);
+      AgitationArena arena;
+      agitation_arena_init(&arena, arenas[i].data(), arenas[i].size());
+      YamlSource source(texts.back(), AGITATION_YAML_LINE_MAX);
+      processes.push_back(agitation_process_from_yaml(
+          YamlSource::read, &source, &arena, nullptr));
+      if (!processes.back()) {
+        fprintf(stderr, "library recipe %zu does not load\n", i);
+        exit(1);
+      }
+    }
+  }
+};
+
+static void bench_library(size_t recipes) {
+  Library library(recipes);
+  const std::vector<std::string> &texts = library.texts;
+  const std::vector<const AgitationProcessStatic *> &processes =
+      library.processes;
+  size_t bytes = library.bytes;
+
+  double write_ns = measure([&] {
+    for (const AgitationProcessStatic *process : processes) {
+      size_t unused = 0;
+      agitation_process_to_yaml(process, count_sink, &unused);
+    }
+  });
+  double load_ns = measure([&] {
+    for (size_t i = 0; i < recipes; i++) {
+      AgitationArena arena;
+      agitation_arena_init(&arena, arena_memory, sizeof(arena_memory));
+      YamlSource source(texts[i], AGITATION_YAML_LINE_MAX);
+      agitation_process_from_yaml(YamlSource::read, &source, &arena, nullptr);
+    }
+  });
+  printf("{\"bench\":\"yaml_library\",\"recipes\":%zu,\"bytes\":%zu,"
+         "\"write_ms\":%.3f,\"load_ms\":%.3f,\"write_us_per_recipe\":%.2f,"
+         "\"load_us_per_recipe\":%.2f}\n",
+         recipes, bytes, write_ns / 1e6, load_ns / 1e6,
+         write_ns / 1e3 / recipes, load_ns / 1e3 / recipes);
+
+  std::string image;
+  double compile_ns = measure([&] {
+    image.clear();
+    agitation_image_compile(processes.data(), processes.size(), append_yaml,
+                            &image);
+  });
+  // Where the app reads the file to
+  std::vector<uint32_t> buffer((image.size() + 3) / 4);
+  memcpy(buffer.data(), image.data(), image.size());
+  const char *error = nullptr;
+  if (!agitation_image_check(buffer.data(), image.size(), &error)) {
+    fprintf(stderr, "library image does not check: %s\n", error);
+    exit(1);
+  }
+  static AgitationImageProcessView view;
+  double open_ns = measure([&] {
+    agitation_image_check(buffer.data(), image.size(), nullptr);
+    for (size_t i = 0; i < recipes; i++) {
+      agitation_image_get_process(buffer.data(), i, &view);
+    }
+  });
+  printf("{\"bench\":\"image_library\",\"recipes\":%zu,\"bytes\":%zu,"
+         "\"compile_ms\":%.3f,\"open_ms\":%.3f,"
+         "\"open_us_per_recipe\":%.2f}\n",
+         recipes, image.size(), compile_ns / 1e6, open_ns / 1e6,
+         open_ns / 1e3 / recipes);
+}
+
+// A file held in memory, counting the reads made of it
+struct MemoryFile {
+  const std::string *data;
+  uint32_t reads;
+
+  static bool read(uint32_t offset, void *buffer, size_t size,
+                   void *context) {
+    MemoryFile *file = static_cast<MemoryFile *>(context);
+    file->reads++;
+    if (offset > file->data->size() || size > file->data->size() - offset) {
+      return false;
+    }
+    memcpy(buffer, file->data->data() + offset, size);
+    return true;
+  }
+};
+
+static void bench_catalog(size_t recipes) {
+  Library library(recipes);
+  std::string recipes_data;
+  std::string index_data;
+  if (!build_catalog(library.processes.data(), recipes, recipes_data,
+                     index_data)) {
+    fprintf(stderr, "library catalog does not build\n");
+    exit(1);
+  }
+
+  // As the app does: open, show the first page, then choose the last recipe
+  // listed, which is the one furthest into both files
+  static RecipeCatalog catalog;
+  MemoryFile index_file = {&index_data, 0};
+  MemoryFile recipes_file = {&recipes_data, 0};
+  static AgitationImageProcessView view;
+  std::vector<uint32_t> buffer;
+  double open_ns = measure([&] {
+    catalog.open(MemoryFile::read, &index_file, (uint32_t)recipes_data.size());
+    catalog.fetch(0, 3);
+  });
+  uint32_t open_reads = catalog.getReads();
+
+  uint32_t choose_reads = 0;
+  double choose_ns = measure([&] {
+    size_t before = catalog.getReads() + recipes_file.reads;
+    const RecipeIndexEntry *entry =
+        catalog.fetch(recipes - 1, 1) ? catalog.getEntry(recipes - 1) : nullptr;
+    if (!entry) {
+      fprintf(stderr, "library catalog has no entry %zu\n", recipes - 1);
+      exit(1);
+    }
+    buffer.resize((entry->size + 3) / 4);
+    MemoryFile::read(entry->offset, buffer.data(), entry->size, &recipes_file);
+    agitation_image_check(buffer.data(), entry->size, nullptr);
+    agitation_image_get_process(buffer.data(), 0, &view);
+    choose_reads = (uint32_t)(catalog.getReads() + recipes_file.reads - before);
+    // Back to the first page, as the menu would be on return
+    catalog.fetch(0, 3);
+  });
+
+  printf("{\"bench\":\"recipe_catalog\",\"recipes\":%zu,\"bytes\":%zu,"
+         "\"index_bytes\":%zu,\"open_ms\":%.4f,\"open_reads\":%" PRIu32
+         ",\"choose_ms\":%.4f,\"choose_reads\":%" PRIu32 "}\n",
+         recipes, recipes_data.size(), index_data.size(), open_ns / 1e6,
+         open_reads, choose_ns / 1e6, choose_reads);
+}
+
+int main(int argc, char **argv) {
+  std::vector<const char *> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) {
+      min_ms = atof(argv[++i]);
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: %s [--min-ms N] [FILE...]\n", argv[0]);
+      return 2;
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+
+  for (const char *path : files) {
+    std::string text;
+    if (!read_file(path, text)) {
+      fprintf(stderr, "%s: cannot read\n", path);
+      return 1;
+    }
+    const char *name = strrchr(path, '/');
+    bench_load(name ? name + 1 : path, text);
+  }
+  bench_load("largest", largest_process());
+  bench_library(500);
+  bench_catalog(50);
+  bench_catalog(500);
+  return 0;
+}
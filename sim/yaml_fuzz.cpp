@@ -0,0 +1,404 @@
+// Fuzz driver for the YAML process loader and writer. Loads every corpus
+// file, then random mutations of them, and checks that the loader never
+// reads or writes outside its arena, gives the same answer whatever the read
+// size, and only returns processes the interpreter can load and run, and
+// that those write out as YAML that loads back to the same process. Loaded
+// processes are also compiled to images, which must run the same, and
+// corrupted copies of those must be rejected or still run safely. Build with
+// sanitizers so memory errors abort the run.
+//
+// Build from the app directory (not part of the fap, see application.fam):
+//   g++ -std=c++20 -O1 -g -fsanitize=address,undefined -DHOST -DNDEBUG -I.
+//       -o yaml_fuzz sim/yaml_fuzz.cpp agitation_process_yaml.cpp
+//       agitation_process_image.cpp agitation_process_interpreter.cpp
+//       trace.cpp
+// or as a libFuzzer target, with the corpus as seeds:
+//   clang++ ... -fsanitize=fuzzer,address,undefined -DYAML_FUZZ_LIBFUZZER
+//   ./yaml_fuzz sim/yaml_corpus
+//
+// Usage:
+//   yaml_fuzz [--iterations N] [--seed S] FILE...
+//     --iterations N   mutations per corpus file (default 20000)
+//     --seed S         random seed (default 1)
+//
+// Files named bad_*.yaml must fail to load, all others must load.
+
+#include "../agitation_process_interpreter.hpp"
+#include "../movement/sequence_analysis.hpp"
+#include "yaml_source.hpp"
+#include <initializer_list>
+#include <inttypes.h>
+#include <random>
+#include <stdlib.h>
+#include <vector>
+
+// Motor that does nothing; the run only has to not go wrong
+class NullMotorController final : public MotorController {
+protected:
+  void drive(Direction, Direction) override {}
+};
+
+struct LoadResult {
+  bool loaded;
+  AgitationYamlError error;
+  size_t used;
+  size_t peak;
+};
+
+// Arena sizes tried for every input: roomy, and small enough to run out
+static const size_t ARENA_SIZES[] = {8192, 1024};
+static const size_t CHUNK_SIZES[] = {1, 7, AGITATION_YAML_LINE_MAX};
+
+static bool check_sequence(const AgitationSequenceView &sequence,
+                           size_t depth) {
+  size_t length = sequence.getLength();
+  if (sequence.isNull() || length == 0 ||
+      length > AGITATION_YAML_MAX_SEQUENCE_LENGTH ||
+      depth > AGITATION_YAML_MAX_LOOP_DEPTH) {
+    return false;
+  }
+  for (size_t i = 0; i < length; i++) {
+    AgitationMovementType type = sequence.getType(i);
+    if (type == AgitationMovementTypeLoop &&
+        !check_sequence(sequence.getLoopBody(i), depth + 1)) {
+      return false;
+    }
+    // Any string of a loaded process fit on a line
+    if (type == AgitationMovementTypeWaitUser && sequence.getMessage(i) &&
+        strlen(sequence.getMessage(i)) >= AGITATION_YAML_LINE_MAX) {
+      return false;
+    }
+    if (type > AgitationMovementTypeWaitUser) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A loaded process must be well formed and within the loader limits, so the
+// interpreter can take it; run it for a while to be sure
+static bool check_process(const AgitationProcessStatic &process) {
+  if (!process.process_name || process.steps_length == 0) {
+    return false;
+  }
+  for (size_t i = 0; i < process.steps_length; i++) {
+    const AgitationStepStatic &step = process.steps[i];
+    if (!step.name || !step.description ||
+        !check_sequence(AgitationSequenceView::of(step), 0)) {
+      return false;
+    }
+  }
+  if (SequenceAnalysis::analyzeProcess(process).max_depth >
+      MovementLoader::MAX_NESTING_DEPTH) {
+    return false;
+  }
+
+  NullMotorController motor;
+  AgitationProcessInterpreter interpreter;
+  interpreter.init(&process, &motor);
+  for (int i = 0; i < 1000; i++) {
+    uint32_t ticks = interpreter.nextEventIn();
+    if (ticks == AgitationMovement::NO_PENDING_EVENT) {
+      if (!interpreter.isWaitingForUser()) {
+        break;
+      }
+      interpreter.confirm();
+    } else if (!interpreter.advanceBy(ticks)) {
+      break;
+    }
+  }
+  return true;
+}
+
+// Longest string of a process once quoted and escaped
+static size_t longest_quoted(const char *text) {
+  size_t length = 2;
+  for (; text && *text; text++) {
+    length += (*text == '"' || *text == '\\' || *text == '\n') ? 2 : 1;
+  }
+  return length;
+}
+
+static size_t longest_quoted(const AgitationMovementStatic *sequence,
+                             size_t length) {
+  size_t longest = 0;
+  for (size_t i = 0; i < length; i++) {
+    size_t quoted = 0;
+    if (sequence[i].type == AgitationMovementTypeLoop) {
+      quoted = longest_quoted(sequence[i].loop.sequence,
+                              sequence[i].loop.sequence_length);
+    } else if (sequence[i].type == AgitationMovementTypeWaitUser) {
+      quoted = longest_quoted(sequence[i].message);
+    }
+    longest = quoted > longest ? quoted : longest;
+  }
+  return longest;
+}
+
+static size_t longest_quoted(const AgitationProcessStatic &process) {
+  size_t longest = 0;
+  for (const char *text : {process.process_name, process.film_type,
+                           process.tank_type, process.chemistry}) {
+    size_t quoted = longest_quoted(text);
+    longest = quoted > longest ? quoted : longest;
+  }
+  for (size_t i = 0; i < process.steps_length; i++) {
+    const AgitationStepStatic &step = process.steps[i];
+    for (size_t quoted :
+         {longest_quoted(step.name), longest_quoted(step.description),
+          longest_quoted(step.sequence, step.sequence_length)}) {
+      longest = quoted > longest ? quoted : longest;
+    }
+  }
+  return longest;
+}
+
+// An image in memory of exactly its size, aligned like the app's read buffer
+static std::vector<uint32_t> image_copy(const std::string &image) {
+  std::vector<uint32_t> copy((image.size() + 3) / 4);
+  memcpy(copy.data(), image.data(), image.size());
+  return copy;
+}
+
+// The process compiled to an image must come out of it the same, and run.
+// Corrupted images must be rejected, or hold processes that are safe to run.
+static void check_image(const AgitationProcessStatic &process,
+                        const std::string &yaml) {
+  const AgitationProcessStatic *processes[] = {&process, &process};
+  std::string image;
+  if (!agitation_image_compile(processes, 2, append_yaml, &image)) {
+    // The YAML format has no limit on the number of steps
+    if (process.steps_length <= AGITATION_IMAGE_MAX_STEPS) {
+      fprintf(stderr, "a loaded process did not compile\n");
+      abort();
+    }
+    return;
+  }
+  std::vector<uint32_t> copy = image_copy(image);
+  const char *error = nullptr;
+  AgitationImageProcessView view;
+  if (!agitation_image_check(copy.data(), image.size(), &error) ||
+      !agitation_image_get_process(copy.data(), 1, &view) ||
+      !check_process(view.process)) {
+    fprintf(stderr, "compiled process does not check out: %s\n",
+            error ? error : "");
+    abort();
+  }
+  std::string text;
+  agitation_process_to_yaml(&view.process, append_yaml, &text);
+  if (text != yaml) {
+    fprintf(stderr, "compiled process differs from its source\n");
+    abort();
+  }
+
+  std::minstd_rand random((uint32_t)image.size());
+  for (int round = 0; round < 8; round++) {
+    std::string corrupt = image;
+    for (int i = 0, changes = 1 + random() % 3; i < changes; i++) {
+      corrupt[random() % corrupt.size()] = static_cast<char>(random());
+    }
+    copy = image_copy(corrupt);
+    if (!agitation_image_check(copy.data(), corrupt.size(), nullptr)) {
+      continue;
+    }
+    for (size_t i = 0; i < agitation_image_processes_length(copy.data());
+         i++) {
+      if (!agitation_image_get_process(copy.data(), i, &view) ||
+          !check_process(view.process)) {
+        fprintf(stderr, "accepted a corrupt image that does not run\n");
+        abort();
+      }
+    }
+  }
+}
+
+// Writing must give the same process back, and the same text again. It may
+// only fail on lines that come out longer than the loader takes, as quoting
+// and indentation can make them: allow for the deepest indentation and
+// longest key in front of a string.
+static void check_round_trip(const AgitationProcessStatic &process) {
+  std::string text;
+  if (!agitation_process_to_yaml(&process, append_yaml, &text)) {
+    if (longest_quoted(process) + 40 < AGITATION_YAML_LINE_MAX) {
+      fprintf(stderr, "a loaded process did not write out\n");
+      abort();
+    }
+    return;
+  }
+
+  std::vector<uint8_t> memory(64 * 1024);
+  AgitationArena arena;
+  agitation_arena_init(&arena, memory.data(), memory.size());
+  YamlSource source(text, AGITATION_YAML_LINE_MAX);
+  AgitationYamlError error;
+  const AgitationProcessStatic *again =
+      agitation_process_from_yaml(YamlSource::read, &source, &arena, &error);
+  if (!again || !processes_equal(process, *again)) {
+    fprintf(stderr, "written process loads back differently%s%s\n%s",
+            again ? "" : ": ", again ? "" : error.message, text.c_str());
+    abort();
+  }
+  std::string rewritten;
+  if (!agitation_process_to_yaml(again, append_yaml, &rewritten) ||
+      rewritten != text) {
+    fprintf(stderr, "written process writes out differently\n");
+    abort();
+  }
+  check_image(process, text);
+}
+
+static LoadResult load(const std::string &text, size_t chunk,
+                       size_t arena_size) {
+  // Exactly the arena, so the sanitizers catch any access outside it
+  std::vector<uint8_t> memory(arena_size);
+  AgitationArena arena;
+  agitation_arena_init(&arena, memory.data(), memory.size());
+  YamlSource source(text, chunk);
+
+  LoadResult result{};
+  const AgitationProcessStatic *process = agitation_process_from_yaml(
+      YamlSource::read, &source, &arena, &result.error);
+  result.loaded = process != nullptr;
+  result.used = arena.used;
+  result.peak = arena.peak;
+
+  if (process && !check_process(*process)) {
+    fprintf(stderr, "loaded a process that does not check out\n");
+    abort();
+  }
+  if (process && chunk == CHUNK_SIZES[0]) {
+    check_round_trip(*process);
+  }
+  if (!process && !result.error.message) {
+    fprintf(stderr, "failed without an error message\n");
+    abort();
+  }
+  if (arena.used > arena.size || arena.peak > arena.size ||
+      (process && arena.used > arena.peak)) {
+    fprintf(stderr, "arena accounting out of range\n");
+    abort();
+  }
+  return result;
+}
+
+// Loads `text` every way and checks the answers agree; returns the first
+static LoadResult fuzz_one(const std::string &text) {
+  LoadResult first{};
+  for (size_t arena_size : ARENA_SIZES) {
+    LoadResult reference{};
+    for (size_t c = 0; c < sizeof(CHUNK_SIZES) / sizeof(CHUNK_SIZES[0]);
+         c++) {
+      LoadResult result = load(text, CHUNK_SIZES[c], arena_size);
+      if (c == 0) {
+        reference = result;
+      } else if (result.loaded != reference.loaded ||
+                 result.used != reference.used ||
+                 result.error.line != reference.error.line ||
+                 (!result.loaded &&
+                  strcmp(result.error.message, reference.error.message))) {
+        fprintf(stderr, "result depends on the read size\n");
+        abort();
+      }
+    }
+    if (arena_size == ARENA_SIZES[0]) {
+      first = reference;
+    }
+  }
+  return first;
+}
+
+#ifdef YAML_FUZZ_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  fuzz_one(std::string(reinterpret_cast<const char *>(data), size));
+  return 0;
+}
+
+#else
+
+static std::string mutate(const std::string &seed, std::mt19937 &random) {
+  static const char TOKENS[] = " -:#\"'\\\n\t0123456789abcxyz_";
+  std::string text = seed;
+  int mutations = 1 + random() % 4;
+  for (int i = 0; i < mutations && !text.empty(); i++) {
+    size_t at = random() % text.size();
+    switch (random() % 6) {
+    case 0:
+      text.erase(at, 1 + random() % 8);
+      break;
+    case 1:
+      text.insert(at, 1, TOKENS[random() % (sizeof(TOKENS) - 1)]);
+      break;
+    case 2:
+      text[at] = static_cast<char>(random());
+      break;
+    case 3:
+      // Duplicate a piece, e.g. a line or a nested list
+      text.insert(at, text.substr(random() % text.size(), random() % 64));
+      break;
+    case 4:
+      text.insert(at, "  ");
+      break;
+    case 5:
+      text.resize(at);
+      break;
+    }
+  }
+  return text;
+}
+
+int main(int argc, char **argv) {
+  uint32_t iterations = 20000;
+  uint32_t seed = 1;
+  std::vector<const char *> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: %s [--iterations N] [--seed S] FILE...\n",
+              argv[0]);
+      return 2;
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+
+  std::mt19937 random(seed);
+  int failures = 0;
+  for (const char *path : files) {
+    std::string text;
+    if (!read_file(path, text)) {
+      fprintf(stderr, "%s: cannot read\n", path);
+      return 1;
+    }
+
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    bool expect_loaded = strncmp(name, "bad_", 4) != 0;
+    LoadResult result = fuzz_one(text);
+    if (result.loaded != expect_loaded) {
+      failures++;
+    }
+    if (result.loaded) {
+      printf("%s: loaded, %zu bytes, peak %zu%s\n", name, result.used,
+             result.peak, expect_loaded ? "" : " (expected to fail)");
+    } else {
+      printf("%s: line %" PRIu32 ": %s%s\n", name, result.error.line,
+             result.error.message, expect_loaded ? " (expected to load)" : "");
+    }
+
+    uint32_t loaded = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+      loaded += fuzz_one(mutate(text, random)).loaded;
+    }
+    if (iterations > 0) {
+      printf("%s: %" PRIu32 " mutations, %" PRIu32 " loaded\n", name,
+             iterations, loaded);
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+#endif
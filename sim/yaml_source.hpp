@@ -0,0 +1,123 @@
+#pragma once
+#include "../agitation_sequence.hpp"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+// Helpers for the host tools that load and write YAML processes
+
+/**
+ * @brief YAML text in memory, handed to the loader in chunks of at most
+ * `chunk` bytes, the way short storage reads would
+ */
+struct YamlSource {
+  const std::string *text;
+  size_t chunk;
+  size_t position{0};
+  size_t reads{0};
+
+  YamlSource(const std::string &text, size_t chunk)
+      : text(&text), chunk(chunk) {}
+
+  static size_t read(void *buffer, size_t size, void *context) {
+    YamlSource *source = static_cast<YamlSource *>(context);
+    size_t count = source->text->size() - source->position;
+    if (count > size) {
+      count = size;
+    }
+    if (count > source->chunk) {
+      count = source->chunk;
+    }
+    memcpy(buffer, source->text->data() + source->position, count);
+    source->position += count;
+    source->reads++;
+    return count;
+  }
+};
+
+// Sink for agitation_process_to_yaml() that appends to a string
+inline bool append_yaml(const void *data, size_t size, void *context) {
+  static_cast<std::string *>(context)->append(static_cast<const char *>(data),
+                                              size);
+  return true;
+}
+
+inline bool strings_equal(const char *a, const char *b) {
+  // The loader reads a missing string back as an empty one
+  return strcmp(a ? a : "", b ? b : "") == 0;
+}
+
+inline bool sequences_equal(const AgitationMovementStatic *a, size_t a_length,
+                            const AgitationMovementStatic *b,
+                            size_t b_length) {
+  if (a_length != b_length) {
+    return false;
+  }
+  for (size_t i = 0; i < a_length; i++) {
+    if (a[i].type != b[i].type) {
+      return false;
+    }
+    switch (a[i].type) {
+    case AgitationMovementTypeLoop:
+      if (a[i].loop.count != b[i].loop.count ||
+          a[i].loop.max_duration != b[i].loop.max_duration ||
+          !sequences_equal(a[i].loop.sequence, a[i].loop.sequence_length,
+                           b[i].loop.sequence, b[i].loop.sequence_length)) {
+        return false;
+      }
+      break;
+    case AgitationMovementTypeWaitUser:
+      if ((a[i].message == nullptr) != (b[i].message == nullptr) ||
+          !strings_equal(a[i].message, b[i].message)) {
+        return false;
+      }
+      break;
+    default:
+      if (a[i].duration != b[i].duration) {
+        return false;
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+// Same process as far as the YAML format can tell
+inline bool processes_equal(const AgitationProcessStatic &a,
+                            const AgitationProcessStatic &b) {
+  if (!strings_equal(a.process_name, b.process_name) ||
+      !strings_equal(a.film_type, b.film_type) ||
+      !strings_equal(a.tank_type, b.tank_type) ||
+      !strings_equal(a.chemistry, b.chemistry) ||
+      a.temperature != b.temperature || a.steps_length != b.steps_length) {
+    return false;
+  }
+  for (size_t i = 0; i < a.steps_length; i++) {
+    const AgitationStepStatic &x = a.steps[i];
+    const AgitationStepStatic &y = b.steps[i];
+    if (!strings_equal(x.name, y.name) ||
+        !strings_equal(x.description, y.description) ||
+        x.temperature != y.temperature ||
+        !sequences_equal(x.sequence, x.sequence_length, y.sequence,
+                         y.sequence_length)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline bool read_file(const char *path, std::string &text) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  text.clear();
+  char buffer[4096];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    text.append(buffer, count);
+  }
+  fclose(file);
+  return true;
+}
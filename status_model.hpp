@@ -0,0 +1,236 @@
+#pragma once
+#include "agitation_process_interpreter.hpp"
+#include "motor_controller.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Builds text in a fixed buffer without printf
+ * The buffer is always NUL-terminated; text that does not fit is cut off.
+ */
+class TextBuilder {
+public:
+  TextBuilder(char *buffer, size_t size)
+      : buffer(buffer), size(size), length(0) {
+    buffer[0] = '\0';
+  }
+
+  TextBuilder &append(const char *text) {
+    while (*text) {
+      put(*text++);
+    }
+    return *this;
+  }
+
+  // Decimal, zero-padded to at least `min_digits`
+  TextBuilder &appendUint(uint32_t value, size_t min_digits = 1) {
+    char digits[10];
+    size_t count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value > 0);
+    for (; count < min_digits && count < sizeof(digits); count++) {
+      digits[count] = '0';
+    }
+    while (count > 0) {
+      put(digits[--count]);
+    }
+    return *this;
+  }
+
+  size_t getLength() const { return length; }
+
+private:
+  void put(char c) {
+    if (length + 1 < size) {
+      buffer[length++] = c;
+      buffer[length] = '\0';
+    }
+  }
+
+  char *buffer;
+  size_t size;
+  size_t length;
+};
+
+/**
+ * @brief What the main screen shows, formatted once per change
+ * update() compares the interpreter state the texts depend on with what they
+ * were last built from, and rebuilds only the ones that differ. The draw
+ * callback then reads the model and never queries the interpreter.
+ */
+class StatusModel {
+public:
+  StatusModel() { reset(); }
+
+  // Texts shown before any process ran
+  void reset() {
+    TextBuilder(step_text, sizeof(step_text)).append("Ready");
+    TextBuilder(status_text, sizeof(status_text)).append("Press OK to start");
+    TextBuilder(movement_text, sizeof(movement_text)).append("Movement: Idle");
+    eta_text[0] = '\0';
+    user_message[0] = '\0';
+
+    generation = UINT32_MAX;
+    active = false;
+    paused = false;
+    waiting = false;
+    error = false;
+    elapsed_s = UINT32_MAX;
+    duration_s = UINT32_MAX;
+    eta_s = UINT32_MAX;
+    direction = MotorController::Direction::Unknown;
+  }
+
+  /**
+   * @brief Brings the texts up to date
+   * @return True if anything on screen changed
+   */
+  bool update(const AgitationProcessInterpreter &interpreter,
+              const MotorController &motor, bool is_active, bool is_paused) {
+    if (!interpreter.getCurrentProcess()) {
+      return false;
+    }
+    bool changed = false;
+
+    if (is_active != active || is_paused != paused) {
+      active = is_active;
+      paused = is_paused;
+      // The pause marker is part of the status text
+      elapsed_s = UINT32_MAX;
+      changed = true;
+    }
+
+    if (interpreter.getGeneration() != generation) {
+      generation = interpreter.getGeneration();
+      updateStep(interpreter);
+      changed = true;
+    }
+
+    if (!error) {
+      changed |= updateTime(interpreter);
+    }
+
+    if (motor.getDirection() != direction) {
+      direction = motor.getDirection();
+      TextBuilder(movement_text, sizeof(movement_text))
+          .append("Movement: ")
+          .append(motor.getDirectionString());
+      changed = true;
+    }
+
+    return changed;
+  }
+
+  const char *getStepText() const { return step_text; }
+  const char *getStatusText() const { return status_text; }
+  const char *getMovementText() const { return movement_text; }
+  const char *getEtaText() const { return eta_text; }
+  const char *getUserMessage() const { return user_message; }
+
+  bool isActive() const { return active; }
+  bool isPaused() const { return paused; }
+  bool isWaitingForUser() const { return waiting; }
+  bool isMotorRunning() const {
+    return direction == MotorController::Direction::CW ||
+           direction == MotorController::Direction::CCW;
+  }
+
+private:
+  static const char *errorText(AgitationProcessError error) {
+    switch (error) {
+    case AgitationProcessError::TooManySteps:
+      return "Too many steps";
+    case AgitationProcessError::StepTooLarge:
+      return "Step too large";
+    case AgitationProcessError::StepEmpty:
+      return "Step is empty";
+    case AgitationProcessError::None:
+      break;
+    }
+    return "Process error";
+  }
+
+  // Everything that only changes along with the interpreter's generation
+  void updateStep(const AgitationProcessInterpreter &interpreter) {
+    const AgitationStepStatic *step = interpreter.getCurrentStep();
+    if (step) {
+      TextBuilder(step_text, sizeof(step_text))
+          .append("Step: ")
+          .append(step->name);
+    }
+
+    waiting = interpreter.isWaitingForUser();
+    if (waiting) {
+      TextBuilder(user_message, sizeof(user_message))
+          .append(interpreter.getUserMessage());
+    }
+
+    bool was_error = error;
+    error = interpreter.getState() == AgitationProcessState::Error;
+    if (error) {
+      TextBuilder(status_text, sizeof(status_text))
+          .append(errorText(interpreter.getError()));
+      eta_text[0] = '\0';
+    } else if (was_error) {
+      elapsed_s = UINT32_MAX;
+      eta_s = UINT32_MAX;
+    }
+  }
+
+  // Movement time and ETA, which move on every second
+  bool updateTime(const AgitationProcessInterpreter &interpreter) {
+    bool changed = false;
+
+    uint32_t elapsed = interpreter.getCurrentMovementTimeElapsed() /
+                       AGITATION_TICKS_PER_SECOND;
+    uint32_t duration =
+        interpreter.getCurrentMovementDuration() / AGITATION_TICKS_PER_SECOND;
+    if (elapsed != elapsed_s || duration != duration_s) {
+      elapsed_s = elapsed;
+      duration_s = duration;
+      TextBuilder(status_text, sizeof(status_text))
+          .append(paused ? "[PAUSED] Time: " : " Time: ")
+          .appendUint(elapsed)
+          .append("s/")
+          .appendUint(duration)
+          .append("s");
+      changed = true;
+    }
+
+    uint32_t remaining = interpreter.getProcessTimeRemaining();
+    uint32_t eta = remaining == AgitationMovement::UNBOUNDED_DURATION
+                       ? UINT32_MAX - 1
+                       : remaining / AGITATION_TICKS_PER_SECOND;
+    if (eta != eta_s) {
+      eta_s = eta;
+      TextBuilder text(eta_text, sizeof(eta_text));
+      if (remaining == AgitationMovement::UNBOUNDED_DURATION) {
+        text.append("--:--");
+      } else {
+        text.appendUint(eta / 60).append(":").appendUint(eta % 60, 2);
+      }
+      changed = true;
+    }
+
+    return changed;
+  }
+
+  char step_text[32];
+  char status_text[64];
+  char movement_text[32];
+  char eta_text[16];
+  char user_message[32];
+
+  // Inputs the texts were built from; UINT32_MAX forces a rebuild
+  uint32_t generation;
+  bool active;
+  bool paused;
+  bool waiting;
+  bool error;
+  uint32_t elapsed_s;
+  uint32_t duration_s;
+  uint32_t eta_s;
+  MotorController::Direction direction;
+};
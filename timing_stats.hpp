@@ -0,0 +1,288 @@
+#pragma once
+#include "agitation_sequence.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Fixed-size histogram of non-negative timings
+ * Bucket 0 counts zeros, bucket i > 0 counts values in [2^(i-1), 2^i), and
+ * the last bucket everything above. Recording is a few instructions and
+ * never allocates.
+ */
+class TimingHistogram {
+public:
+  static constexpr size_t BUCKETS = 16;
+
+  void record(uint32_t value) {
+    buckets[bucketOf(value)]++;
+    if (count == 0 || value < min) {
+      min = value;
+    }
+    if (value > max) {
+      max = value;
+    }
+    sum += value;
+    count++;
+  }
+
+  void reset() { *this = TimingHistogram(); }
+
+  uint32_t getCount() const { return count; }
+  uint32_t getMin() const { return count ? min : 0; }
+  uint32_t getMax() const { return max; }
+  uint32_t getMean() const {
+    return count ? static_cast<uint32_t>(sum / count) : 0;
+  }
+  uint32_t getBucket(size_t bucket) const { return buckets[bucket]; }
+
+  // Smallest value that falls in `bucket`
+  static uint32_t bucketLow(size_t bucket) {
+    return bucket == 0 ? 0 : 1u << (bucket - 1);
+  }
+
+  /**
+   * @brief Upper bound of the given percentile
+   * Returns the top of the bucket the percentile falls in, capped by the
+   * largest value seen, so it is exact for the maximum and at most twice
+   * the true value otherwise.
+   */
+  uint32_t percentile(uint32_t percent) const {
+    if (count == 0) {
+      return 0;
+    }
+    uint64_t rank = (static_cast<uint64_t>(count) * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS - 1; i++) {
+      seen += buckets[i];
+      if (seen >= rank) {
+        uint32_t top = i == 0 ? 0 : (1u << i) - 1;
+        return top < max ? top : max;
+      }
+    }
+    return max;
+  }
+
+private:
+  static size_t bucketOf(uint32_t value) {
+    size_t bucket = 0;
+    while (value != 0 && bucket < BUCKETS - 1) {
+      value >>= 1;
+      bucket++;
+    }
+    return bucket;
+  }
+
+  uint32_t buckets[BUCKETS]{};
+  uint32_t count{0};
+  uint32_t min{0};
+  uint32_t max{0};
+  uint64_t sum{0};
+};
+
+/**
+ * @brief Planned against actual duration of each step of a run
+ * The actual duration is wall time while the step runs, leaving out time
+ * paused or waiting for the user, which the plan does not include either.
+ */
+class StepTimings {
+public:
+  // As many as a process may have, see AgitationProcessInterpreter
+  static constexpr size_t MAX_STEPS = AGITATION_PROCESS_MAX_STEPS;
+
+  // Planned duration of a step that never ends on its own
+  static constexpr uint32_t UNBOUNDED = UINT32_MAX;
+
+  struct Entry {
+    uint32_t planned_ms;
+    uint32_t actual_ms;
+    bool started;
+    bool finished;
+  };
+
+  void reset() {
+    memset(entries, 0, sizeof(entries));
+    current = NO_STEP;
+    running = false;
+    accumulated_ms = 0;
+  }
+
+  /**
+   * @brief Follows the process after anything that may have changed it
+   * @param step Step the interpreter is on
+   * @param planned_ms Planned duration of that step, or UNBOUNDED
+   * @param is_running False while paused or waiting for the user
+   */
+  void observe(size_t step, uint32_t planned_ms, bool is_running,
+               uint32_t now_ms) {
+    if (step != current) {
+      finish(now_ms);
+      current = step;
+      accumulated_ms = 0;
+      if (Entry *entry = currentEntry()) {
+        *entry = Entry{planned_ms, 0, true, false};
+      }
+    }
+
+    if (is_running != running) {
+      if (is_running) {
+        running_since = now_ms;
+      } else {
+        accumulated_ms += now_ms - running_since;
+      }
+      running = is_running;
+    }
+
+    if (Entry *entry = currentEntry()) {
+      entry->actual_ms =
+          accumulated_ms + (running ? now_ms - running_since : 0);
+    }
+  }
+
+  // Closes the current step, e.g. when the process ends or is stopped
+  void finish(uint32_t now_ms) {
+    if (running) {
+      accumulated_ms += now_ms - running_since;
+      running = false;
+    }
+    if (Entry *entry = currentEntry()) {
+      entry->actual_ms = accumulated_ms;
+      entry->finished = true;
+    }
+    current = NO_STEP;
+  }
+
+  const Entry &getEntry(size_t step) const { return entries[step]; }
+
+  // Actual minus planned time over the steps with a planned duration
+  int32_t getTotalDrift() const {
+    int32_t drift = 0;
+    for (const Entry &entry : entries) {
+      if (entry.started && entry.planned_ms != UNBOUNDED) {
+        drift += static_cast<int32_t>(entry.actual_ms - entry.planned_ms);
+      }
+    }
+    return drift;
+  }
+
+  // Step the last observe() was on, MAX_STEPS if none or out of range
+  size_t getCurrent() const {
+    return current < MAX_STEPS ? current : MAX_STEPS;
+  }
+
+private:
+  static constexpr size_t NO_STEP = SIZE_MAX;
+
+  Entry *currentEntry() {
+    return current < MAX_STEPS ? &entries[current] : nullptr;
+  }
+
+  Entry entries[MAX_STEPS]{};
+  size_t current{NO_STEP};
+  bool running{false};
+  uint32_t running_since{0};
+  uint32_t accumulated_ms{0};
+};
+
+/**
+ * @brief Scheduling measurements of the agitation loop
+ * Filled in by the app while a process runs; shown on its debug screen and
+ * written out with the trace.
+ */
+struct TimingStats {
+  // ms the state timer fired after it was due
+  TimingHistogram timer_late_ms;
+  // Times it fired early, not counted above
+  uint32_t timer_early{0};
+  // us spent running the tank's ticks per wakeup
+  TimingHistogram tick_us;
+  // us spent bringing the status up to date after a wakeup, while the tank
+  // is on screen
+  TimingHistogram status_us;
+  // ms motor commands were applied after they were due, collected from the
+  // motor queue on the event loop
+  TimingHistogram motor_late_ms;
+  StepTimings steps;
+
+  void reset() {
+    timer_late_ms.reset();
+    timer_early = 0;
+    tick_us.reset();
+    status_us.reset();
+    motor_late_ms.reset();
+    steps.reset();
+  }
+
+  // Receives one line of text at a time, without line ending
+  using LineSink = void (*)(const char *line, void *context);
+
+  // Summary lines followed by the buckets of every histogram and the step
+  // table
+  void print(LineSink sink, void *context) const {
+    char line[64];
+    printSummary("timer_late_ms", timer_late_ms, sink, context);
+    snprintf(line, sizeof(line), "timer_early %lu",
+             static_cast<unsigned long>(timer_early));
+    sink(line, context);
+    printSummary("tick_us", tick_us, sink, context);
+    printSummary("status_us", status_us, sink, context);
+    printSummary("motor_late_ms", motor_late_ms, sink, context);
+
+    printBuckets("timer_late_ms", timer_late_ms, sink, context);
+    printBuckets("tick_us", tick_us, sink, context);
+    printBuckets("status_us", status_us, sink, context);
+    printBuckets("motor_late_ms", motor_late_ms, sink, context);
+
+    sink("step planned_ms actual_ms drift_ms", context);
+    for (size_t i = 0; i < StepTimings::MAX_STEPS; i++) {
+      const StepTimings::Entry &entry = steps.getEntry(i);
+      if (!entry.started) {
+        continue;
+      }
+      if (entry.planned_ms == StepTimings::UNBOUNDED) {
+        snprintf(line, sizeof(line), "%u - %lu -%s", static_cast<unsigned>(i),
+                 static_cast<unsigned long>(entry.actual_ms),
+                 entry.finished ? "" : " running");
+      } else {
+        snprintf(line, sizeof(line), "%u %lu %lu %ld%s",
+                 static_cast<unsigned>(i),
+                 static_cast<unsigned long>(entry.planned_ms),
+                 static_cast<unsigned long>(entry.actual_ms),
+                 static_cast<long>(
+                     static_cast<int32_t>(entry.actual_ms - entry.planned_ms)),
+                 entry.finished ? "" : " running");
+      }
+      sink(line, context);
+    }
+  }
+
+private:
+  static void printSummary(const char *name, const TimingHistogram &histogram,
+                           LineSink sink, void *context) {
+    char line[96];
+    snprintf(line, sizeof(line),
+             "%s count=%lu min=%lu mean=%lu p50<=%lu p99<=%lu max=%lu", name,
+             static_cast<unsigned long>(histogram.getCount()),
+             static_cast<unsigned long>(histogram.getMin()),
+             static_cast<unsigned long>(histogram.getMean()),
+             static_cast<unsigned long>(histogram.percentile(50)),
+             static_cast<unsigned long>(histogram.percentile(99)),
+             static_cast<unsigned long>(histogram.getMax()));
+    sink(line, context);
+  }
+
+  static void printBuckets(const char *name, const TimingHistogram &histogram,
+                           LineSink sink, void *context) {
+    char line[64];
+    for (size_t i = 0; i < TimingHistogram::BUCKETS; i++) {
+      if (histogram.getBucket(i) == 0) {
+        continue;
+      }
+      snprintf(line, sizeof(line), "%s >=%lu %lu", name,
+               static_cast<unsigned long>(TimingHistogram::bucketLow(i)),
+               static_cast<unsigned long>(histogram.getBucket(i)));
+      sink(line, context);
+    }
+  }
+};
@@ -0,0 +1,158 @@
+#include "trace.hpp"
+#include <stdio.h>
+#include <string.h>
+
+#ifndef HOST
+#include <furi.h>
+#endif
+
+TraceBuffer trace_buffer;
+
+uint32_t TraceBuffer::now() const {
+  if (clock) {
+    return clock(clock_context);
+  }
+#ifdef HOST
+  return 0;
+#else
+  return furi_get_tick();
+#endif
+}
+
+bool trace_write_dump(const TraceBuffer &buffer, TraceSink sink,
+                      void *context) {
+  uint32_t begin = buffer.begin();
+  uint32_t end = buffer.end();
+
+  TraceDumpHeader header;
+  memcpy(header.magic, TRACE_DUMP_MAGIC, sizeof(header.magic));
+  header.version = TRACE_DUMP_VERSION;
+  header.record_size = sizeof(TraceRecord);
+  header.first_sequence = begin;
+  header.count = end - begin;
+  if (!sink(&header, sizeof(header), context)) {
+    return false;
+  }
+
+  // Records overwritten meanwhile are written as TraceEvent::None, so the
+  // position of each record still gives its sequence number
+  TraceRecord record;
+  for (uint32_t sequence = begin; sequence != end; sequence++) {
+    buffer.read(sequence, record);
+    if (!sink(&record, sizeof(record), context)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+namespace {
+
+// How an argument is printed
+enum class TraceArg : uint8_t { Unused, Number, Movement, Direction, State };
+
+struct TraceEventInfo {
+  const char *name;
+  const char *arg_names[3];
+  TraceArg arg_kinds[3];
+};
+
+constexpr TraceArg U = TraceArg::Unused;
+constexpr TraceArg N = TraceArg::Number;
+
+// Indexed by TraceEvent
+const TraceEventInfo TRACE_EVENTS[] = {
+    {"lost", {}, {U, U, U}},
+    {"process_start", {"steps"}, {N, U, U}},
+    {"process_end", {"state", "ticks"}, {TraceArg::State, N, U}},
+    {"step_start", {"step", "movements", "pool_bytes"}, {N, N, N}},
+    {"step_preload", {"step", "loaded"}, {N, N, U}},
+    {"step_load_failed", {"step", "pool_bytes", "exhausted"}, {N, N, N}},
+    {"movement_start",
+     {"type", "index", "ticks"},
+     {TraceArg::Movement, N, N}},
+    {"loop_next",
+     {"type", "index", "iteration"},
+     {TraceArg::Movement, N, N}},
+    {"user_confirm", {"step"}, {N, U, U}},
+    {"sequence_loaded", {nullptr, "length", "loaded"}, {U, N, N}},
+    {"load_failed", {"static_type"}, {N, U, U}},
+    {"pool_exhausted",
+     {"type", "needed", "available"},
+     {TraceArg::Movement, N, N}},
+    {"motor_queued", {"to", "at_ms"}, {TraceArg::Direction, N, U}},
+    {"motor_applied",
+     {"to", "at_ms", "late_ms"},
+     {TraceArg::Direction, N, N}},
+    {"cursor_restored", {"step", "levels", "ticks"}, {N, N, N}},
+};
+static_assert(sizeof(TRACE_EVENTS) / sizeof(TRACE_EVENTS[0]) ==
+                  static_cast<size_t>(TraceEvent::Count),
+              "Every event needs an entry");
+
+// Matches AgitationMovement::Type
+const char *const MOVEMENT_NAMES[] = {"CW", "CCW", "Pause", "Loop",
+                                      "WaitUser"};
+// Matches MotorController::Direction
+const char *const DIRECTION_NAMES[] = {"Unknown", "Stop", "CW", "CCW"};
+// Matches AgitationProcessState
+const char *const STATE_NAMES[] = {"Idle", "Running", "Complete", "Error"};
+
+template <size_t Length>
+const char *name_of(const char *const (&names)[Length], uint32_t value) {
+  return value < Length ? names[value] : nullptr;
+}
+
+} // namespace
+
+const char *trace_event_name(uint16_t event) {
+  return event < static_cast<uint16_t>(TraceEvent::Count)
+             ? TRACE_EVENTS[event].name
+             : "unknown";
+}
+
+size_t trace_format(const TraceRecord &record, char *buffer, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+
+  size_t length = snprintf(buffer, size, "%s", trace_event_name(record.event));
+  if (record.event >= static_cast<uint16_t>(TraceEvent::Count)) {
+    if (length < size) {
+      length += snprintf(buffer + length, size - length, " %u %lu %lu",
+                         (unsigned)record.arg0, (unsigned long)record.arg1,
+                         (unsigned long)record.arg2);
+    }
+    return length < size ? length : size - 1;
+  }
+
+  const TraceEventInfo &info = TRACE_EVENTS[record.event];
+  const uint32_t args[3] = {record.arg0, record.arg1, record.arg2};
+  for (size_t i = 0; i < 3 && length < size; i++) {
+    const char *text = nullptr;
+    switch (info.arg_kinds[i]) {
+    case TraceArg::Unused:
+      continue;
+    case TraceArg::Number:
+      break;
+    case TraceArg::Movement:
+      text = name_of(MOVEMENT_NAMES, args[i]);
+      break;
+    case TraceArg::Direction:
+      text = name_of(DIRECTION_NAMES, args[i]);
+      break;
+    case TraceArg::State:
+      text = name_of(STATE_NAMES, args[i]);
+      break;
+    }
+
+    if (text) {
+      length += snprintf(buffer + length, size - length, " %s=%s",
+                         info.arg_names[i], text);
+    } else {
+      length += snprintf(buffer + length, size - length, " %s=%lu",
+                         info.arg_names[i], (unsigned long)args[i]);
+    }
+  }
+  return length < size ? length : size - 1;
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary event trace. Events are fixed-size records written into a ring that
+// keeps the most recent CAPACITY of them; nothing is formatted until the ring
+// is dumped, on the device or by sim/trace_decode. Recording is cheap enough
+// to stay on in release builds, see TRACE_EVENT in debug.hpp.
+
+#ifndef FILM_DEVELOPER_TRACE_CAPACITY
+#define FILM_DEVELOPER_TRACE_CAPACITY 128
+#endif
+
+// Values are stored in dumps, so existing ones must not change
+enum class TraceEvent : uint16_t {
+  None = 0,            // Record lost, overwritten while it was read
+  ProcessStart = 1,    // steps
+  ProcessEnd = 2,      // state, elapsed ticks
+  StepStart = 3,       // step, movements, pool bytes
+  StepPreload = 4,     // step, loaded
+  StepLoadFailed = 5,  // step, pool bytes used, pool exhausted
+  MovementStart = 6,   // movement type, index, total ticks
+  LoopNext = 7,        // movement type, index, iteration
+  UserConfirm = 8,     // step
+  SequenceLoaded = 9,  // -, static length, loaded length
+  LoadFailed = 10,     // static movement type
+  PoolExhausted = 11,  // movement type, bytes needed, bytes available
+  MotorQueued = 12,    // direction, due at ms
+  MotorApplied = 13,   // direction, due at ms, ms late
+  CursorRestored = 14, // step, movement levels, elapsed ticks
+  Count
+};
+
+struct TraceRecord {
+  uint32_t timestamp; // ms
+  uint16_t event;     // TraceEvent
+  uint16_t arg0;
+  uint32_t arg1;
+  uint32_t arg2;
+};
+static_assert(sizeof(TraceRecord) == 16, "Dumps rely on the record layout");
+
+/**
+ * @brief Lock-free ring of trace records
+ * Any thread may record; each record claims a slot with one atomic increment
+ * and publishes it once written. Readers skip records that are overwritten
+ * while they copy them, so dumping never blocks the writers.
+ */
+class TraceBuffer {
+public:
+  static constexpr uint32_t CAPACITY = FILM_DEVELOPER_TRACE_CAPACITY;
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0,
+                "Capacity must be a power of two");
+
+  // Returns the current time in ms
+  using Clock = uint32_t (*)(void *context);
+
+  constexpr TraceBuffer() = default;
+
+  // Defaults to furi_get_tick() on the device, and to 0 on the host
+  void setClock(Clock clock, void *context) {
+    clock_context = context;
+    this->clock = clock;
+  }
+
+  void record(TraceEvent event, uint32_t arg0 = 0, uint32_t arg1 = 0,
+              uint32_t arg2 = 0) {
+    uint32_t sequence = next.fetch_add(1, std::memory_order_relaxed);
+    uint32_t slot = sequence & (CAPACITY - 1);
+    committed[slot].store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    TraceRecord &record = records[slot];
+    record.timestamp = now();
+    record.event = static_cast<uint16_t>(event);
+    record.arg0 = static_cast<uint16_t>(arg0);
+    record.arg1 = arg1;
+    record.arg2 = arg2;
+    committed[slot].store(sequence + 1, std::memory_order_release);
+  }
+
+  // Sequence numbers of the oldest record still held and one past the newest
+  uint32_t begin() const {
+    uint32_t end = this->end();
+    return end > CAPACITY ? end - CAPACITY : 0;
+  }
+  uint32_t end() const { return next.load(std::memory_order_acquire); }
+
+  // Copies record `sequence`; false, with a TraceEvent::None record, if it
+  // was overwritten or is still being written
+  bool read(uint32_t sequence, TraceRecord &record) const {
+    uint32_t slot = sequence & (CAPACITY - 1);
+    if (committed[slot].load(std::memory_order_acquire) == sequence + 1) {
+      record = records[slot];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (committed[slot].load(std::memory_order_relaxed) == sequence + 1) {
+        return true;
+      }
+    }
+    record = TraceRecord{};
+    return false;
+  }
+
+  // Drops everything recorded so far; not safe against concurrent writers
+  void clear() {
+    for (std::atomic<uint32_t> &slot : committed) {
+      slot.store(0, std::memory_order_relaxed);
+    }
+    next.store(0, std::memory_order_release);
+  }
+
+private:
+  uint32_t now() const;
+
+  TraceRecord records[CAPACITY]{};
+  // Sequence number + 1 of the record each slot holds, 0 while written
+  std::atomic<uint32_t> committed[CAPACITY]{};
+  std::atomic<uint32_t> next{0};
+  Clock clock{nullptr};
+  void *clock_context{nullptr};
+};
+
+extern TraceBuffer trace_buffer;
+
+// Dump format: this header followed by `count` records, oldest first, all
+// little endian as on both the device and common hosts
+struct TraceDumpHeader {
+  char magic[4]; // TRACE_DUMP_MAGIC
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t first_sequence; // Sequence number of the first record
+  uint32_t count;
+};
+
+#define TRACE_DUMP_MAGIC "FDTR"
+#define TRACE_DUMP_VERSION 1
+
+// Receives the dump in pieces; returns false to stop
+using TraceSink = bool (*)(const void *data, size_t size, void *context);
+
+// Writes the records currently held in the dump format
+bool trace_write_dump(const TraceBuffer &buffer, TraceSink sink,
+                      void *context);
+
+// Event name, "unknown" for values this build does not know
+const char *trace_event_name(uint16_t event);
+
+// Formats the event and arguments of `record` as text, e.g.
+// "step_start step=1 movements=3 pool_bytes=224"
+size_t trace_format(const TraceRecord &record, char *buffer, size_t size);